@@ -10,6 +10,13 @@ struct VertexShaderExternalData
 	DirectX::XMFLOAT4X4 worldInverseTranspose;
 	DirectX::XMFLOAT4X4 viewMatrix;
 	DirectX::XMFLOAT4X4 projMatrix;
+
+	// undoes position quantization (see MeshQuantization.h);
+	// one and zero for meshes with full-float vertices
+	DirectX::XMFLOAT3 positionScale;
+	int packedVertices;
+	DirectX::XMFLOAT3 positionOffset;
+	float padding;
 };
 
 struct PixelShaderExternalData
@@ -38,7 +38,7 @@ void DX12Helper::Initialize(Microsoft::WRL::ComPtr<ID3D12Device> device, Microso
 // dataCount - How many pieces of data (like how many vertices)
 // data - Pointer to the data itself
 // --------------------------------------------------------
-Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateStaticBuffer(unsigned int dataStride, unsigned int dataCount, void* data)
+Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateStaticBuffer(unsigned int dataStride, unsigned int dataCount, const void* data)
 {
 	// The overall buffer we'll be creating
 	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
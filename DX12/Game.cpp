@@ -163,18 +163,21 @@ void Game::CreateAssets()
 {
 	// don't have to access the mesh vector directly! use FindMesh() helper function
 
-	entities.push_back(std::make_shared<GameEntity>("leftCylinder", FindMesh("cylinder"), bronzeMaterial));
-	FindEntity("leftCylinder")->GetTransform()->SetPosition(XMFLOAT3(7.0f, 3.0f, 0.0f));
+	leftCylinder = std::make_shared<GameEntity>("leftCylinder", FindMesh("cylinder"), bronzeMaterial);
+	entities.push_back(leftCylinder);
+	leftCylinder->GetTransform()->SetPosition(XMFLOAT3(7.0f, 3.0f, 0.0f));
 
-	entities.push_back(std::make_shared<GameEntity>("rightCylinder", FindMesh("cylinder"), bronzeMaterial));
-	FindEntity("rightCylinder")->GetTransform()->SetPosition(XMFLOAT3(-7.0f, 3.0f, 0.0f));
+	rightCylinder = std::make_shared<GameEntity>("rightCylinder", FindMesh("cylinder"), bronzeMaterial);
+	entities.push_back(rightCylinder);
+	rightCylinder->GetTransform()->SetPosition(XMFLOAT3(-7.0f, 3.0f, 0.0f));
 
-	entities.push_back(std::make_shared<GameEntity>("centerTorus", FindMesh("torus"), bronzeMaterial));
-	FindEntity("centerTorus")->GetTransform()->SetPosition(XMFLOAT3(0.0f, -1.0f, 0.0f));
-	FindEntity("centerTorus")->GetTransform()->Scale(XMFLOAT3(2.0f, 2.0f, 2.0f));
+	centerTorus = std::make_shared<GameEntity>("centerTorus", FindMesh("torus"), bronzeMaterial);
+	entities.push_back(centerTorus);
+	centerTorus->GetTransform()->SetPosition(XMFLOAT3(0.0f, -1.0f, 0.0f));
+	centerTorus->GetTransform()->Scale(XMFLOAT3(2.0f, 2.0f, 2.0f));
 
 	for (int i = 0; i < NUM_SPHERES; i++) {
-		std::string sName = "sphere" + i;
+		std::string sName = "sphere" + std::to_string(i);
 		std::shared_ptr<Material> sMaterial;
 
 		if (i % 2) {
@@ -184,8 +187,9 @@ void Game::CreateAssets()
 			sMaterial = woodMaterial;
 		}
 
-		entities.push_back(std::make_shared<GameEntity>(sName, FindMesh("sphere"), sMaterial));
-		FindEntity(sName)->GetTransform()->SetPosition(XMFLOAT3((float)(rand() % 10) - 5, (float)(rand() % 10) - (float)4, 0.0f));
+		spheres.push_back(std::make_shared<GameEntity>(sName, FindMesh("sphere"), sMaterial));
+		entities.push_back(spheres.back());
+		spheres.back()->GetTransform()->SetPosition(XMFLOAT3((float)(rand() % 10) - 5, (float)(rand() % 10) - (float)4, 0.0f));
 	}
 
 	// floor
@@ -208,6 +212,7 @@ void Game::LoadMaterials()
 
 	// bronze
 	bronzeMaterial = std::make_shared<Material>(pipelineState, DirectX::XMFLOAT3(1, 1, 1));
+	bronzeMaterial->SetPackedPipelineState(packedPipelineState);
 
 	{
 		// bronze textures
@@ -230,6 +235,7 @@ void Game::LoadMaterials()
 
 	// wood
 	woodMaterial = std::make_shared<Material>(pipelineState, DirectX::XMFLOAT3(1, 1, 1));
+	woodMaterial->SetPackedPipelineState(packedPipelineState);
 
 	{
 		// wood textures
@@ -365,6 +371,22 @@ void Game::CreateRootSigAndPipelineState()
 		inputElements[3].SemanticIndex = 0;
 	}
 
+	// The same elements for PackedVertex (see MeshQuantization.h);
+	// the input assembler turns each into floats, and the vertex
+	// shader does the rest of the decoding
+	D3D12_INPUT_ELEMENT_DESC packedInputElements[inputElementCount] = {};
+	{
+		for (unsigned int i = 0; i < inputElementCount; i++)
+			packedInputElements[i] = inputElements[i];
+
+		// position as fractions of the mesh's bounds (w unused), half
+		// float uvs, octahedral normal and tangent
+		packedInputElements[0].Format = DXGI_FORMAT_R16G16B16A16_UNORM;
+		packedInputElements[1].Format = DXGI_FORMAT_R16G16_FLOAT;
+		packedInputElements[2].Format = DXGI_FORMAT_R16G16_SNORM;
+		packedInputElements[3].Format = DXGI_FORMAT_R16G16_SNORM;
+	}
+
 	// Root Signature
 	{
 		// Describe the range of CBVs needed for the vertex shader
@@ -499,6 +521,11 @@ void Game::CreateRootSigAndPipelineState()
 		// Create the pipe state object
 		device->CreateGraphicsPipelineState(&psoDesc,
 			IID_PPV_ARGS(pipelineState.GetAddressOf()));
+
+		// and again for meshes with packed vertices
+		psoDesc.InputLayout.pInputElementDescs = packedInputElements;
+		device->CreateGraphicsPipelineState(&psoDesc,
+			IID_PPV_ARGS(packedPipelineState.GetAddressOf()));
 	}
 }
 
@@ -554,22 +581,26 @@ void Game::Update(float deltaTime, float totalTime)
 	camera->Update(deltaTime);
 
 	// moving objects
-	FindEntity("centerTorus")->GetTransform()->Rotate(2.0f * deltaTime, -2.0f * deltaTime, 0.0f);
+	centerTorus->GetTransform()->Rotate(2.0f * deltaTime, -2.0f * deltaTime, 0.0f);
 
-	FindEntity("leftCylinder")->GetTransform()->Rotate(-2.0f * deltaTime, -2.0f * deltaTime, 0.0f);
-	FindEntity("rightCylinder")->GetTransform()->Rotate(2.0f * deltaTime, 2.0f * deltaTime, 0.0f);
+	leftCylinder->GetTransform()->Rotate(-2.0f * deltaTime, -2.0f * deltaTime, 0.0f);
+	rightCylinder->GetTransform()->Rotate(2.0f * deltaTime, 2.0f * deltaTime, 0.0f);
 
 	for (int i = 0; i < NUM_SPHERES; i++) {
-		std::string sName = "sphere" + i;
+		std::shared_ptr<Transform> transform = spheres[i]->GetTransform();
 
-		XMFLOAT3 pos = FindEntity(sName)->GetTransform()->GetPosition();
+		XMFLOAT3 pos = transform->GetPosition();
 
 		pos.x = sin((totalTime + i) * 0.7f) * 5;
 		pos.z = sin((totalTime + i) * 0.3f) * 5;
 
-		FindEntity(sName)->GetTransform()->SetPosition(pos);
+		transform->SetPosition(pos);
 	}
 
+	// world matrices for everything that moved (and whatever's
+	// under it), in one pass before drawing reads them
+	Transform::GetHierarchy().Update();
+
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::GetInstance().KeyDown(VK_ESCAPE))
 		Quit();
@@ -638,8 +669,14 @@ void Game::Draw(float deltaTime, float totalTime)
 		for (auto& e : entities) {
 
 			std::shared_ptr<Material> mat = e->GetMaterial();
+			std::shared_ptr<Mesh> mesh = e->GetMesh();
+			bool packedVertices = mesh->GetVertexFormat() == VertexFormat::Packed;
 
-			commandList->SetPipelineState(mat->GetPipeLineState().Get());
+			// the input layout has to match the mesh's vertex format
+			if (packedVertices)
+				commandList->SetPipelineState(mat->GetPackedPipeLineState().Get());
+			else
+				commandList->SetPipelineState(mat->GetPipeLineState().Get());
 
 			// vertex shader data
 			{
@@ -649,6 +686,9 @@ void Game::Draw(float deltaTime, float totalTime)
 				vsed.worldInverseTranspose = e->GetTransform()->GetWorldInvTranspose();
 				vsed.viewMatrix = camera->GetView();
 				vsed.projMatrix = camera->GetProjection();
+				vsed.positionScale = mesh->GetPositionScale();
+				vsed.packedVertices = packedVertices;
+				vsed.positionOffset = mesh->GetPositionOffset();
 
 				D3D12_GPU_DESCRIPTOR_HANDLE handle = dx12Helper.FillNextConstantBufferAndGetGPUDescriptorHandle((void*)(&vsed), sizeof(VertexShaderExternalData));
 				commandList->SetGraphicsRootDescriptorTable(0, handle); 
@@ -683,8 +723,11 @@ void Game::Draw(float deltaTime, float totalTime)
 			commandList->IASetVertexBuffers(0, 1, &this_vbv);
 			commandList->IASetIndexBuffer(&this_ibv);
 
-			// Draw
-			commandList->DrawIndexedInstanced(e->GetMesh()->GetIndexCount(), 1, 0, 0, 0);
+			// Draw the coarsest level of detail that's no more than a
+			// pixel off the full mesh at this distance
+			size_t lodIndex = e->GetMesh()->SelectLod(*e->GetTransform(), *camera, (float)windowHeight);
+			MeshLod lod = e->GetMesh()->GetLod(lodIndex);
+			commandList->DrawIndexedInstanced(lod.indexCount, 1, lod.indexOffset, 0, 0);
 		}
 
 	}
@@ -52,6 +52,7 @@ private:
 
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSignature;
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> packedPipelineState;	// for PackedVertex meshes
 
 	Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer;
@@ -65,6 +66,13 @@ private:
 	// entity list
 	std::vector<std::shared_ptr<GameEntity>> entities;
 
+	// the entities Update() animates, kept so it doesn't look them
+	// up by name every frame
+	std::shared_ptr<GameEntity> centerTorus;
+	std::shared_ptr<GameEntity> leftCylinder;
+	std::shared_ptr<GameEntity> rightCylinder;
+	std::vector<std::shared_ptr<GameEntity>> spheres;
+
 	std::shared_ptr<Camera> camera;
 
 	// bronze material
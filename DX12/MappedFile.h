@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// --------------------------------------------------------
+// A whole file mapped read-only into memory
+//
+// - Works on Windows and POSIX, so code built on top of it
+//   (like the OBJ loader) also builds and runs on Linux
+// - The mapping is released when the object is destroyed
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// maps the file; returns false if it can't be opened
+	bool Open(const std::string& path);
+	void Close();
+
+	// **** getters ****
+
+	const char* GetData() const;
+	size_t GetSize() const;
+	bool IsOpen() const;
+
+private:
+	const char* data;
+	size_t size;
+	bool open;
+
+	// platform handles
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int fd;
+#endif
+};
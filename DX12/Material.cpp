@@ -65,6 +65,11 @@ Microsoft::WRL::ComPtr<ID3D12PipelineState> Material::GetPipeLineState()
 	return pipelineState;
 }
 
+Microsoft::WRL::ComPtr<ID3D12PipelineState> Material::GetPackedPipeLineState()
+{
+	return packedPipelineState;
+}
+
 D3D12_GPU_DESCRIPTOR_HANDLE Material::GetFinalGPUHandleForSRVs()
 {
 	return finalGPUHandleForSRVs;
@@ -92,3 +97,8 @@ void Material::SetPipelineState(Microsoft::WRL::ComPtr<ID3D12PipelineState> newP
 {
 	this->pipelineState = newPipeline;
 }
+
+void Material::SetPackedPipelineState(Microsoft::WRL::ComPtr<ID3D12PipelineState> newPipeline)
+{
+	this->packedPipelineState = newPipeline;
+}
@@ -17,6 +17,8 @@ public:
 	DirectX::XMFLOAT2 GetUVScale();
 	DirectX::XMFLOAT2 GetUVOffset();
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> GetPipeLineState();
+	// same shaders, for meshes with packed vertices (see MeshQuantization.h)
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> GetPackedPipeLineState();
 	D3D12_GPU_DESCRIPTOR_HANDLE GetFinalGPUHandleForSRVs();
 
 	// setters
@@ -24,6 +26,7 @@ public:
 	void SetUVScale(DirectX::XMFLOAT2 newScale);
 	void SetUVOffset(DirectX::XMFLOAT2 newOffset);
 	void SetPipelineState(Microsoft::WRL::ComPtr<ID3D12PipelineState> newPipeline);
+	void SetPackedPipelineState(Microsoft::WRL::ComPtr<ID3D12PipelineState> newPipeline);
 
 private:
 	bool finalized;
@@ -33,6 +36,7 @@ private:
 	DirectX::XMFLOAT2 uvOffset;
 
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> packedPipelineState;
 
 	D3D12_CPU_DESCRIPTOR_HANDLE textureSRVsBySlot[4];
 	D3D12_GPU_DESCRIPTOR_HANDLE finalGPUHandleForSRVs;
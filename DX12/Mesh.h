@@ -2,10 +2,14 @@
 
 #include "Vertex.h"
 #include "DX12Helper.h"
+#include "Camera.h"
+#include "MeshData.h"
+#include "Transform.h"
 
 #include <d3d11.h> // for referencing Direct3D stuff
 #include <wrl/client.h> // when using ComPtrs for Direct3D objects
 #include <string>
+#include <vector>
 
 
 class Mesh
@@ -41,6 +45,24 @@ public:
 	int GetIndexCount();
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> GetComandList();
 
+	// levels of detail, each a range of the index buffer (LOD 0
+	// is the full mesh, see MeshSimplifier.h)
+	size_t GetLodCount();
+	MeshLod GetLod(size_t lod);
+	MeshBounds GetBounds();
+
+	// whether the vertex buffer holds PackedVertex (see
+	// MeshQuantization.h) rather than Vertex, and what the vertex
+	// shader multiplies and then offsets positions by to undo it
+	// (one and zero for Vertex)
+	VertexFormat GetVertexFormat();
+	DirectX::XMFLOAT3 GetPositionScale();
+	DirectX::XMFLOAT3 GetPositionOffset();
+
+	// coarsest LOD that looks the same as the full mesh, to within
+	// maxPixelError pixels, where transform puts it in camera's view
+	size_t SelectLod(Transform& transform, Camera& camera, float viewportHeight, float maxPixelError = 1.0f);
+
 	// sets buffers; tells DirectX to draw the correct number of indices
 	void Draw();
 
@@ -52,12 +74,16 @@ private:
 	int indices;
 	int vertices;
 
+	std::vector<MeshLod> lods;
+	MeshBounds bounds;
+	VertexFormat vertexFormat;
+
 	D3D12_VERTEX_BUFFER_VIEW vbView;
 	D3D12_INDEX_BUFFER_VIEW ibView;
 
 	// **** helpers ****
 
-	void CreateBuffers(Vertex* _vertices, int numVertices, unsigned int* _indices, int numIndices, Microsoft::WRL::ComPtr<ID3D12Device> _device);
+	void CreateBuffers(const void* _vertices, unsigned int vertexStride, int numVertices, const unsigned int* _indices, int numIndices, Microsoft::WRL::ComPtr<ID3D12Device> _device);
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 };
 
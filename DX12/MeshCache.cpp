@@ -0,0 +1,207 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+
+namespace
+{
+	const char CacheMagic[8] = { 'M', 'E', 'S', 'H', 'B', 'I', 'N', 0 };
+
+	uint64_t AlignTo16(uint64_t offset)
+	{
+		return (offset + 15) & ~uint64_t(15);
+	}
+
+	// size and last write time of a file; false if it doesn't exist
+	bool GetSourceStamp(const std::string& path, uint64_t& size, int64_t& time)
+	{
+		std::error_code error;
+		std::filesystem::path file(path);
+		size = static_cast<uint64_t>(std::filesystem::file_size(file, error));
+		if (error)
+			return false;
+		time = static_cast<int64_t>(std::filesystem::last_write_time(file, error).time_since_epoch().count());
+		return !error;
+	}
+}
+
+std::string GetMeshCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".meshcache";
+}
+
+bool WriteMeshCache(const std::string& cachePath, const std::string& sourcePath, const MeshData& mesh)
+{
+	MeshCacheHeader header = {};
+	memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+	header.version = MeshCacheVersion;
+	bool packed = !mesh.packedVertices.empty();
+	const void* vertices = packed ? static_cast<const void*>(mesh.packedVertices.data()) : mesh.vertices.data();
+	header.vertexStride = packed ? sizeof(PackedVertex) : sizeof(MeshVertex);
+	header.vertexFormat = static_cast<uint32_t>(packed ? VertexFormat::Packed : VertexFormat::Float);
+	header.vertexCount = mesh.vertices.size();
+	header.indexCount = mesh.indices.size();
+	header.vertexOffset = AlignTo16(sizeof(MeshCacheHeader));
+	header.indexOffset = AlignTo16(header.vertexOffset + header.vertexCount * header.vertexStride);
+	header.lodCount = mesh.lods.size();
+	header.lodOffset = AlignTo16(header.indexOffset + header.indexCount * sizeof(unsigned int));
+	header.bounds = mesh.bounds;
+	if (!sourcePath.empty() && !GetSourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+		return false;
+
+	std::string tempPath = cachePath + ".tmp";
+	FILE* out = nullptr;
+#ifdef _WIN32
+	if (fopen_s(&out, tempPath.c_str(), "wb") != 0)
+		out = nullptr;
+#else
+	out = fopen(tempPath.c_str(), "wb");
+#endif
+	if (!out)
+		return false;
+
+	// header, then each array at its aligned offset
+	const char padding[16] = {};
+	uint64_t written = 0;
+	auto write = [&](const void* data, uint64_t bytes)
+	{
+		written += fwrite(data, 1, static_cast<size_t>(bytes), out);
+	};
+	write(&header, sizeof(header));
+	write(padding, header.vertexOffset - written);
+	write(vertices, header.vertexCount * header.vertexStride);
+	write(padding, header.indexOffset - written);
+	write(mesh.indices.data(), header.indexCount * sizeof(unsigned int));
+	write(padding, header.lodOffset - written);
+	write(mesh.lods.data(), header.lodCount * sizeof(MeshLod));
+
+	bool ok = written == header.lodOffset + header.lodCount * sizeof(MeshLod);
+	ok = fclose(out) == 0 && ok;
+	if (!ok)
+	{
+		remove(tempPath.c_str());
+		return false;
+	}
+
+	// readers never see a half-written cache
+#ifdef _WIN32
+	return MoveFileExA(tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(tempPath.c_str(), cachePath.c_str()) == 0;
+#endif
+}
+
+MeshCache::MeshCache() :
+	header()
+{
+}
+
+bool MeshCache::Open(const std::string& cachePath, const std::string& sourcePath)
+{
+	Close();
+	if (!file.Open(cachePath) || file.GetSize() < sizeof(MeshCacheHeader))
+	{
+		Close();
+		return false;
+	}
+	memcpy(&header, file.GetData(), sizeof(header));
+
+	// right format and layout for this build?
+	bool valid =
+		memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) == 0 &&
+		header.version == MeshCacheVersion &&
+		((header.vertexFormat == static_cast<uint32_t>(VertexFormat::Float) && header.vertexStride == sizeof(MeshVertex)) ||
+		(header.vertexFormat == static_cast<uint32_t>(VertexFormat::Packed) && header.vertexStride == sizeof(PackedVertex)));
+
+	// arrays aligned and inside the file (the divisions keep
+	// garbage counts from overflowing)
+	uint64_t size = file.GetSize();
+	valid = valid &&
+		header.vertexOffset % 16 == 0 && header.indexOffset % 16 == 0 &&
+		header.vertexOffset <= size && header.vertexCount <= (size - header.vertexOffset) / header.vertexStride &&
+		header.indexOffset <= size && header.indexCount <= (size - header.indexOffset) / sizeof(unsigned int) &&
+		header.lodOffset % 16 == 0 && header.lodOffset <= size && header.lodCount <= (size - header.lodOffset) / sizeof(MeshLod) &&
+		header.indexCount % 3 == 0;
+
+	// built from the current version of the source?
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if (valid && !sourcePath.empty() && GetSourceStamp(sourcePath, sourceSize, sourceTime))
+		valid = sourceSize == header.sourceSize && sourceTime == header.sourceTime;
+
+	// every index has to point at a vertex, or the GPU reads garbage,
+	// and every LOD has to be whole triangles of the index array,
+	// starting with the full mesh
+	const unsigned int* indices = GetIndices();
+	for (uint64_t i = 0; valid && i < header.indexCount; i++)
+		valid = indices[i] < header.vertexCount;
+	const MeshLod* lods = GetLods();
+	valid = valid && header.lodCount > 0 && lods[0].indexOffset == 0;
+	for (uint64_t i = 0; valid && i < header.lodCount; i++)
+		valid = lods[i].indexCount % 3 == 0 && lods[i].indexOffset % 3 == 0 &&
+			lods[i].indexOffset <= header.indexCount && lods[i].indexCount <= header.indexCount - lods[i].indexOffset;
+
+	if (!valid)
+		Close();
+	return valid;
+}
+
+void MeshCache::Close()
+{
+	file.Close();
+	header = {};
+}
+
+// **** getters ****
+
+const void* MeshCache::GetVertexData() const
+{
+	return file.GetData() + header.vertexOffset;
+}
+VertexFormat MeshCache::GetVertexFormat() const
+{
+	return static_cast<VertexFormat>(header.vertexFormat);
+}
+size_t MeshCache::GetVertexStride() const
+{
+	return header.vertexStride;
+}
+const MeshVertex* MeshCache::GetVertices() const
+{
+	if (GetVertexFormat() != VertexFormat::Float)
+		return nullptr;
+	return reinterpret_cast<const MeshVertex*>(file.GetData() + header.vertexOffset);
+}
+const unsigned int* MeshCache::GetIndices() const
+{
+	return reinterpret_cast<const unsigned int*>(file.GetData() + header.indexOffset);
+}
+size_t MeshCache::GetVertexCount() const
+{
+	return static_cast<size_t>(header.vertexCount);
+}
+size_t MeshCache::GetIndexCount() const
+{
+	return static_cast<size_t>(header.indexCount);
+}
+const MeshLod* MeshCache::GetLods() const
+{
+	return reinterpret_cast<const MeshLod*>(file.GetData() + header.lodOffset);
+}
+size_t MeshCache::GetLodCount() const
+{
+	return static_cast<size_t>(header.lodCount);
+}
+MeshBounds MeshCache::GetBounds() const
+{
+	return header.bounds;
+}
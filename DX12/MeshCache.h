@@ -0,0 +1,79 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "MeshData.h"
+
+#include <cstdint>
+#include <string>
+
+// --------------------------------------------------------
+// Binary mesh cache: the finished vertex and index arrays
+// (tangents and LODs included) plus bounds, stored exactly as
+// they go into the GPU buffers; vertices are packed (see
+// MeshQuantization.h) whenever the mesh came with packed ones
+//
+// - Written next to the source .OBJ the first time it's loaded
+// - Later loads map the file and hand pointers into the mapping
+//   straight to buffer creation, with no parsing or copies
+// - A cache is only used while its version and vertex layout
+//   match this build and its source file hasn't changed
+// --------------------------------------------------------
+
+// bump whenever the file layout or the data in it changes
+const uint32_t MeshCacheVersion = 6;
+
+struct MeshCacheHeader
+{
+	char magic[8];			// "MESHBIN" and a zero
+	uint32_t version;		// MeshCacheVersion
+	uint32_t vertexStride;		// sizeof(MeshVertex) or sizeof(PackedVertex)
+	uint32_t vertexFormat;		// VertexFormat the vertices are in
+	uint32_t reserved;		// zero; keeps the 64-bit fields aligned
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t vertexOffset;		// from the start of the file, 16-byte aligned
+	uint64_t indexOffset;
+	uint64_t lodCount;		// MeshLod ranges of the index array, LOD 0 first
+	uint64_t lodOffset;
+	MeshBounds bounds;
+	uint64_t sourceSize;		// size and modification time of the file
+	int64_t sourceTime;		// the data came from, to spot stale caches
+};
+
+// where the cache for a source file lives
+std::string GetMeshCachePath(const std::string& sourcePath);
+
+// writes a cache for data built from sourcePath (which may be empty);
+// the file is written under a temporary name and renamed into place
+bool WriteMeshCache(const std::string& cachePath, const std::string& sourcePath, const MeshData& mesh);
+
+// A mapped cache file; pointers stay valid until it's closed
+class MeshCache
+{
+public:
+	MeshCache();
+
+	// maps and validates a cache; if sourcePath is given and that
+	// file exists, it must match what the cache was built from
+	bool Open(const std::string& cachePath, const std::string& sourcePath = "");
+	void Close();
+
+	// **** getters ****
+
+	// the vertices as they go into the buffer, in the format given
+	const void* GetVertexData() const;
+	VertexFormat GetVertexFormat() const;
+	size_t GetVertexStride() const;
+	// null unless the vertices are MeshVertex
+	const MeshVertex* GetVertices() const;
+	const unsigned int* GetIndices() const;
+	size_t GetVertexCount() const;
+	size_t GetIndexCount() const;
+	const MeshLod* GetLods() const;
+	size_t GetLodCount() const;
+	MeshBounds GetBounds() const;
+
+private:
+	MappedFile file;
+	MeshCacheHeader header;
+};
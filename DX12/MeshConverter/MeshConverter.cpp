@@ -0,0 +1,637 @@
+// --------------------------------------------------------
+// Command line converter from .OBJ files to binary mesh
+// caches (see MeshCache.h), with a load-time benchmark of
+// the cache against parsing the .OBJ, a report on what the
+// GPU reordering (see MeshOptimizer.h) gains and headless
+// fly-throughs of the meshlet culler (see Meshlets.h) and the
+// LOD selection (see MeshSimplifier.h), a scaling benchmark
+// of tangent generation (see MeshTangents.h) and a report on
+// vertex packing (see MeshQuantization.h), plus self tests
+// that need no mesh (see SelfTest.h) and a benchmark of the
+// transform hierarchy (see TransformBenchmark.h)
+//
+// Builds on Windows and Linux, e.g.
+//   g++ -std=c++17 -O2 -I.. MeshConverter.cpp SelfTest.cpp
+//       TransformBenchmark.cpp ../MappedFile.cpp
+//       ../ObjLoader.cpp ../MeshData.cpp ../MeshCache.cpp
+//       ../MeshOptimizer.cpp ../MeshQuantization.cpp ../MeshSimplifier.cpp
+//       ../MeshTangents.cpp ../Meshlets.cpp ../TransformHierarchy.cpp -pthread
+// --------------------------------------------------------
+
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshQuantization.h"
+#include "MeshSimplifier.h"
+#include "MeshTangents.h"
+#include "Meshlets.h"
+#include "ObjLoader.h"
+#include "SelfTest.h"
+#include "TransformBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static double Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int Convert(const std::string& input, const std::string& output)
+{
+	MeshData mesh;
+	std::string error;
+	double start = Now();
+	if (!BuildMeshData(input, mesh, error))
+	{
+		fprintf(stderr, "%s: %s\n", input.c_str(), error.c_str());
+		return 1;
+	}
+	if (!WriteMeshCache(output, input, mesh))
+	{
+		fprintf(stderr, "Couldn't write %s\n", output.c_str());
+		return 1;
+	}
+
+	printf("%s -> %s: %zu %s vertices, %u triangles in %zu LODs, bounds (%g %g %g)-(%g %g %g), %.3f s\n",
+		input.c_str(), output.c_str(), mesh.vertices.size(), mesh.packedVertices.empty() ? "float" : "packed",
+		mesh.lods[0].indexCount / 3, mesh.lods.size(),
+		mesh.bounds.Min[0], mesh.bounds.Min[1], mesh.bounds.Min[2],
+		mesh.bounds.Max[0], mesh.bounds.Max[1], mesh.bounds.Max[2], Now() - start);
+	return 0;
+}
+
+// Times both ways of getting a mesh ready for CreateStaticBuffer,
+// ending with the copy into the upload heap that either way needs
+static int Benchmark(const std::string& input, int runs)
+{
+	std::string cachePath = GetMeshCachePath(input);
+	if (Convert(input, cachePath) != 0)
+		return 1;
+
+	std::vector<char> uploadHeap;
+	double objTime = 1e30;
+	double cacheTime = 1e30;
+	size_t fileBytes = 0;
+	size_t cacheBytes = 0;
+
+	for (int run = 0; run < runs; run++)
+	{
+		// parse, reorder, tangents, bounds and LODs, then upload
+		double start = Now();
+		MeshData mesh;
+		std::string error;
+		if (!BuildMeshData(input, mesh, error))
+			return 1;
+		bool packed = !mesh.packedVertices.empty();
+		size_t vertexBytes = mesh.vertices.size() * (packed ? sizeof(PackedVertex) : sizeof(MeshVertex));
+		size_t indexBytes = mesh.indices.size() * sizeof(unsigned int);
+		uploadHeap.resize(std::max(vertexBytes, indexBytes));
+		memcpy(uploadHeap.data(), packed ? static_cast<const void*>(mesh.packedVertices.data()) : mesh.vertices.data(), vertexBytes);
+		memcpy(uploadHeap.data(), mesh.indices.data(), indexBytes);
+		objTime = std::min(objTime, Now() - start);
+
+		// map, validate, then upload straight from the mapping
+		start = Now();
+		MeshCache cache;
+		if (!cache.Open(cachePath, input))
+		{
+			fprintf(stderr, "Couldn't open %s\n", cachePath.c_str());
+			return 1;
+		}
+		memcpy(uploadHeap.data(), cache.GetVertexData(), cache.GetVertexCount() * cache.GetVertexStride());
+		memcpy(uploadHeap.data(), cache.GetIndices(), cache.GetIndexCount() * sizeof(unsigned int));
+		cacheTime = std::min(cacheTime, Now() - start);
+
+		cacheBytes = sizeof(MeshCacheHeader) + vertexBytes + indexBytes;
+	}
+
+	ObjMeshData obj;
+	LoadObj(input, obj);
+	fileBytes = obj.fileBytes;
+
+	printf("%s: obj %.1f MB in %.2f ms, cache %.1f MB in %.2f ms (%.1fx faster)\n",
+		input.c_str(), fileBytes / 1e6, objTime * 1000, cacheBytes / 1e6, cacheTime * 1000, objTime / cacheTime);
+	return 0;
+}
+
+static void PrintStats(const char* label, const MeshData& mesh)
+{
+	const unsigned int* indices = mesh.indices.data();
+	size_t indexCount = mesh.indices.size();
+	size_t vertexCount = mesh.vertices.size();
+	VertexCacheStats cache = AnalyzeVertexCache(indices, indexCount, vertexCount);
+	VertexFetchStats fetch = AnalyzeVertexFetch(indices, indexCount, vertexCount, sizeof(MeshVertex));
+	OverdrawStats overdraw = AnalyzeOverdraw(indices, indexCount, mesh.vertices.data(), vertexCount);
+	printf("  %-9s ACMR %.3f  ATVR %.3f  overfetch %.2f  overdraw %.3f\n",
+		label, cache.acmr, cache.atvr, fetch.overfetch, overdraw.overdraw);
+}
+
+// Vertex cache, fetch and overdraw figures in file order and
+// after each reordering pass
+static int Analyze(const std::string& input)
+{
+	MeshData mesh;
+	std::string error;
+	if (!BuildMeshData(input, mesh, error, false))
+	{
+		fprintf(stderr, "%s: %s\n", input.c_str(), error.c_str());
+		return 1;
+	}
+
+	printf("%s: %zu vertices, %zu triangles, cache size %u\n",
+		input.c_str(), mesh.vertices.size(), mesh.indices.size() / 3, VertexCacheSize);
+	PrintStats("file", mesh);
+
+	double start = Now();
+	OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	double cacheTime = Now() - start;
+	PrintStats("+cache", mesh);
+
+	start = Now();
+	OptimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size());
+	double overdrawTime = Now() - start;
+	PrintStats("+overdraw", mesh);
+
+	start = Now();
+	mesh.vertices.resize(OptimizeVertexFetch(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.size()));
+	double fetchTime = Now() - start;
+	PrintStats("+fetch", mesh);
+
+	printf("  passes took %.2f + %.2f + %.2f ms\n", cacheTime * 1000, overdrawTime * 1000, fetchTime * 1000);
+	return 0;
+}
+
+// **** row-vector matrices, laid out like XMFLOAT4X4 ****
+
+struct Matrix
+{
+	float m[4][4];
+};
+
+static void Identity(float m[4][4])
+{
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			m[i][j] = i == j ? 1.0f : 0.0f;
+}
+
+// same as XMMatrixLookAtLH with +Y up
+static void LookAt(const float eye[3], const float target[3], float m[4][4])
+{
+	float z[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+	float zLength = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+	for (float& c : z)
+		c /= zLength;
+	float x[3] = { z[2], 0, -z[0] };
+	float xLength = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+	for (float& c : x)
+		c /= xLength;
+	float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+	Identity(m);
+	for (int r = 0; r < 3; r++)
+	{
+		m[r][0] = x[r];
+		m[r][1] = y[r];
+		m[r][2] = z[r];
+	}
+	m[3][0] = -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]);
+	m[3][1] = -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]);
+	m[3][2] = -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]);
+}
+
+// view times XMMatrixPerspectiveFovLH
+static void ViewProjection(const float view[4][4], float fov, float aspect, float nearZ, float farZ, float m[4][4])
+{
+	float h = 1.0f / std::tan(fov * 0.5f);
+	float w = h / aspect;
+	float range = farZ / (farZ - nearZ);
+	for (int r = 0; r < 4; r++)
+	{
+		m[r][0] = view[r][0] * w;
+		m[r][1] = view[r][1] * h;
+		m[r][2] = view[r][2] * range + view[r][3] * -nearZ * range;
+		m[r][3] = view[r][2];
+	}
+}
+
+// Builds meshlets, then flies a camera around a grid of instances,
+// culling against each view's own depth buffer; the depth is
+// perfect, so occlusion figures are an upper bound
+static int Meshlets(const std::string& input, int views)
+{
+	MeshData mesh;
+	std::string error;
+	if (!BuildMeshData(input, mesh, error))
+	{
+		fprintf(stderr, "%s: %s\n", input.c_str(), error.c_str());
+		return 1;
+	}
+
+	double start = Now();
+	size_t indexCount = mesh.lods[0].indexCount;
+	MeshletData meshlets = BuildMeshlets(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), indexCount);
+	double buildTime = Now() - start;
+
+	size_t coneCount = 0;
+	for (const Meshlet& m : meshlets.meshlets)
+		coneCount += m.coneCutoff < 1.0f;
+	printf("%s: %zu triangles in %zu meshlets (%.1f vertices, %.1f triangles each, %.0f%% with a usable cone), built in %.1f ms\n",
+		input.c_str(), indexCount / 3, meshlets.meshlets.size(),
+		double(meshlets.vertices.size()) / meshlets.meshlets.size(), double(meshlets.triangles.size() / 3) / meshlets.meshlets.size(),
+		100.0 * coneCount / meshlets.meshlets.size(), buildTime * 1000);
+
+	// a 3x3 grid of instances, spaced a bit over a mesh apart
+	const int grid = 3;
+	const int width = 320;
+	const int height = 180;
+	const MeshBounds& b = mesh.bounds;
+	float center[3], size = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		center[k] = (b.Min[k] + b.Max[k]) * 0.5f;
+		size = std::max(size, b.Max[k] - b.Min[k]);
+	}
+	float spacing = size * 1.25f;
+
+	std::vector<float> depth(width * height);
+	DepthPyramid pyramid;
+	MeshletCullStats total = {};
+	double cullTime = 0;
+	for (int v = 0; v < views; v++)
+	{
+		// circle the grid from outside, slightly above it
+		float angle = 6.2831853f * v / views;
+		float distance = spacing * grid;
+		float eye[3] = { std::cos(angle) * distance, size * 0.75f, std::sin(angle) * distance };
+		float target[3] = { 0, 0, 0 };
+		float view[4][4];
+		LookAt(eye, target, view);
+
+		MeshletCullView cullView = {};
+		ViewProjection(view, 1.0472f, float(width) / height, 0.01f, 1000.0f, cullView.viewProjection);
+		std::copy(eye, eye + 3, cullView.cameraPosition);
+		cullView.occlusion = &pyramid;
+
+		std::vector<Matrix> worlds(grid * grid);
+		for (int i = 0; i < grid * grid; i++)
+		{
+			Identity(worlds[i].m);
+			worlds[i].m[3][0] = (i % grid - (grid - 1) * 0.5f) * spacing - center[0];
+			worlds[i].m[3][1] = -center[1];
+			worlds[i].m[3][2] = (i / grid - (grid - 1) * 0.5f) * spacing - center[2];
+		}
+
+		std::fill(depth.begin(), depth.end(), 1.0f);
+		for (int i = 0; i < grid * grid; i++)
+			RasterizeDepth(mesh.vertices.data(), mesh.indices.data(), indexCount, worlds[i].m, cullView.viewProjection, width, height, depth.data());
+
+		start = Now();
+		pyramid.Build(depth.data(), width, height);
+		MeshletCullStats stats = {};
+		for (int i = 0; i < grid * grid; i++)
+			CullMeshlets(meshlets, worlds[i].m, cullView, stats);
+		cullTime += Now() - start;
+
+		total.meshlets += stats.meshlets;
+		total.triangles += stats.triangles;
+		total.frustumTriangles += stats.frustumTriangles;
+		total.backfaceTriangles += stats.backfaceTriangles;
+		total.occlusionTriangles += stats.occlusionTriangles;
+		total.visibleTriangles += stats.visibleTriangles;
+	}
+
+	double perView = double(total.triangles) / views;
+	printf("  %d views of %d instances (%.0f triangles each view), culled per view:\n", views, grid * grid, perView);
+	printf("    frustum   %10.0f (%4.1f%%)\n", total.frustumTriangles / double(views), 100.0 * total.frustumTriangles / total.triangles);
+	printf("    backface  %10.0f (%4.1f%%)\n", total.backfaceTriangles / double(views), 100.0 * total.backfaceTriangles / total.triangles);
+	printf("    occlusion %10.0f (%4.1f%%)\n", total.occlusionTriangles / double(views), 100.0 * total.occlusionTriangles / total.triangles);
+	printf("    drawn     %10.0f (%4.1f%%)\n", total.visibleTriangles / double(views), 100.0 * total.visibleTriangles / total.triangles);
+	printf("  culling took %.3f ms per view\n", cullTime * 1000 / views);
+	return 0;
+}
+
+// Builds the LOD chain, then flies a camera low over a field of
+// instances at the game's resolution and field of view, picking
+// each visible instance's LOD the way the game does and counting
+// the triangles drawn each frame with and without LODs
+static int Lods(const std::string& input, int frames)
+{
+	MeshData mesh;
+	std::string error;
+	double start = Now();
+	if (!BuildMeshData(input, mesh, error))
+	{
+		fprintf(stderr, "%s: %s\n", input.c_str(), error.c_str());
+		return 1;
+	}
+	double buildTime = Now() - start;
+
+	const MeshBounds& b = mesh.bounds;
+	float center[3], size = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		center[k] = (b.Min[k] + b.Max[k]) * 0.5f;
+		size = std::max(size, b.Max[k] - b.Min[k]);
+	}
+
+	printf("%s: %zu LODs, built with the rest of the mesh in %.1f ms\n", input.c_str(), mesh.lods.size(), buildTime * 1000);
+	for (size_t i = 0; i < mesh.lods.size(); i++)
+	{
+		printf("  LOD %zu %10u triangles (%5.1f%%), error %.4g (%.3f%% of the mesh's size)\n",
+			i, mesh.lods[i].indexCount / 3, 100.0 * mesh.lods[i].indexCount / mesh.lods[0].indexCount,
+			mesh.lods[i].error, 100.0 * mesh.lods[i].error / size);
+	}
+
+	// a grid of instances spaced a few meshes apart, with the camera
+	// flying from one side over the middle row to the other
+	const int grid = 16;
+	const float width = 1280;
+	const float height = 720;
+	const float fov = 0.785398f;
+	const float maxPixelError = 1.0f;
+	float spacing = size * 3.0f;
+	float field = spacing * grid;
+
+	std::vector<size_t> lodInstances(mesh.lods.size(), 0);
+	std::vector<size_t> fullPerFrame, lodPerFrame;
+	size_t visibleInstances = 0;
+	double selectTime = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		float t = frames > 1 ? float(f) / (frames - 1) : 0.5f;
+		float eye[3] = { 0, size, -field * 0.75f + t * field * 1.5f };
+		float target[3] = { eye[0], size * 0.5f, eye[2] + spacing };
+		float view[4][4], viewProjection[4][4];
+		LookAt(eye, target, view);
+		ViewProjection(view, fov, width / height, 0.01f, 1000.0f, viewProjection);
+
+		// the six clip planes, as columns of the matrix
+		float planes[6][4];
+		for (int j = 0; j < 4; j++)
+		{
+			planes[0][j] = viewProjection[j][3] + viewProjection[j][0];
+			planes[1][j] = viewProjection[j][3] - viewProjection[j][0];
+			planes[2][j] = viewProjection[j][3] + viewProjection[j][1];
+			planes[3][j] = viewProjection[j][3] - viewProjection[j][1];
+			planes[4][j] = viewProjection[j][2];
+			planes[5][j] = viewProjection[j][3] - viewProjection[j][2];
+		}
+
+		size_t full = 0, drawn = 0;
+		start = Now();
+		for (int i = 0; i < grid * grid; i++)
+		{
+			Matrix world;
+			Identity(world.m);
+			world.m[3][0] = (i % grid - (grid - 1) * 0.5f) * spacing - center[0];
+			world.m[3][1] = -center[1];
+			world.m[3][2] = (i / grid - (grid - 1) * 0.5f) * spacing - center[2];
+
+			// skip instances whose bounding sphere is out of view
+			float sphere[3] = { world.m[3][0] + center[0], world.m[3][1] + center[1], world.m[3][2] + center[2] };
+			float radius = size * 0.8660254f;
+			bool visible = true;
+			for (const float* plane : planes)
+			{
+				float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+				visible = visible && plane[0] * sphere[0] + plane[1] * sphere[1] + plane[2] * sphere[2] + plane[3] >= -radius * length;
+			}
+			if (!visible)
+				continue;
+
+			size_t lod = SelectMeshLod(mesh.lods.data(), mesh.lods.size(), mesh.bounds, world.m, eye, 1.0f / std::tan(fov * 0.5f), height, maxPixelError);
+			lodInstances[lod]++;
+			visibleInstances++;
+			full += mesh.lods[0].indexCount / 3;
+			drawn += mesh.lods[lod].indexCount / 3;
+		}
+		selectTime += Now() - start;
+		fullPerFrame.push_back(full);
+		lodPerFrame.push_back(drawn);
+	}
+
+	// average, 95th percentile and worst frame: the worst is the
+	// budget the scene needs
+	auto summarize = [](std::vector<size_t> perFrame, double& average, size_t& p95, size_t& worst)
+	{
+		std::sort(perFrame.begin(), perFrame.end());
+		average = 0;
+		for (size_t n : perFrame)
+			average += double(n) / perFrame.size();
+		p95 = perFrame[std::min(perFrame.size() - 1, perFrame.size() * 95 / 100)];
+		worst = perFrame.back();
+	};
+	double fullAverage, lodAverage;
+	size_t fullP95, lodP95, fullWorst, lodWorst;
+	summarize(fullPerFrame, fullAverage, fullP95, fullWorst);
+	summarize(lodPerFrame, lodAverage, lodP95, lodWorst);
+
+	printf("  %d frames over %d instances at %.0fx%.0f, %.1f visible per frame, %.0f pixel error allowed:\n",
+		frames, grid * grid, width, height, double(visibleInstances) / frames, maxPixelError);
+	printf("    triangles per frame   average %10.0f   95th %10zu   worst %10zu\n", fullAverage, fullP95, fullWorst);
+	printf("    with LODs             average %10.0f   95th %10zu   worst %10zu  (%.1f%% of the average)\n",
+		lodAverage, lodP95, lodWorst, 100.0 * lodAverage / std::max(fullAverage, 1.0));
+	printf("    instances at each LOD");
+	for (size_t i = 0; i < lodInstances.size(); i++)
+		printf("   %zu: %4.1f%%", i, 100.0 * lodInstances[i] / std::max<size_t>(visibleInstances, 1));
+	printf("\n  selection took %.3f ms per frame\n", selectTime * 1000 / frames);
+	return 0;
+}
+
+// Times tangent generation at doubling thread counts, reusing
+// one workspace the way a loader would, and checks every count
+// gives the same tangents as one thread
+static int Tangents(const std::string& input, int runs)
+{
+	MeshData mesh;
+	std::string error;
+	if (!BuildMeshData(input, mesh, error, false))
+	{
+		fprintf(stderr, "%s: %s\n", input.c_str(), error.c_str());
+		return 1;
+	}
+
+	unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+	printf("%s: %zu vertices, %zu triangles, %u hardware threads\n",
+		input.c_str(), mesh.vertices.size(), mesh.indices.size() / 3, hardware);
+
+	std::vector<MeshVertex> reference;
+	TangentWorkspace workspace;
+	double serialTime = 0;
+	for (unsigned int threads = 1; threads <= std::max(8u, hardware); threads *= 2)
+	{
+		double best = 1e30;
+		for (int run = 0; run < runs; run++)
+		{
+			double start = Now();
+			CalculateTangents(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), threads, &workspace);
+			best = std::min(best, Now() - start);
+		}
+		if (threads == 1)
+		{
+			reference = mesh.vertices;
+			serialTime = best;
+		}
+
+		// largest angle between this count's tangents and one thread's,
+		// from the chord between them, which stays exact for tiny angles
+		float worstChord = 0;
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+		{
+			const float* a = mesh.vertices[v].Tangent;
+			const float* b = reference[v].Tangent;
+			float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+			worstChord = std::max(worstChord, std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+		}
+		printf("  %2u threads %9.2f ms  %7.1f M triangles/s  %5.2fx  max deviation %.2g degrees\n",
+			threads, best * 1000, mesh.indices.size() / 3 / best / 1e6, serialTime / best,
+			2 * std::asin(std::min(1.0f, worstChord * 0.5f)) * 57.29578f);
+	}
+	return 0;
+}
+
+// Packs the mesh and reports what it saves and what it costs
+// (--selftest checks the codecs themselves against their bounds)
+static int Quantize(const std::string& input)
+{
+	MeshData mesh;
+	std::string error;
+	if (!BuildMeshData(input, mesh, error))
+	{
+		fprintf(stderr, "%s: %s\n", input.c_str(), error.c_str());
+		return 1;
+	}
+
+	std::vector<PackedVertex> packed;
+	QuantizationError worst;
+	double start = Now();
+	bool withinLimits = PackVertices(mesh.vertices.data(), mesh.vertices.size(), mesh.bounds, packed, &worst);
+	double packTime = Now() - start;
+
+	float size = 0;
+	for (int k = 0; k < 3; k++)
+		size = std::max(size, mesh.bounds.Max[k] - mesh.bounds.Min[k]);
+
+	printf("%s: %zu vertices packed in %.1f ms, %s\n", input.c_str(), mesh.vertices.size(), packTime * 1000,
+		withinLimits ? "within limits, the cache and GPU get them packed" : "over the limits, the cache and GPU keep floats");
+	printf("  bytes per vertex  %zu -> %zu (%.1f%%), vertex buffer %.2f -> %.2f MB\n",
+		sizeof(MeshVertex), sizeof(PackedVertex), 100.0 * sizeof(PackedVertex) / sizeof(MeshVertex),
+		mesh.vertices.size() * sizeof(MeshVertex) / 1e6, mesh.vertices.size() * sizeof(PackedVertex) / 1e6);
+	printf("  position error    %.3g (%.2e of the mesh's size, limit %.2e)\n",
+		worst.position * size, worst.position, PackedMaxPositionError);
+	printf("  uv error          %.3g (limit %.3g)\n", worst.uv, PackedMaxUVError);
+	printf("  normal error      %.4f degrees (limit %.4f)\n", worst.normal, PackedMaxAngleError);
+	printf("  tangent error     %.4f degrees (limit %.4f)\n", worst.tangent, PackedMaxAngleError);
+
+	// what drawing the full mesh reads from the vertex buffer
+	const unsigned int* indices = mesh.indices.data();
+	size_t indexCount = mesh.lods[0].indexCount;
+	VertexFetchStats floatFetch = AnalyzeVertexFetch(indices, indexCount, mesh.vertices.size(), sizeof(MeshVertex));
+	VertexFetchStats packedFetch = AnalyzeVertexFetch(indices, indexCount, mesh.vertices.size(), sizeof(PackedVertex));
+	printf("  vertex fetch      %.2f -> %.2f MB per draw (%.1f -> %.1f bytes per triangle)\n",
+		floatFetch.bytesFetched / 1e6, packedFetch.bytesFetched / 1e6,
+		3.0 * floatFetch.bytesFetched / indexCount, 3.0 * packedFetch.bytesFetched / indexCount);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> inputs;
+	std::string output;
+	bool benchmark = false;
+	bool analyze = false;
+	int meshletViews = 0;
+	int lodFrames = 0;
+	bool tangents = false;
+	bool quantize = false;
+	bool selfTest = false;
+	int transformNodes = 0;
+	int runs = 5;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench") == 0)
+			benchmark = true;
+		else if (strcmp(argv[i], "--analyze") == 0)
+			analyze = true;
+		else if (strcmp(argv[i], "--meshlets") == 0 && i + 1 < argc)
+			meshletViews = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--tangents") == 0)
+			tangents = true;
+		else if (strcmp(argv[i], "--quantize") == 0)
+			quantize = true;
+		else if (strcmp(argv[i], "--selftest") == 0)
+			selfTest = true;
+		else if (strcmp(argv[i], "--bench-transforms") == 0 && i + 1 < argc)
+			transformNodes = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc)
+			lodFrames = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+			runs = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if (argv[i][0] != '-')
+			inputs.push_back(argv[i]);
+		else
+			inputs.clear(), i = argc;
+	}
+
+	if (selfTest && inputs.empty())
+		return RunSelfTests();
+	if (transformNodes > 0 && inputs.empty())
+		return RunTransformBenchmark(transformNodes);
+
+	if (inputs.empty() || (!output.empty() && inputs.size() > 1))
+	{
+		fprintf(stderr,
+			"Usage: %s [options] file.obj...\n"
+			"       %s --selftest\n"
+			"       %s --bench-transforms N\n"
+			"  -o FILE        Cache to write for a single input (default: file.obj.meshcache,\n"
+			"                 where the game looks for it)\n"
+			"  --bench        Compare load times of each .OBJ and its cache\n"
+			"  --runs N       Runs per benchmark, keeping the fastest (default 5)\n"
+			"  --analyze      Report vertex cache, fetch and overdraw figures before\n"
+			"                 and after each reordering pass\n"
+			"  --meshlets N   Build meshlets and report culling over N views of a\n"
+			"                 grid of instances\n"
+			"  --lods N       Report the LOD chain and the triangles drawn over N\n"
+			"                 frames of a flight over a field of instances\n"
+			"  --tangents     Time tangent generation on 1, 2, 4... threads\n"
+			"  --quantize     Report the size and error of packing each mesh\n"
+			"  --selftest     Run the checks that need no mesh and exit\n"
+			"  --bench-transforms N\n"
+			"                 Time transform hierarchy updates over N nodes, check\n"
+			"                 them against a recursive product and exit\n",
+			argv[0], argv[0], argv[0]);
+		return 1;
+	}
+
+	int result = 0;
+	for (const std::string& input : inputs)
+	{
+		if (quantize)
+			result |= Quantize(input);
+		else if (tangents)
+			result |= Tangents(input, runs);
+		else if (lodFrames > 0)
+			result |= Lods(input, lodFrames);
+		else if (meshletViews > 0)
+			result |= Meshlets(input, meshletViews);
+		else if (analyze)
+			result |= Analyze(input);
+		else if (benchmark)
+			result |= Benchmark(input, runs);
+		else
+			result |= Convert(input, output.empty() ? GetMeshCachePath(input) : output);
+	}
+	return result;
+}
@@ -0,0 +1,457 @@
+#include "SelfTest.h"
+
+#include "MeshData.h"
+#include "MeshQuantization.h"
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int checkCount = 0;
+	int failureCount = 0;
+
+	// counts a check, and prints it if it failed
+	bool Check(bool condition, const char* test, const char* expression)
+	{
+		checkCount++;
+		if (!condition)
+		{
+			failureCount++;
+			printf("  FAILED %s: %s\n", test, expression);
+		}
+		return condition;
+	}
+
+	// every test function names itself in a local called test
+#define CHECK(condition) Check((condition), test, #condition)
+
+	bool Near(float a, float b, float tolerance = 1e-6f)
+	{
+		return std::fabs(a - b) <= tolerance;
+	}
+
+	// the angle between two unit vectors in degrees, from the chord
+	// between them, which stays exact for tiny angles
+	float AngleBetween(const float* a, const float* b)
+	{
+		float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+		float chord = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		return 2 * std::asin(std::min(1.0f, chord * 0.5f)) * 57.29578f;
+	}
+
+	// a fixed sequence in [0, 1), so every run checks the same values
+	float NextRandom(unsigned int& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	// **** OBJ parsing (see ObjLoader.h) ****
+
+	bool Parse(const char* text, ObjMeshData& mesh)
+	{
+		return ParseObj(text, strlen(text), mesh);
+	}
+
+	bool VertexIs(const ObjVertex& v, float x, float y, float z, float u, float uvV, float nx, float ny, float nz)
+	{
+		return Near(v.Position[0], x) && Near(v.Position[1], y) && Near(v.Position[2], z)
+			&& Near(v.UV[0], u) && Near(v.UV[1], uvV)
+			&& Near(v.Normal[0], nx) && Near(v.Normal[1], ny) && Near(v.Normal[2], nz);
+	}
+
+	// the three kinds of data, each converted to left-handed
+	// space: Z of positions and normals negated, V flipped
+	void TestObjAttributes()
+	{
+		const char* test = "obj attributes";
+		ObjMeshData mesh;
+		CHECK(Parse(
+			"# comment\n"
+			"v 1 2 3\n"
+			"v 4 5 6\r\n"
+			"  v 7 8 9 1\n"
+			"vt 0.25 0.75\n"
+			"vt +0.5\n"
+			"vn 0 0 1\n"
+			"g group\n"
+			"f 1/1/1 2/2/1 3/1/1\n", mesh));
+		CHECK(mesh.positionCount == 3 && mesh.uvCount == 2 && mesh.normalCount == 1 && mesh.faceCount == 1);
+		if (!CHECK(mesh.vertices.size() == 3))
+			return;
+		CHECK(VertexIs(mesh.vertices[0], 1, 2, -3, 0.25f, 0.25f, 0, 0, -1));
+		CHECK(VertexIs(mesh.vertices[1], 4, 5, -6, 0.5f, 1.0f, 0, 0, -1));
+		CHECK(VertexIs(mesh.vertices[2], 7, 8, -9, 0.25f, 0.25f, 0, 0, -1));
+	}
+
+	// v//vn, v/vt and v alone; a corner without a uv gets (0, 1)
+	// after the flip, one without a normal gets zero
+	void TestObjCornerForms()
+	{
+		const char* test = "obj corner forms";
+		ObjMeshData mesh;
+		CHECK(Parse(
+			"v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+			"vt 0.5 0.5\n"
+			"vn 0 1 0\nvn 1 0 0\n"
+			"f 1//1 2//1 3//2\n", mesh));
+		if (CHECK(mesh.vertices.size() == 3))
+		{
+			CHECK(VertexIs(mesh.vertices[0], 0, 0, 0, 0, 1, 0, 1, 0));
+			CHECK(VertexIs(mesh.vertices[2], 0, 1, 0, 0, 1, 1, 0, 0));
+		}
+
+		CHECK(Parse("v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0.5 0.25\nf 1/1 2/1 3/1\n", mesh));
+		if (CHECK(mesh.vertices.size() == 3))
+			CHECK(VertexIs(mesh.vertices[1], 1, 0, 0, 0.5f, 0.75f, 0, 0, 0));
+
+		CHECK(Parse("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n", mesh));
+		if (CHECK(mesh.vertices.size() == 3))
+			CHECK(VertexIs(mesh.vertices[1], 1, 0, 0, 0, 1, 0, 0, 0));
+	}
+
+	// negative indices count back from the most recent element
+	// at the point the face appears
+	void TestObjNegativeIndices()
+	{
+		const char* test = "obj negative indices";
+		ObjMeshData mesh;
+		CHECK(Parse(
+			"v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+			"f -3 -2 -1\n"
+			"v 0 0 1\n"
+			"f -4 -1 -2\n", mesh));
+		CHECK(mesh.vertices.size() == 4);
+		CHECK((mesh.indices == std::vector<unsigned int>{ 0, 2, 1, 0, 2, 3 }));
+		if (mesh.vertices.size() == 4)
+			CHECK(VertexIs(mesh.vertices[3], 0, 0, -1, 0, 1, 0, 0, 0));
+
+		// -1 and the positive index of the same element share a vertex
+		CHECK(Parse("v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nf 1/1 2/-1 3/1\nf -3/1 -1/1 -2/1\n", mesh));
+		CHECK(mesh.vertices.size() == 3 && mesh.indices.size() == 6);
+	}
+
+	// polygons fan out from their first corner, and every triangle's
+	// winding is reversed along with Z
+	void TestObjPolygons()
+	{
+		const char* test = "obj polygons";
+		ObjMeshData mesh;
+		CHECK(Parse("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n", mesh));
+		CHECK((mesh.indices == std::vector<unsigned int>{ 0, 2, 1 }));
+
+		CHECK(Parse("v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3 4\n", mesh));
+		CHECK((mesh.indices == std::vector<unsigned int>{ 0, 2, 1, 0, 3, 2 }));
+		CHECK(mesh.faceCount == 1);
+
+		CHECK(Parse("v 0 0 0\nv 2 0 0\nv 3 1 0\nv 1 2 0\nv -1 1 0\nf 1 2 3 4 5\n", mesh));
+		CHECK((mesh.indices == std::vector<unsigned int>{ 0, 2, 1, 0, 3, 2, 0, 4, 3 }));
+		CHECK(mesh.faceCount == 1 && mesh.vertices.size() == 5);
+	}
+
+	// corners share a vertex only when position, uv and normal
+	// indices all match
+	void TestObjSharing()
+	{
+		const char* test = "obj vertex sharing";
+		ObjMeshData mesh;
+
+		// two quads on a shared edge
+		CHECK(Parse(
+			"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 2 0 0\nv 2 1 0\n"
+			"f 1 2 3 4\n"
+			"f 2 5 6 3\n", mesh));
+		CHECK(mesh.vertices.size() == 6 && mesh.indices.size() == 12);
+		CHECK(Near(static_cast<float>(mesh.GetReuseRatio()), 2.0f));
+
+		// the same position with another uv is another vertex
+		CHECK(Parse(
+			"v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+			"vt 0 0\nvt 1 1\n"
+			"f 1/1 2/1 3/1\n"
+			"f 1/2 3/1 2/1\n", mesh));
+		CHECK(mesh.vertices.size() == 4);
+		CHECK((mesh.indices == std::vector<unsigned int>{ 0, 2, 1, 3, 1, 2 }));
+
+		// and so is the same position with another normal
+		CHECK(Parse("v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nvn 0 1 0\nf 1//1 2//1 3//1\nf 1//2 2//1 3//1\n", mesh));
+		CHECK(mesh.vertices.size() == 4);
+	}
+
+	// malformed input fails with the line and what was wrong
+	void TestObjErrors()
+	{
+		const char* test = "obj errors";
+		struct Case
+		{
+			const char* text;
+			const char* error;
+		};
+		const Case cases[] =
+		{
+			{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n", "line 4: bad position index in face" },
+			{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n", "line 4: bad position index in face" },
+			{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -4 1 2\n", "line 4: bad position index in face" },
+			{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nf a 1 2\n", "line 4: bad position index in face" },
+			{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nf 1/2 2/1 3/1\n", "line 5: bad uv index in face" },
+			{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1//1 2//1 3//1\n", "line 4: bad normal index in face" },
+			{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2\n", "line 4: face with fewer than three corners" },
+			{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nf\t\n", "line 4: face with fewer than three corners" },
+			{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3x\n", "line 4: unexpected character in face" },
+			{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1,2,3\n", "line 4: unexpected character in face" },
+			{ "v 0 0\n", "line 1: expected three numbers after 'v'" },
+			{ "# header\n\nvn 0 1 z\n", "line 3: expected three numbers after 'vn'" },
+			{ "vt\t\n", "line 1: expected a number after 'vt'" },
+			{ "vt 0 q\n", "line 1: bad second number after 'vt'" },
+		};
+
+		for (const Case& c : cases)
+		{
+			ObjMeshData mesh;
+			bool parsed = Parse(c.text, mesh);
+			if (!Check(!parsed && mesh.error == c.error, test, c.error))
+				printf("    got %s\n", parsed ? "success" : mesh.error.c_str());
+		}
+	}
+
+	// **** vertex packing (see MeshQuantization.h) ****
+
+	// every finite half decodes and encodes back to itself, and
+	// floats round to the nearest half (no more than half a step off)
+	void TestHalf()
+	{
+		const char* test = "half floats";
+		size_t misses = 0;
+		for (uint32_t h = 0; h < 0x10000; h++)
+		{
+			if ((h & 0x7c00) != 0x7c00 && EncodeHalf(DecodeHalf(static_cast<uint16_t>(h))) != h)
+				misses++;
+		}
+		CHECK(misses == 0);
+
+		float worstSteps = 0;
+		for (int i = 0; i < 1000000; i++)
+		{
+			float value = (i - 500000) / 7919.0f;
+			float decoded = DecodeHalf(EncodeHalf(value));
+			int exponent;
+			std::frexp(value, &exponent);
+			float step = std::ldexp(1.0f, std::max(exponent, -13) - 11);
+			worstSteps = std::max(worstSteps, std::fabs(decoded - value) / step);
+		}
+		CHECK(worstSteps <= 0.5f);
+
+		CHECK(EncodeHalf(1.0f) == 0x3c00 && EncodeHalf(-2.0f) == 0xc000);
+		CHECK(EncodeHalf(65504.0f) == 0x7bff && EncodeHalf(65520.0f) == 0x7c00);
+		CHECK(DecodeHalf(EncodeHalf(5.9604645e-8f)) == 5.9604645e-8f);
+		CHECK(std::isnan(DecodeHalf(EncodeHalf(std::nanf("")))));
+	}
+
+	// directions spread evenly over the sphere (a Fibonacci
+	// lattice) and the axes, where the octahedron folds, all decode
+	// within the angle packing allows
+	void TestOctahedral()
+	{
+		const char* test = "octahedral directions";
+		float worst = 0;
+		auto roundTrip = [&](const float* v)
+		{
+			int16_t encoded[2];
+			float decoded[3];
+			EncodeOctahedral(v, encoded);
+			DecodeOctahedral(encoded, decoded);
+			worst = std::max(worst, AngleBetween(v, decoded));
+		};
+
+		const int directions = 1000000;
+		for (int i = 0; i < directions; i++)
+		{
+			float z = 1 - (2 * i + 1) / float(directions);
+			float r = std::sqrt(std::max(0.0f, 1 - z * z));
+			float phi = 2.39996323f * i;
+			float v[3] = { r * std::cos(phi), r * std::sin(phi), z };
+			float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+			for (float& c : v)
+				c /= length;
+			roundTrip(v);
+		}
+		for (int axis = 0; axis < 6; axis++)
+		{
+			float v[3] = {};
+			v[axis % 3] = axis < 3 ? 1.0f : -1.0f;
+			roundTrip(v);
+		}
+		CHECK(worst <= PackedMaxAngleError);
+
+		float zero[3] = {};
+		int16_t encoded[2] = { 1, 1 };
+		EncodeOctahedral(zero, encoded);
+		CHECK(encoded[0] == 0 && encoded[1] == 0);
+	}
+
+	// positions decode to within half a 16-bit step of the bounds
+	// on each axis, which is inside the packing limit; a flat axis
+	// decodes to exactly its one value
+	void TestPositionQuantization()
+	{
+		const char* test = "position quantization";
+		MeshBounds bounds = { { -3.0f, 0.5f, 10.0f }, { 5.0f, 0.75f, 10.0f } };
+
+		MeshVertex corners[2] = {};
+		for (int a = 0; a < 3; a++)
+		{
+			corners[0].Position[a] = bounds.Min[a];
+			corners[1].Position[a] = bounds.Max[a];
+		}
+		PackedVertex packed;
+		PackVertex(corners[0], bounds, packed);
+		CHECK(packed.Position[0] == 0 && packed.Position[1] == 0 && packed.Position[2] == 0);
+		PackVertex(corners[1], bounds, packed);
+		CHECK(packed.Position[0] == 65535 && packed.Position[1] == 65535 && packed.Position[2] == 0);
+
+		float worstSteps = 0;
+		bool flatAxisExact = true;
+		unsigned int state = 1;
+		std::vector<MeshVertex> vertices(10000);
+		for (MeshVertex& v : vertices)
+		{
+			v = {};
+			for (int a = 0; a < 3; a++)
+				v.Position[a] = bounds.Min[a] + NextRandom(state) * (bounds.Max[a] - bounds.Min[a]);
+			v.Normal[1] = 1.0f;
+
+			MeshVertex decoded;
+			PackVertex(v, bounds, packed);
+			UnpackVertex(packed, bounds, decoded);
+			for (int a = 0; a < 2; a++)
+			{
+				float step = (bounds.Max[a] - bounds.Min[a]) / 65535;
+				worstSteps = std::max(worstSteps, std::fabs(decoded.Position[a] - v.Position[a]) / step);
+			}
+			flatAxisExact = flatAxisExact && decoded.Position[2] == bounds.Min[2];
+		}
+		// half a step, plus float rounding in the decode
+		CHECK(worstSteps <= 0.5f + 0.01f);
+		CHECK(flatAxisExact);
+
+		std::vector<PackedVertex> packedVertices;
+		QuantizationError error;
+		CHECK(PackVertices(vertices.data(), vertices.size(), bounds, packedVertices, &error));
+		CHECK(packedVertices.size() == vertices.size());
+		CHECK(error.position <= PackedMaxPositionError);
+	}
+
+	// a small grid whose uvs go from 0 to uvScale
+	std::vector<MeshVertex> GridVertices(float uvScale)
+	{
+		std::vector<MeshVertex> vertices;
+		for (int y = 0; y <= 8; y++)
+		{
+			for (int x = 0; x <= 8; x++)
+			{
+				MeshVertex v = {};
+				v.Position[0] = x * 0.125f;
+				v.Position[1] = y * 0.125f;
+				v.UV[0] = (x * 0.125f + 0.0001f) * uvScale;
+				v.UV[1] = (y * 0.125f + 0.0001f) * uvScale;
+				v.Normal[2] = -1.0f;
+				v.Tangent[0] = 1.0f;
+				vertices.push_back(v);
+			}
+		}
+		return vertices;
+	}
+
+	// a mesh packs only if every vertex decodes within every limit;
+	// otherwise BuildMeshData leaves packedVertices empty and the
+	// cache and GPU keep floats
+	void TestPackingFallback()
+	{
+		const char* test = "packing fallback";
+		std::vector<PackedVertex> packed;
+		QuantizationError error;
+
+		std::vector<MeshVertex> vertices = GridVertices(1.0f);
+		MeshBounds bounds = CalculateBounds(vertices.data(), vertices.size());
+		CHECK(PackVertices(vertices.data(), vertices.size(), bounds, packed, &error));
+		CHECK(error.uv <= PackedMaxUVError && error.normal <= PackedMaxAngleError && error.tangent <= PackedMaxAngleError);
+
+		// vertices without a tangent don't count against it
+		vertices[3].Tangent[0] = 0.0f;
+		CHECK(PackVertices(vertices.data(), vertices.size(), bounds, packed, &error));
+
+		// halves step by 1/2 past 1024, well over the uv limit
+		vertices = GridVertices(2000.0f);
+		CHECK(!PackVertices(vertices.data(), vertices.size(), bounds, packed, &error));
+		CHECK(error.uv > PackedMaxUVError);
+
+		// one vertex out of range is enough
+		vertices = GridVertices(1.0f);
+		vertices[40].UV[0] = 1500.3f;
+		CHECK(!PackVertices(vertices.data(), vertices.size(), bounds, packed, &error));
+
+		// and the same rule end to end, through a file in the temp
+		// directory
+		for (float uvScale : { 1.0f, 2000.0f })
+		{
+			std::error_code ignored;
+			std::filesystem::path path = std::filesystem::temp_directory_path(ignored) / "MeshConverterSelfTest.obj";
+			{
+				std::ofstream obj(path);
+				for (const MeshVertex& v : GridVertices(uvScale))
+					obj << "v " << v.Position[0] << ' ' << v.Position[1] << " 0\nvt " << v.UV[0] << ' ' << v.UV[1] << '\n';
+				obj << "vn 0 0 1\n";
+				for (int y = 0; y < 8; y++)
+				{
+					for (int x = 0; x < 8; x++)
+					{
+						int i = y * 9 + x + 1;
+						obj << "f " << i << '/' << i << "/1 " << i + 1 << '/' << i + 1 << "/1 "
+							<< i + 10 << '/' << i + 10 << "/1 " << i + 9 << '/' << i + 9 << "/1\n";
+					}
+				}
+			}
+
+			MeshData mesh;
+			std::string loadError;
+			bool built = BuildMeshData(path.string(), mesh, loadError);
+			std::filesystem::remove(path, ignored);
+			if (!Check(built, test, "BuildMeshData"))
+			{
+				printf("    %s\n", loadError.c_str());
+				continue;
+			}
+			if (uvScale == 1.0f)
+				CHECK(mesh.packedVertices.size() == mesh.vertices.size());
+			else
+				CHECK(mesh.packedVertices.empty());
+		}
+	}
+}
+
+#undef CHECK
+
+int RunSelfTests()
+{
+	TestObjAttributes();
+	TestObjCornerForms();
+	TestObjNegativeIndices();
+	TestObjPolygons();
+	TestObjSharing();
+	TestObjErrors();
+	TestHalf();
+	TestOctahedral();
+	TestPositionQuantization();
+	TestPackingFallback();
+
+	printf("self test: %d checks, %d failed\n", checkCount, failureCount);
+	return failureCount > 0 ? 1 : 0;
+}
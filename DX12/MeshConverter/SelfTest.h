@@ -0,0 +1,9 @@
+#pragma once
+
+// --------------------------------------------------------
+// Checks of the mesh pipeline that need no input files,
+// run by MeshConverter --selftest; each failed check prints
+// what it expected, and the result is non-zero if any failed
+// --------------------------------------------------------
+
+int RunSelfTests();
@@ -0,0 +1,282 @@
+#include "TransformBenchmark.h"
+
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	// frames timed per case, keeping the fastest
+	const int Frames = 50;
+
+	// largest difference allowed between the hierarchy's matrices and
+	// the recursive product, relative to the value (plus one); rounding
+	// differs between the two, a wrong matrix is off by far more
+	const float Tolerance = 1e-4f;
+
+	double Now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// a fixed sequence in [0, 1), so every run builds the same tree
+	float NextRandom(unsigned int& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	// what the hierarchy should hold for each node, by creation order
+	struct ReferenceNode
+	{
+		unsigned int handle;
+		int parent;			// index, or -1
+		bool live;
+		float position[3];
+		float rotation[4];
+		float scale[3];
+	};
+
+	void RandomLocal(ReferenceNode& node, unsigned int& state)
+	{
+		float axis[3];
+		float length;
+		do
+		{
+			for (float& a : axis)
+				a = NextRandom(state) * 2 - 1;
+			length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		} while (length < 0.1f || length > 1);
+		float angle = NextRandom(state) * 6.2831853f;
+		for (int a = 0; a < 3; a++)
+		{
+			node.position[a] = NextRandom(state) * 2 - 1;
+			node.rotation[a] = axis[a] / length * std::sin(angle * 0.5f);
+			node.scale[a] = 0.9f + NextRandom(state) * 0.2f;
+		}
+		node.rotation[3] = std::cos(angle * 0.5f);
+	}
+
+	// the world matrix the slow, obvious way: the local matrix a float
+	// at a time, times the parent's world matrix, found the same way
+	void ReferenceWorld(const std::vector<ReferenceNode>& nodes, int index, float world[4][4])
+	{
+		const ReferenceNode& n = nodes[index];
+		float x = n.rotation[0], y = n.rotation[1], z = n.rotation[2], w = n.rotation[3];
+		float local[4][4] =
+		{
+			{ (1 - 2 * y * y - 2 * z * z) * n.scale[0], (2 * x * y + 2 * z * w) * n.scale[0], (2 * x * z - 2 * y * w) * n.scale[0], 0 },
+			{ (2 * x * y - 2 * z * w) * n.scale[1], (1 - 2 * x * x - 2 * z * z) * n.scale[1], (2 * y * z + 2 * x * w) * n.scale[1], 0 },
+			{ (2 * x * z + 2 * y * w) * n.scale[2], (2 * y * z - 2 * x * w) * n.scale[2], (1 - 2 * x * x - 2 * y * y) * n.scale[2], 0 },
+			{ n.position[0], n.position[1], n.position[2], 1 }
+		};
+		if (n.parent < 0)
+		{
+			std::copy(&local[0][0], &local[0][0] + 16, &world[0][0]);
+			return;
+		}
+
+		float parent[4][4];
+		ReferenceWorld(nodes, n.parent, parent);
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				world[r][c] = 0;
+				for (int k = 0; k < 4; k++)
+					world[r][c] += local[r][k] * parent[k][c];
+			}
+		}
+	}
+
+	// largest relative difference between the hierarchy and the
+	// reference over every live node
+	float WorstDifference(TransformHierarchy& hierarchy, const std::vector<ReferenceNode>& nodes)
+	{
+		float worst = 0;
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			if (!nodes[i].live)
+				continue;
+			float actual[4][4];
+			float expected[4][4];
+			hierarchy.GetWorldMatrix(nodes[i].handle, actual);
+			ReferenceWorld(nodes, static_cast<int>(i), expected);
+			for (int k = 0; k < 16; k++)
+			{
+				float e = expected[k / 4][k % 4];
+				worst = std::max(worst, std::fabs(actual[k / 4][k % 4] - e) / (1 + std::fabs(e)));
+			}
+		}
+		return worst;
+	}
+
+	// ns a node only means something without the reordering
+	void PrintTime(const char* label, size_t updated, double seconds, bool perNode = true)
+	{
+		printf("  %-20s %7zu updated %8.3f ms", label, updated, seconds * 1000);
+		if (perNode && updated > 0)
+			printf("  %5.1f ns/node", seconds * 1e9 / updated);
+		printf("\n");
+	}
+
+	bool IsUnder(const std::vector<ReferenceNode>& nodes, int node, int ancestor)
+	{
+		for (int n = node; n >= 0; n = nodes[n].parent)
+		{
+			if (n == ancestor)
+				return true;
+		}
+		return false;
+	}
+}
+
+int RunTransformBenchmark(size_t nodeCount)
+{
+	if (nodeCount < 2)
+		nodeCount = 2;
+
+	// a forest of a hundred random trees, each node under a random
+	// earlier one, so depths vary like a scene's
+	TransformHierarchy hierarchy;
+	std::vector<ReferenceNode> nodes(nodeCount);
+	unsigned int state = 1;
+	for (size_t i = 0; i < nodeCount; i++)
+	{
+		ReferenceNode& n = nodes[i];
+		n.parent = i < 100 ? -1 : static_cast<int>(NextRandom(state) * i);
+		n.live = true;
+		n.handle = hierarchy.Create(n.parent < 0 ? TransformHierarchy::None : nodes[n.parent].handle);
+		RandomLocal(n, state);
+		hierarchy.SetLocal(n.handle, n.position, n.rotation, n.scale);
+	}
+
+	int depth = 0;
+	for (size_t i = 0; i < nodeCount; i++)
+	{
+		int d = 0;
+		for (int n = nodes[i].parent; n >= 0; n = nodes[n].parent)
+			d++;
+		depth = std::max(depth, d);
+	}
+
+	printf("transform hierarchy: %zu nodes, up to %d deep\n", nodeCount, depth);
+	double start = Now();
+	size_t updated = hierarchy.Update();
+	PrintTime("first, with ordering", updated, Now() - start, false);
+	float worst = WorstDifference(hierarchy, nodes);
+
+	// every node moved, as when everything animates
+	double best = 1e30;
+	for (int frame = 0; frame < Frames; frame++)
+	{
+		for (ReferenceNode& n : nodes)
+		{
+			n.position[1] += 0.001f;
+			hierarchy.SetLocal(n.handle, n.position, n.rotation, n.scale);
+		}
+		start = Now();
+		updated = hierarchy.Update();
+		best = std::min(best, Now() - start);
+	}
+	PrintTime("all moved", updated, best);
+
+	// a few moved, with whatever is under them
+	best = 1e30;
+	for (int frame = 0; frame < Frames; frame++)
+	{
+		for (size_t i = 0; i < nodeCount; i += 100)
+		{
+			ReferenceNode& n = nodes[i];
+			n.position[0] += 0.001f;
+			hierarchy.SetLocal(n.handle, n.position, n.rotation, n.scale);
+		}
+		start = Now();
+		updated = hierarchy.Update();
+		best = std::min(best, Now() - start);
+	}
+	PrintTime("every 100th moved", updated, best);
+
+	best = 1e30;
+	for (int frame = 0; frame < Frames; frame++)
+	{
+		start = Now();
+		updated = hierarchy.Update();
+		best = std::min(best, Now() - start);
+	}
+	PrintTime("none moved", updated, best);
+	worst = std::max(worst, WorstDifference(hierarchy, nodes));
+
+	// move 1% of nodes under random others, or to the top; moves
+	// under their own subtree must be refused, so every tenth tries
+	// to put a node's parent under it
+	size_t moved = 0;
+	size_t refused = 0;
+	bool refusalsRight = true;
+	for (size_t m = 0; m < nodeCount / 100 + 1; m++)
+	{
+		int node = static_cast<int>(NextRandom(state) * nodeCount);
+		int parent = NextRandom(state) < 0.1f ? -1 : static_cast<int>(NextRandom(state) * nodeCount);
+		if (m % 10 == 0 && nodes[node].parent >= 0)
+		{
+			parent = node;
+			node = nodes[node].parent;
+		}
+		bool cycle = parent >= 0 && IsUnder(nodes, parent, node);
+		bool accepted = hierarchy.SetParent(nodes[node].handle, parent < 0 ? TransformHierarchy::None : nodes[parent].handle);
+		refusalsRight = refusalsRight && accepted == !cycle;
+		if (accepted)
+		{
+			nodes[node].parent = parent;
+			moved++;
+		}
+		else
+			refused++;
+	}
+	start = Now();
+	updated = hierarchy.Update();
+	printf("  %zu reparented, %zu refused as cycles\n", moved, refused);
+	PrintTime("then, with ordering", updated, Now() - start, false);
+	worst = std::max(worst, WorstDifference(hierarchy, nodes));
+
+	// destroy 1%, whose children become roots where they are
+	size_t destroyed = 0;
+	for (size_t d = 0; d < nodeCount / 100 + 1; d++)
+	{
+		int node = static_cast<int>(NextRandom(state) * nodeCount);
+		if (!nodes[node].live)
+			continue;
+		hierarchy.Destroy(nodes[node].handle);
+		nodes[node].live = false;
+		for (ReferenceNode& n : nodes)
+		{
+			if (n.parent == node)
+				n.parent = -1;
+		}
+		destroyed++;
+	}
+	start = Now();
+	updated = hierarchy.Update();
+	printf("  %zu destroyed\n", destroyed);
+	PrintTime("then, with ordering", updated, Now() - start, false);
+	worst = std::max(worst, WorstDifference(hierarchy, nodes));
+
+	bool countRight = hierarchy.GetNodeCount() == nodeCount - destroyed;
+	bool parentsRight = true;
+	for (const ReferenceNode& n : nodes)
+	{
+		if (n.live)
+			parentsRight = parentsRight && hierarchy.GetParent(n.handle) == (n.parent < 0 ? TransformHierarchy::None : nodes[n.parent].handle);
+	}
+
+	printf("  largest difference from the recursive product %.2g (limit %.2g)\n", worst, Tolerance);
+	if (!refusalsRight)
+		printf("  FAILED: SetParent refused a move it should have made, or the other way round\n");
+	if (!countRight || !parentsRight)
+		printf("  FAILED: node count or parents don't match after destroying\n");
+	return worst <= Tolerance && refusalsRight && countRight && parentsRight ? 0 : 1;
+}
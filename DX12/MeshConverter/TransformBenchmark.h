@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// Times TransformHierarchy::Update on a random tree of
+// nodeCount nodes (all nodes moved, every 100th moved and
+// none moved), and checks its world matrices against a
+// plain recursive product after building, reparenting and
+// destroying nodes; run by MeshConverter --bench-transforms,
+// non-zero if any matrix was off
+// --------------------------------------------------------
+
+int RunTransformBenchmark(size_t nodeCount);
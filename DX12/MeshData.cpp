@@ -0,0 +1,76 @@
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+#include "MeshQuantization.h"
+#include "MeshSimplifier.h"
+#include "MeshTangents.h"
+#include "ObjLoader.h"
+
+#include <algorithm>
+
+bool BuildMeshData(const std::string& objPath, MeshData& mesh, std::string& error, bool optimize)
+{
+	mesh = MeshData();
+
+	ObjMeshData obj;
+	if (!LoadObj(objPath, obj))
+	{
+		error = obj.error;
+		return false;
+	}
+
+	// copy into the buffer layout, leaving room for tangents
+	mesh.vertices.resize(obj.vertices.size());
+	for (size_t i = 0; i < obj.vertices.size(); i++)
+	{
+		const ObjVertex& v = obj.vertices[i];
+		MeshVertex& out = mesh.vertices[i];
+		std::copy(v.Position, v.Position + 3, out.Position);
+		std::copy(v.UV, v.UV + 2, out.UV);
+		std::copy(v.Normal, v.Normal + 3, out.Normal);
+	}
+	mesh.indices.swap(obj.indices);
+
+	// triangle order for vertex reuse and overdraw, then vertex
+	// order to match
+	if (optimize)
+	{
+		OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		OptimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size());
+		mesh.vertices.resize(OptimizeVertexFetch(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.size()));
+	}
+
+	CalculateTangents(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size());
+	mesh.bounds = CalculateBounds(mesh.vertices.data(), mesh.vertices.size());
+
+	// coarser versions appended to the same index buffer
+	if (optimize)
+		BuildMeshLods(mesh);
+	else
+		mesh.lods.assign(1, { 0, static_cast<unsigned int>(mesh.indices.size()), 0.0f });
+
+	// the compact format, where it's accurate enough
+	if (optimize && !PackVertices(mesh.vertices.data(), mesh.vertices.size(), mesh.bounds, mesh.packedVertices))
+		mesh.packedVertices.clear();
+	return true;
+}
+
+MeshBounds CalculateBounds(const MeshVertex* verts, size_t numVerts)
+{
+	// an empty mesh gets an empty box at the origin
+	MeshBounds bounds = {};
+	if (numVerts == 0)
+		return bounds;
+
+	for (int a = 0; a < 3; a++)
+		bounds.Min[a] = bounds.Max[a] = verts[0].Position[a];
+
+	for (size_t i = 1; i < numVerts; i++)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			bounds.Min[a] = std::min(bounds.Min[a], verts[i].Position[a]);
+			bounds.Max[a] = std::max(bounds.Max[a], verts[i].Position[a]);
+		}
+	}
+	return bounds;
+}
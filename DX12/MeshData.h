@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Mesh data as it goes into the vertex and index buffers,
+// independent of Direct3D so tools can produce it too
+// --------------------------------------------------------
+
+// Same layout as Vertex (see Vertex.h), without DirectXMath
+struct MeshVertex
+{
+	float Position[3];
+	float UV[2];
+	float Normal[3];
+	float Tangent[3];
+};
+
+// The compact 20-byte alternative to MeshVertex (see
+// MeshQuantization.h): positions as 16-bit fractions of the
+// mesh's bounds, half-float uvs, and octahedral normals and
+// tangents in 16-bit pairs
+struct PackedVertex
+{
+	uint16_t Position[4];		// R16G16B16A16_UNORM, w unused
+	uint16_t UV[2];			// R16G16_FLOAT
+	int16_t Normal[2];		// R16G16_SNORM
+	int16_t Tangent[2];		// R16G16_SNORM
+};
+
+// Which of the two a mesh's vertex buffer holds
+enum class VertexFormat : uint32_t
+{
+	Float = 0,			// MeshVertex
+	Packed = 1			// PackedVertex
+};
+
+// Axis-aligned box around all vertex positions
+struct MeshBounds
+{
+	float Min[3];
+	float Max[3];
+};
+
+// A range of the index buffer drawing the mesh at one level of
+// detail (see MeshSimplifier.h); LOD 0 is the full mesh
+struct MeshLod
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	float error;			// largest distance simplification moved any vertex, in the mesh's units (see MeshSimplifier.h)
+};
+
+struct MeshData
+{
+	std::vector<MeshVertex> vertices;
+	std::vector<unsigned int> indices;	// every LOD's triangles, LOD 0 first
+	std::vector<MeshLod> lods;
+	MeshBounds bounds;
+	std::vector<PackedVertex> packedVertices;	// vertices again, if they pack within limits
+};
+
+// loads an .OBJ (see ObjLoader.h), reorders it for the GPU (see
+// MeshOptimizer.h) and builds its LOD chain (see MeshSimplifier.h)
+// unless told not to, and fills in tangents (see MeshTangents.h)
+// and bounds; optimized meshes are also packed (see
+// MeshQuantization.h) when that keeps them within the error limits.
+// Returns false with error set on failure
+bool BuildMeshData(const std::string& objPath, MeshData& mesh, std::string& error, bool optimize = true);
+
+MeshBounds CalculateBounds(const MeshVertex* verts, size_t numVerts);
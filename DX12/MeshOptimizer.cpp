@@ -0,0 +1,439 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace
+{
+	// FIFO cache modeled with one timestamp per vertex: a vertex
+	// is cached if it went in fewer than cacheSize misses ago
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t entries, unsigned int size) :
+			stamps(entries, 0), time(size + 1), size(size)
+		{
+		}
+
+		// true on a miss, which also puts the entry in the cache
+		bool Access(size_t entry)
+		{
+			if (time - stamps[entry] <= size)
+				return false;
+			stamps[entry] = time++;
+			return true;
+		}
+
+		void Clear()
+		{
+			// everything in the cache now is older than its size
+			time += size + 1;
+		}
+
+	private:
+		std::vector<size_t> stamps;
+		size_t time;
+		size_t size;
+	};
+
+	// triangles around each vertex, as offsets into one list
+	struct Adjacency
+	{
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> triangles;
+
+		Adjacency(const unsigned int* indices, size_t indexCount, size_t vertexCount) :
+			offsets(vertexCount + 1, 0), triangles(indexCount)
+		{
+			for (size_t i = 0; i < indexCount; i++)
+				offsets[indices[i] + 1]++;
+			for (size_t v = 0; v < vertexCount; v++)
+				offsets[v + 1] += offsets[v];
+
+			std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indexCount; i++)
+				triangles[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+		}
+	};
+
+	void Cross(const float* a, const float* b, const float* c, float* n)
+	{
+		float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		n[0] = u[1] * v[2] - u[2] * v[1];
+		n[1] = u[2] * v[0] - u[0] * v[2];
+		n[2] = u[0] * v[1] - u[1] * v[0];
+	}
+}
+
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	Adjacency adjacency(indices, indexCount, vertexCount);
+
+	// live triangles left around each vertex
+	std::vector<unsigned int> live(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+	// when each vertex last went into the cache (0: never)
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	size_t time = cacheSize + 1;
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnds;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> result;
+	result.reserve(triangleCount * 3);
+
+	// the next vertex in input order to check when all else fails
+	size_t cursor = 0;
+
+	long long fan = indices[0];
+	while (fan >= 0)
+	{
+		// emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++)
+		{
+			unsigned int t = adjacency.triangles[a];
+			if (emitted[t])
+				continue;
+
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[3 * t + k];
+				result.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		// next: the candidate that's still cached once its own
+		// triangles are emitted, and has been there longest
+		fan = -1;
+		long long best = -1;
+		for (unsigned int v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+
+			long long priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+				priority = static_cast<long long>(time - cacheTime[v]);
+			if (priority > best)
+			{
+				best = priority;
+				fan = v;
+			}
+		}
+
+		// dead end: back up through recent vertices, then
+		// fall back to scanning the input order
+		while (fan < 0 && !deadEnds.empty())
+		{
+			unsigned int v = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[v] > 0)
+				fan = v;
+		}
+		while (fan < 0 && cursor < indexCount)
+		{
+			unsigned int v = indices[cursor++];
+			if (live[v] > 0)
+				fan = v;
+		}
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount, float threshold, unsigned int cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Cluster boundaries.  Tipsify's own restarts (a triangle with
+	// all three vertices missing) are free places to cut; inside
+	// those, a cluster ends once its ACMR from a cold cache gets
+	// within the threshold of the whole stretch's
+	std::vector<size_t> clusterStarts;
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<unsigned int> misses(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		misses[t] = cache.Access(indices[3 * t]) + cache.Access(indices[3 * t + 1]) + cache.Access(indices[3 * t + 2]);
+		if (t == 0 || misses[t] == 3)
+			clusterStarts.push_back(t);
+	}
+	clusterStarts.push_back(triangleCount);
+
+	std::vector<size_t> softStarts;
+	for (size_t c = 0; c + 1 < clusterStarts.size(); c++)
+	{
+		size_t start = clusterStarts[c];
+		size_t end = clusterStarts[c + 1];
+
+		size_t total = 0;
+		for (size_t t = start; t < end; t++)
+			total += misses[t];
+		float limit = threshold * total / (end - start);
+
+		cache.Clear();
+		size_t clusterStart = start;
+		size_t clusterMisses = 0;
+		softStarts.push_back(start);
+		for (size_t t = start; t < end; t++)
+		{
+			for (int k = 0; k < 3; k++)
+				clusterMisses += cache.Access(indices[3 * t + k]);
+
+			// keep the tail from becoming a tiny cluster of its own
+			if (t + 1 < end && clusterMisses <= limit * (t + 1 - clusterStart) && end - (t + 1) >= 8)
+			{
+				softStarts.push_back(t + 1);
+				clusterStart = t + 1;
+				clusterMisses = 0;
+				cache.Clear();
+			}
+		}
+	}
+	size_t clusterCount = softStarts.size();
+	softStarts.push_back(triangleCount);
+
+	// Area-weighted center and normal of each cluster, and of the
+	// whole mesh.  Front faces are clockwise in DirectX's
+	// left-handed space, so the plain cross product points out
+	std::vector<float> clusterData(clusterCount * 6, 0.0f);
+	double meshCenter[3] = { 0, 0, 0 };
+	double meshArea = 0;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float* data = &clusterData[6 * c];
+		float area = 0;
+		for (size_t t = softStarts[c]; t < softStarts[c + 1]; t++)
+		{
+			const float* a = vertices[indices[3 * t]].Position;
+			const float* b = vertices[indices[3 * t + 1]].Position;
+			const float* d = vertices[indices[3 * t + 2]].Position;
+			float n[3];
+			Cross(a, b, d, n);
+			float triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; k++)
+			{
+				data[k] += (a[k] + b[k] + d[k]) / 3.0f * triangleArea;
+				data[3 + k] += n[k];
+			}
+			area += triangleArea;
+		}
+
+		for (int k = 0; k < 3; k++)
+			meshCenter[k] += data[k];
+		meshArea += area;
+		if (area > 0)
+			for (int k = 0; k < 3; k++)
+				data[k] /= area;
+	}
+	for (int k = 0; k < 3; k++)
+		meshCenter[k] = meshArea > 0 ? meshCenter[k] / meshArea : 0;
+
+	// sort key: how far out along its own normal a cluster sits
+	std::vector<float> keys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		const float* data = &clusterData[6 * c];
+		float length = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+		float key = 0;
+		for (int k = 0; k < 3; k++)
+			key += static_cast<float>(data[k] - meshCenter[k]) * data[3 + k];
+		keys[c] = length > 0 ? key / length : 0;
+	}
+
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	std::vector<unsigned int> result;
+	result.reserve(triangleCount * 3);
+	for (size_t c : order)
+		result.insert(result.end(), indices + 3 * softStarts[c], indices + 3 * softStarts[c + 1]);
+	std::copy(result.begin(), result.end(), indices);
+}
+
+size_t OptimizeVertexFetch(MeshVertex* vertices, unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	const unsigned int unused = std::numeric_limits<unsigned int>::max();
+	std::vector<unsigned int> remap(vertexCount, unused);
+	std::vector<MeshVertex> result;
+	result.reserve(vertexCount);
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int& target = remap[indices[i]];
+		if (target == unused)
+		{
+			target = static_cast<unsigned int>(result.size());
+			result.push_back(vertices[indices[i]]);
+		}
+		indices[i] = target;
+	}
+
+	std::copy(result.begin(), result.end(), vertices);
+	return result.size();
+}
+
+// **** analyzers ****
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = {};
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	size_t unique = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		stats.transforms += cache.Access(indices[i]);
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			unique++;
+		}
+	}
+
+	stats.acmr = indexCount ? static_cast<float>(stats.transforms) / (indexCount / 3) : 0;
+	stats.atvr = unique ? static_cast<float>(stats.transforms) / unique : 0;
+	return stats;
+}
+
+VertexFetchStats AnalyzeVertexFetch(const unsigned int* indices, size_t indexCount, size_t vertexCount, size_t vertexSize, unsigned int cacheSize)
+{
+	// 16 KB of 64 byte lines, FIFO like the vertex cache
+	const size_t lineSize = 64;
+	const unsigned int lines = 256;
+
+	VertexFetchStats stats = {};
+	FifoCache vertexCache(vertexCount, cacheSize);
+	FifoCache lineCache((vertexCount * vertexSize + lineSize - 1) / lineSize, lines);
+	std::vector<bool> referenced(vertexCount, false);
+	size_t unique = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			unique++;
+		}
+
+		// vertex data is only read when the vertex shader runs
+		if (!vertexCache.Access(indices[i]))
+			continue;
+
+		size_t first = indices[i] * vertexSize / lineSize;
+		size_t last = (indices[i] * vertexSize + vertexSize - 1) / lineSize;
+		for (size_t line = first; line <= last; line++)
+			stats.bytesFetched += lineCache.Access(line) ? lineSize : 0;
+	}
+
+	stats.overfetch = unique ? static_cast<float>(stats.bytesFetched) / (unique * vertexSize) : 0;
+	return stats;
+}
+
+OverdrawStats AnalyzeOverdraw(const unsigned int* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount)
+{
+	const int resolution = 256;
+	OverdrawStats stats = {};
+	if (vertexCount == 0)
+		return stats;
+
+	MeshBounds bounds = CalculateBounds(vertices, vertexCount);
+	float extent = std::max({ bounds.Max[0] - bounds.Min[0], bounds.Max[1] - bounds.Min[1], bounds.Max[2] - bounds.Min[2] });
+	float scale = extent > 0 ? (resolution - 1) / extent : 0;
+
+	std::vector<float> depth(resolution * resolution);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// the two axes across the screen
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+
+		for (int direction = -1; direction <= 1; direction += 2)
+		{
+			// looking along +axis or -axis
+			std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::infinity());
+
+			for (size_t i = 0; i + 2 < indexCount; i += 3)
+			{
+				const float* p[3] = {
+					vertices[indices[i]].Position,
+					vertices[indices[i + 1]].Position,
+					vertices[indices[i + 2]].Position };
+
+				// only faces pointing back toward the viewer
+				float n[3];
+				Cross(p[0], p[1], p[2], n);
+				if (n[axis] * direction >= 0)
+					continue;
+
+				float x[3], y[3], z[3];
+				for (int k = 0; k < 3; k++)
+				{
+					x[k] = (p[k][u] - bounds.Min[u]) * scale;
+					y[k] = (p[k][v] - bounds.Min[v]) * scale;
+					z[k] = p[k][axis] * direction;
+				}
+
+				float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+				if (area == 0)
+					continue;
+
+				int minX = std::max(0, static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))));
+				int maxX = std::min(resolution - 1, static_cast<int>(std::ceil(std::max({ x[0], x[1], x[2] }))));
+				int minY = std::max(0, static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))));
+				int maxY = std::min(resolution - 1, static_cast<int>(std::ceil(std::max({ y[0], y[1], y[2] }))));
+
+				// edge functions at pixel centers, normalized to barycentrics
+				for (int py = minY; py <= maxY; py++)
+				{
+					for (int px = minX; px <= maxX; px++)
+					{
+						float cx = px + 0.5f;
+						float cy = py + 0.5f;
+						float w0 = ((x[2] - x[1]) * (cy - y[1]) - (cx - x[1]) * (y[2] - y[1])) / area;
+						float w1 = ((x[0] - x[2]) * (cy - y[2]) - (cx - x[2]) * (y[0] - y[2])) / area;
+						float w2 = 1.0f - w0 - w1;
+						if (w0 < 0 || w1 < 0 || w2 < 0)
+							continue;
+
+						float pixelDepth = w0 * z[0] + w1 * z[1] + w2 * z[2];
+						float& stored = depth[py * resolution + px];
+						if (pixelDepth < stored)
+						{
+							stored = pixelDepth;
+							stats.pixelsShaded++;
+						}
+					}
+				}
+			}
+
+			for (float d : depth)
+				stats.pixelsCovered += d != std::numeric_limits<float>::infinity();
+		}
+	}
+
+	stats.overdraw = stats.pixelsCovered ? static_cast<float>(stats.pixelsShaded) / stats.pixelsCovered : 0;
+	return stats;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "MeshData.h"
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// Index and vertex reordering for faster drawing, plus CPU
+// models of the GPU behavior each step improves, so the gains
+// can be checked without a GPU
+//
+// The usual order of the passes is:
+//   1. OptimizeVertexCache  - triangles ordered for vertex reuse
+//   2. OptimizeOverdraw     - clusters of those reordered so
+//                             outer surfaces draw first
+//   3. OptimizeVertexFetch  - vertices stored in first-use order
+// --------------------------------------------------------
+
+// the post-transform cache size the passes and analyzers model
+const unsigned int VertexCacheSize = 16;
+
+struct VertexCacheStats
+{
+	size_t transforms;		// vertex shader runs (cache misses)
+	float acmr;			// transforms per triangle: 3 is no reuse, 0.5 the ideal for big meshes
+	float atvr;			// transforms per referenced vertex: 1 is ideal
+};
+
+struct VertexFetchStats
+{
+	size_t bytesFetched;		// memory read in 64 byte lines
+	float overfetch;		// bytes read per byte of referenced vertex data: 1 is ideal
+};
+
+struct OverdrawStats
+{
+	size_t pixelsCovered;
+	size_t pixelsShaded;
+	float overdraw;			// shaded per covered: 1 is ideal
+};
+
+// Tipsify (Sander, Nehab and Barczak 2007): fans out triangles
+// around each vertex, preferring the next vertex still in the
+// cache that has the most triangles left; linear time
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VertexCacheSize);
+
+// Splits a cache-optimized index buffer into clusters at points
+// where restarting the cache costs at most threshold times the
+// ACMR, then sorts the clusters so ones facing away from the
+// mesh's center draw first and hide what's behind them
+void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount, float threshold = 1.05f, unsigned int cacheSize = VertexCacheSize);
+
+// Moves vertices into the order the indices first use them and
+// drops unused ones; returns the new vertex count
+size_t OptimizeVertexFetch(MeshVertex* vertices, unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+// **** analyzers ****
+
+// FIFO post-transform cache simulation
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VertexCacheSize);
+
+// vertex buffer reads for each transform, through a small cache
+// of 64 byte lines
+VertexFetchStats AnalyzeVertexFetch(const unsigned int* indices, size_t indexCount, size_t vertexCount, size_t vertexSize, unsigned int cacheSize = VertexCacheSize);
+
+// rasterizes front faces from the six axis directions with a
+// depth test and counts how often covered pixels get shaded
+OverdrawStats AnalyzeOverdraw(const unsigned int* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount);
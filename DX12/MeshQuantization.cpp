@@ -0,0 +1,238 @@
+#include "MeshQuantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const float RadiansToDegrees = 57.2957795f;
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	bool Normalize(float* v)
+	{
+		float lengthSquared = Dot(v, v);
+		if (lengthSquared <= 0)
+			return false;
+		float scale = 1.0f / std::sqrt(lengthSquared);
+		v[0] *= scale;
+		v[1] *= scale;
+		v[2] *= scale;
+		return true;
+	}
+
+	// the angle between two unit vectors in degrees, from the chord
+	// between them (acos loses everything near zero)
+	float AngleBetween(const float* a, const float* b)
+	{
+		float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+		float chord = std::sqrt(Dot(d, d));
+		return 2 * std::asin(std::min(1.0f, chord / 2)) * RadiansToDegrees;
+	}
+
+	// like the GPU's snorm conversion: -32768 and -32767 are both -1
+	float DecodeSnorm16(int16_t value)
+	{
+		return std::max(-1.0f, value / 32767.0f);
+	}
+
+	// zero counts as positive, so folding the octahedron's lower
+	// half never lands on its axes
+	float SignNotZero(float value)
+	{
+		return value < 0 ? -1.0f : 1.0f;
+	}
+}
+
+// **** scalar codecs ****
+
+uint16_t EncodeHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t magnitude = bits & 0x7fffffff;
+
+	// infinity and nan stay that way; anything that rounds past the
+	// largest half (65504) becomes infinity
+	if (magnitude >= 0x7f800000)
+		return static_cast<uint16_t>(sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0));
+	if (magnitude >= 0x477ff000)
+		return static_cast<uint16_t>(sign | 0x7c00);
+
+	// below the smallest normal half (2^-14) the steps are 2^-24
+	if (magnitude < 0x38800000)
+	{
+		float absolute;
+		memcpy(&absolute, &magnitude, sizeof(absolute));
+		return static_cast<uint16_t>(sign | static_cast<uint32_t>(std::nearbyint(absolute * 16777216.0f)));
+	}
+
+	// rebias the exponent and round the mantissa to nearest even; a
+	// carry out of the mantissa correctly bumps the exponent
+	uint32_t half = (magnitude - 0x38000000) >> 13;
+	uint32_t rest = magnitude & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return static_cast<uint16_t>(sign | half);
+}
+
+float DecodeHalf(uint16_t half)
+{
+	uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1f;
+	uint32_t mantissa = half & 0x3ff;
+
+	uint32_t bits;
+	if (exponent == 0)
+	{
+		float value = mantissa / 16777216.0f;
+		memcpy(&bits, &value, sizeof(bits));
+		bits |= sign;
+	}
+	else if (exponent == 0x1f)
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	else
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+void EncodeOctahedral(const float* v, int16_t* encoded)
+{
+	float sum = std::fabs(v[0]) + std::fabs(v[1]) + std::fabs(v[2]);
+	if (sum <= 0)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+
+	// project onto the octahedron, then unfold it onto a square
+	float x = v[0] / sum;
+	float y = v[1] / sum;
+	if (v[2] < 0)
+	{
+		float foldedX = (1 - std::fabs(y)) * SignNotZero(x);
+		float foldedY = (1 - std::fabs(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	// rounding each coordinate to nearest isn't always the closest
+	// direction once decoded, so try all four neighbours
+	float baseX = std::floor(x * 32767);
+	float baseY = std::floor(y * 32767);
+	float best = -2;
+	for (int i = 0; i < 4; i++)
+	{
+		int16_t candidate[2] =
+		{
+			static_cast<int16_t>(std::min(32767.0f, std::max(-32767.0f, baseX + (i & 1)))),
+			static_cast<int16_t>(std::min(32767.0f, std::max(-32767.0f, baseY + (i >> 1))))
+		};
+		float decoded[3];
+		DecodeOctahedral(candidate, decoded);
+		float closeness = Dot(decoded, v);
+		if (closeness > best)
+		{
+			best = closeness;
+			encoded[0] = candidate[0];
+			encoded[1] = candidate[1];
+		}
+	}
+}
+
+void DecodeOctahedral(const int16_t* encoded, float* v)
+{
+	float x = DecodeSnorm16(encoded[0]);
+	float y = DecodeSnorm16(encoded[1]);
+	float z = 1 - std::fabs(x) - std::fabs(y);
+	if (z < 0)
+	{
+		float unfoldedX = (1 - std::fabs(y)) * SignNotZero(x);
+		float unfoldedY = (1 - std::fabs(x)) * SignNotZero(y);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+	v[0] = x;
+	v[1] = y;
+	v[2] = z;
+	Normalize(v);
+}
+
+// **** vertices ****
+
+void PackVertex(const MeshVertex& vertex, const MeshBounds& bounds, PackedVertex& packed)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		float size = bounds.Max[a] - bounds.Min[a];
+		float fraction = size > 0 ? (vertex.Position[a] - bounds.Min[a]) / size : 0.0f;
+		packed.Position[a] = static_cast<uint16_t>(std::nearbyint(std::min(1.0f, std::max(0.0f, fraction)) * 65535));
+	}
+	packed.Position[3] = 0;
+	packed.UV[0] = EncodeHalf(vertex.UV[0]);
+	packed.UV[1] = EncodeHalf(vertex.UV[1]);
+
+	float normal[3] = { vertex.Normal[0], vertex.Normal[1], vertex.Normal[2] };
+	float tangent[3] = { vertex.Tangent[0], vertex.Tangent[1], vertex.Tangent[2] };
+	Normalize(normal);
+	Normalize(tangent);
+	EncodeOctahedral(normal, packed.Normal);
+	EncodeOctahedral(tangent, packed.Tangent);
+}
+
+void UnpackVertex(const PackedVertex& packed, const MeshBounds& bounds, MeshVertex& vertex)
+{
+	for (int a = 0; a < 3; a++)
+		vertex.Position[a] = packed.Position[a] / 65535.0f * (bounds.Max[a] - bounds.Min[a]) + bounds.Min[a];
+	vertex.UV[0] = DecodeHalf(packed.UV[0]);
+	vertex.UV[1] = DecodeHalf(packed.UV[1]);
+	DecodeOctahedral(packed.Normal, vertex.Normal);
+	DecodeOctahedral(packed.Tangent, vertex.Tangent);
+}
+
+bool PackVertices(const MeshVertex* vertices, size_t count, const MeshBounds& bounds,
+	std::vector<PackedVertex>& packed, QuantizationError* error)
+{
+	float largest = 0;
+	for (int a = 0; a < 3; a++)
+		largest = std::max(largest, bounds.Max[a] - bounds.Min[a]);
+
+	QuantizationError worst = {};
+	packed.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const MeshVertex& original = vertices[i];
+		PackVertex(original, bounds, packed[i]);
+		MeshVertex decoded;
+		UnpackVertex(packed[i], bounds, decoded);
+
+		for (int a = 0; a < 3; a++)
+		{
+			float offBy = std::fabs(decoded.Position[a] - original.Position[a]);
+			worst.position = std::max(worst.position, largest > 0 ? offBy / largest : 0.0f);
+		}
+		for (int a = 0; a < 2; a++)
+			worst.uv = std::max(worst.uv, std::fabs(decoded.UV[a] - original.UV[a]));
+
+		float normal[3] = { original.Normal[0], original.Normal[1], original.Normal[2] };
+		if (Normalize(normal))
+			worst.normal = std::max(worst.normal, AngleBetween(normal, decoded.Normal));
+		float tangent[3] = { original.Tangent[0], original.Tangent[1], original.Tangent[2] };
+		if (Normalize(tangent))
+			worst.tangent = std::max(worst.tangent, AngleBetween(tangent, decoded.Tangent));
+	}
+
+	if (error)
+		*error = worst;
+
+	return worst.position <= PackedMaxPositionError && worst.uv <= PackedMaxUVError &&
+		worst.normal <= PackedMaxAngleError && worst.tangent <= PackedMaxAngleError;
+}
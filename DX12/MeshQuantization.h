@@ -0,0 +1,58 @@
+#pragma once
+
+#include "MeshData.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// Vertex quantization: MeshVertex's 44 bytes packed into
+// PackedVertex's 20 (see MeshData.h)
+//
+// - Positions become 16-bit unorm fractions of the mesh's
+//   bounds; the vertex shader scales them back with the bounds'
+//   minimum and size
+// - UVs become half floats, rounded to nearest even
+// - Normals and tangents become octahedral maps (Cigolle et al.
+//   2014) in 16-bit snorm pairs, rounded to whichever of the four
+//   nearest pairs decodes closest to the original direction
+// - Vertices without a tangent (zero) decode to +z instead
+//
+// Decoding here matches the GPU's unorm, snorm and half
+// conversions, so the errors measured are the ones drawn
+// --------------------------------------------------------
+
+// the most a mesh's vertices may be off and still get packed
+const float PackedMaxPositionError = 1.0f / 65536;	// fraction of the mesh's largest dimension
+const float PackedMaxUVError = 1.0f / 2048;		// half a texel at 1024x1024
+const float PackedMaxAngleError = 0.01f;		// degrees, normals and tangents
+
+// The largest decode error over a set of vertices
+struct QuantizationError
+{
+	float position;		// fraction of the mesh's largest dimension
+	float uv;
+	float normal;		// degrees
+	float tangent;		// degrees, leaving out vertices without one
+};
+
+// **** scalar codecs ****
+
+uint16_t EncodeHalf(float value);
+float DecodeHalf(uint16_t half);
+
+// v must be unit length (or zero)
+void EncodeOctahedral(const float* v, int16_t* encoded);
+void DecodeOctahedral(const int16_t* encoded, float* v);
+
+// **** vertices ****
+
+void PackVertex(const MeshVertex& vertex, const MeshBounds& bounds, PackedVertex& packed);
+void UnpackVertex(const PackedVertex& packed, const MeshBounds& bounds, MeshVertex& vertex);
+
+// Packs every vertex into packed and measures how far each decodes
+// from the original; returns whether all of them are within the
+// limits above
+bool PackVertices(const MeshVertex* vertices, size_t count, const MeshBounds& bounds,
+	std::vector<PackedVertex>& packed, QuantizationError* error = nullptr);
@@ -0,0 +1,520 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	// Sum of squared distances to a set of planes, weighted by the
+	// area of the triangles they came from:
+	// p'Ap + 2b'p + c over the total weight
+	struct Quadric
+	{
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+	};
+
+	void AddTriangle(Quadric& q, const float* p0, const float* p1, const float* p2)
+	{
+		double u[3] = { double(p1[0]) - p0[0], double(p1[1]) - p0[1], double(p1[2]) - p0[2] };
+		double v[3] = { double(p2[0]) - p0[0], double(p2[1]) - p0[1], double(p2[2]) - p0[2] };
+		double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0)
+			return;
+		for (double& c : n)
+			c /= length;
+		double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+		double area = length * 0.5;
+
+		q.a00 += area * n[0] * n[0];
+		q.a01 += area * n[0] * n[1];
+		q.a02 += area * n[0] * n[2];
+		q.a11 += area * n[1] * n[1];
+		q.a12 += area * n[1] * n[2];
+		q.a22 += area * n[2] * n[2];
+		q.b0 += area * n[0] * d;
+		q.b1 += area * n[1] * d;
+		q.b2 += area * n[2] * d;
+		q.c += area * d * d;
+		q.weight += area;
+	}
+
+	void Accumulate(Quadric& q, const Quadric& other)
+	{
+		q.a00 += other.a00;
+		q.a01 += other.a01;
+		q.a02 += other.a02;
+		q.a11 += other.a11;
+		q.a12 += other.a12;
+		q.a22 += other.a22;
+		q.b0 += other.b0;
+		q.b1 += other.b1;
+		q.b2 += other.b2;
+		q.c += other.c;
+		q.weight += other.weight;
+	}
+
+	// mean squared distance from p to the planes of two quadrics
+	double Error(const Quadric& q, const Quadric& r, const float* p)
+	{
+		double x = p[0], y = p[1], z = p[2];
+		double weight = q.weight + r.weight;
+		if (weight <= 0)
+			return 0;
+		double e =
+			(q.a00 + r.a00) * x * x + (q.a11 + r.a11) * y * y + (q.a22 + r.a22) * z * z +
+			2 * ((q.a01 + r.a01) * x * y + (q.a02 + r.a02) * x * z + (q.a12 + r.a12) * y * z) +
+			2 * ((q.b0 + r.b0) * x + (q.b1 + r.b1) * y + (q.b2 + r.b2) * z) +
+			q.c + r.c;
+		return std::max(e / weight, 0.0);
+	}
+
+	void Normal(const float* p0, const float* p1, const float* p2, float* n)
+	{
+		float u[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float v[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		n[0] = u[1] * v[2] - u[2] * v[1];
+		n[1] = u[2] * v[0] - u[0] * v[2];
+		n[2] = u[0] * v[1] - u[1] * v[0];
+	}
+
+	struct PositionHash
+	{
+		size_t operator()(const float* p) const
+		{
+			uint32_t bits[3];
+			memcpy(bits, p, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const float* a, const float* b) const
+		{
+			return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+		}
+	};
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double error;		// quadric cost, which orders collapses
+	};
+
+	// Edge collapse state that can be taken further and further,
+	// so an LOD chain comes out of a single run with every error
+	// still measured against the original surface
+	class Simplifier
+	{
+	public:
+		Simplifier(const unsigned int* sourceIndices, size_t indexCount, const MeshVertex* sourceVertices, size_t sourceVertexCount) :
+			vertices(sourceVertices),
+			vertexCount(sourceVertexCount),
+			indices(sourceIndices, sourceIndices + indexCount),
+			position(sourceVertexCount),
+			locked(sourceVertexCount, false),
+			quadrics(sourceVertexCount, Quadric()),
+			remap(sourceVertexCount),
+			planeOffsets(sourceVertexCount + 1, 0),
+			clusterNext(sourceVertexCount, NoPosition),
+			clusterTail(sourceVertexCount),
+			errorSquared(0),
+			touched(sourceVertexCount, false),
+			ring(sourceVertexCount, 0)
+		{
+			// vertices at the same position share one id (the first
+			// of them), and more than one vertex there means a seam
+			std::unordered_map<const float*, unsigned int, PositionHash, PositionEqual> first;
+			std::vector<unsigned int> wedges(vertexCount, 0);
+			std::vector<bool> used(vertexCount, false);
+			for (unsigned int index : indices)
+				used[index] = true;
+			for (unsigned int v = 0; v < vertexCount; v++)
+			{
+				remap[v] = v;
+				position[v] = first.emplace(vertices[v].Position, v).first->second;
+				wedges[position[v]] += used[v];
+			}
+			for (unsigned int v = 0; v < vertexCount; v++)
+				locked[v] = wedges[position[v]] > 1;
+
+			// an edge is only safe to collapse across when exactly one
+			// triangle uses it each way round; lock the ends of the rest
+			std::vector<uint64_t> edges;
+			edges.reserve(indices.size());
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					uint64_t a = position[indices[i + e]];
+					uint64_t b = position[indices[i + (e + 1) % 3]];
+					edges.push_back(a << 32 | b);
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			for (size_t i = 0; i < edges.size(); )
+			{
+				size_t run = i + 1;
+				while (run < edges.size() && edges[run] == edges[i])
+					run++;
+				uint64_t reverse = edges[i] << 32 | edges[i] >> 32;
+				auto range = std::equal_range(edges.begin(), edges.end(), reverse);
+				if (run - i != 1 || range.second - range.first != 1)
+				{
+					locked[static_cast<unsigned int>(edges[i] >> 32)] = true;
+					locked[static_cast<unsigned int>(edges[i])] = true;
+				}
+				i = run;
+			}
+
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				const float* p0 = vertices[indices[i]].Position;
+				const float* p1 = vertices[indices[i + 1]].Position;
+				const float* p2 = vertices[indices[i + 2]].Position;
+				for (int k = 0; k < 3; k++)
+					AddTriangle(quadrics[position[indices[i + k]]], p0, p1, p2);
+			}
+
+			// the same planes unweighted, with the triangles around
+			// each position id, for the largest distance a collapse
+			// moves anything from them
+			planes.assign(indices.size() / 3 * 4, 0.0);
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				const float* p0 = vertices[indices[i]].Position;
+				const float* p1 = vertices[indices[i + 1]].Position;
+				const float* p2 = vertices[indices[i + 2]].Position;
+				double u[3] = { double(p1[0]) - p0[0], double(p1[1]) - p0[1], double(p1[2]) - p0[2] };
+				double v[3] = { double(p2[0]) - p0[0], double(p2[1]) - p0[1], double(p2[2]) - p0[2] };
+				double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+				double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (length <= 0)
+					continue;
+				double* plane = &planes[i / 3 * 4];
+				for (int k = 0; k < 3; k++)
+					plane[k] = n[k] / length;
+				plane[3] = -(plane[0] * p0[0] + plane[1] * p0[1] + plane[2] * p0[2]);
+			}
+			for (unsigned int index : indices)
+				planeOffsets[position[index] + 1]++;
+			for (size_t v = 0; v < vertexCount; v++)
+				planeOffsets[v + 1] += planeOffsets[v];
+			planeTriangles.resize(indices.size());
+			std::vector<unsigned int> cursor(planeOffsets.begin(), planeOffsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+				planeTriangles[cursor[position[indices[i]]]++] = static_cast<unsigned int>(i / 3);
+			for (unsigned int v = 0; v < vertexCount; v++)
+				clusterTail[v] = v;
+		}
+
+		// Collapses batches of edges that don't touch each other,
+		// cheapest first, until targetIndexCount is reached or no
+		// collapse left keeps every vertex within maxErrorSquared
+		// (squared) of its original planes
+		void Simplify(size_t targetIndexCount, double maxErrorSquared)
+		{
+			std::vector<Collapse> collapses;
+			while (indices.size() > targetIndexCount)
+			{
+				BuildAdjacency();
+
+				// each interior edge once, in its cheaper direction
+				collapses.clear();
+				for (size_t i = 0; i < indices.size(); i += 3)
+				{
+					for (int e = 0; e < 3; e++)
+					{
+						unsigned int a = indices[i + e];
+						unsigned int b = indices[i + (e + 1) % 3];
+						unsigned int pa = position[a];
+						unsigned int pb = position[b];
+						if (pa >= pb)
+							continue;
+
+						Collapse best = { 0, 0, -1 };
+						if (!locked[pa])
+							best = { a, b, Error(quadrics[pa], quadrics[pb], vertices[b].Position) };
+						if (!locked[pb])
+						{
+							double error = Error(quadrics[pa], quadrics[pb], vertices[a].Position);
+							if (best.error < 0 || error < best.error)
+								best = { b, a, error };
+						}
+						if (best.error >= 0 && best.error <= maxErrorSquared)
+							collapses.push_back(best);
+					}
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+				// an interior collapse removes two triangles
+				size_t wanted = (indices.size() - targetIndexCount) / 6 + 1;
+				size_t applied = 0;
+				std::fill(touched.begin(), touched.end(), false);
+				for (const Collapse& c : collapses)
+				{
+					if (applied == wanted)
+						break;
+					unsigned int pa = position[c.from];
+					unsigned int pb = position[c.to];
+					if (touched[pa] || touched[pb] || !CanCollapse(pa, pb, vertices[c.to].Position))
+						continue;
+
+					// the quadric cost is an area-weighted mean, so a
+					// cheap collapse can still move one plane far
+					double distanceSquared = WorstDistanceSquared(pa, pb, vertices[c.to].Position);
+					if (distanceSquared > maxErrorSquared)
+						continue;
+
+					// nothing else this pass may use a triangle this changes
+					for (unsigned int t = offsets[pa]; t < offsets[pa + 1]; t++)
+						for (int k = 0; k < 3; k++)
+							touched[position[indices[3 * adjacent[t] + k]]] = true;
+
+					remap[c.from] = c.to;
+					Accumulate(quadrics[pb], quadrics[pa]);
+					clusterNext[clusterTail[pb]] = pa;
+					clusterTail[pb] = clusterTail[pa];
+					errorSquared = std::max(errorSquared, distanceSquared);
+					applied++;
+				}
+				if (applied == 0)
+					break;
+
+				// move the indices and drop the triangles that collapsed
+				size_t write = 0;
+				for (size_t i = 0; i < indices.size(); i += 3)
+				{
+					unsigned int a = remap[indices[i]];
+					unsigned int b = remap[indices[i + 1]];
+					unsigned int c = remap[indices[i + 2]];
+					if (position[a] == position[b] || position[b] == position[c] || position[c] == position[a])
+						continue;
+					indices[write++] = a;
+					indices[write++] = b;
+					indices[write++] = c;
+				}
+				indices.resize(write);
+			}
+		}
+
+		const std::vector<unsigned int>& GetIndices() const
+		{
+			return indices;
+		}
+
+		float GetError() const
+		{
+			return static_cast<float>(std::sqrt(errorSquared));
+		}
+
+	private:
+		const MeshVertex* vertices;
+		size_t vertexCount;
+		std::vector<unsigned int> indices;
+		std::vector<unsigned int> position;	// shared id of each vertex's position
+		std::vector<bool> locked;		// by position id
+		std::vector<Quadric> quadrics;		// by position id
+		std::vector<unsigned int> remap;	// where each vertex collapsed to
+
+		// unit normal and offset of each original triangle's plane,
+		// and the original triangles around each position id
+		std::vector<double> planes;
+		std::vector<unsigned int> planeOffsets;
+		std::vector<unsigned int> planeTriangles;
+
+		// position ids collapsed into each remaining one, as a list
+		// through clusterNext starting at the id itself
+		static const unsigned int NoPosition = ~0u;
+		std::vector<unsigned int> clusterNext;
+		std::vector<unsigned int> clusterTail;
+
+		double errorSquared;			// worst of WorstDistanceSquared over every collapse
+
+		// triangles around each position id, rebuilt every pass
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> adjacent;
+
+		// scratch marks
+		std::vector<bool> touched;
+		std::vector<unsigned int> ring;
+		unsigned int ringStamp = 0;
+
+		void BuildAdjacency()
+		{
+			offsets.assign(vertexCount + 1, 0);
+			for (unsigned int index : indices)
+				offsets[position[index] + 1]++;
+			for (size_t v = 0; v < vertexCount; v++)
+				offsets[v + 1] += offsets[v];
+			adjacent.resize(indices.size());
+			std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+				adjacent[cursor[position[indices[i]]]++] = static_cast<unsigned int>(i / 3);
+		}
+
+		// Largest squared distance from target to the original planes
+		// around every position already collapsed into pa or pb
+		double WorstDistanceSquared(unsigned int pa, unsigned int pb, const float* target) const
+		{
+			double worst = 0;
+			for (unsigned int id : { pa, pb })
+			{
+				for (; id != NoPosition; id = clusterNext[id])
+				{
+					for (unsigned int t = planeOffsets[id]; t < planeOffsets[id + 1]; t++)
+					{
+						const double* plane = &planes[4 * planeTriangles[t]];
+						double d = plane[0] * target[0] + plane[1] * target[1] + plane[2] * target[2] + plane[3];
+						worst = std::max(worst, d * d);
+					}
+				}
+			}
+			return worst;
+		}
+
+		// Moving pa onto target mustn't fold any triangle that stays
+		// over, and the two positions may only share the neighbors
+		// across their edge, or the surface pinches
+		bool CanCollapse(unsigned int pa, unsigned int pb, const float* target)
+		{
+			ringStamp += 2;
+			for (unsigned int t = offsets[pa]; t < offsets[pa + 1]; t++)
+			{
+				const unsigned int* triangle = &indices[3 * adjacent[t]];
+				const float* p[3];
+				bool shared = false;
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int id = position[triangle[k]];
+					shared = shared || id == pb;
+					if (id != pa)
+						ring[id] = ringStamp;
+					p[k] = vertices[triangle[k]].Position;
+				}
+				if (shared)
+					continue;
+
+				float before[3], after[3];
+				Normal(p[0], p[1], p[2], before);
+				for (int k = 0; k < 3; k++)
+					if (position[triangle[k]] == pa)
+						p[k] = target;
+				Normal(p[0], p[1], p[2], after);
+				float dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+				float lengths = std::sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+					(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+				if (dot <= 0.25f * lengths)
+					return false;
+			}
+
+			unsigned int common = 0;
+			ring[pb] = ringStamp + 1;
+			for (unsigned int t = offsets[pb]; t < offsets[pb + 1]; t++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int id = position[indices[3 * adjacent[t] + k]];
+					if (ring[id] == ringStamp)
+					{
+						ring[id] = ringStamp + 1;
+						common++;
+					}
+				}
+			}
+			return common == 2;
+		}
+	};
+
+	float LargestDimension(const MeshVertex* vertices, size_t vertexCount)
+	{
+		MeshBounds bounds = CalculateBounds(vertices, vertexCount);
+		return std::max({ bounds.Max[0] - bounds.Min[0], bounds.Max[1] - bounds.Min[1], bounds.Max[2] - bounds.Min[2] });
+	}
+}
+
+size_t SimplifyMesh(unsigned int* destination, const unsigned int* indices, size_t indexCount,
+	const MeshVertex* vertices, size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError)
+{
+	Simplifier simplifier(indices, indexCount, vertices, vertexCount);
+	double maxError = double(targetError) * LargestDimension(vertices, vertexCount);
+	simplifier.Simplify(targetIndexCount, maxError * maxError);
+
+	const std::vector<unsigned int>& result = simplifier.GetIndices();
+	std::copy(result.begin(), result.end(), destination);
+	if (resultError)
+		*resultError = simplifier.GetError();
+	return result.size();
+}
+
+void BuildMeshLods(MeshData& mesh)
+{
+	size_t fullCount = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
+	mesh.indices.resize(fullCount);
+	mesh.lods.assign(1, { 0, static_cast<unsigned int>(fullCount), 0.0f });
+	if (fullCount == 0)
+		return;
+
+	Simplifier simplifier(mesh.indices.data(), fullCount, mesh.vertices.data(), mesh.vertices.size());
+	double maxError = double(MeshLodMaxError) * LargestDimension(mesh.vertices.data(), mesh.vertices.size());
+	for (float ratio : MeshLodRatios)
+	{
+		size_t target = static_cast<size_t>(fullCount / 3 * ratio) * 3;
+		simplifier.Simplify(target, maxError * maxError);
+
+		// not worth another level
+		const std::vector<unsigned int>& lodIndices = simplifier.GetIndices();
+		if (lodIndices.empty() || lodIndices.size() * 10 > size_t(mesh.lods.back().indexCount) * 9)
+			break;
+
+		MeshLod lod = { static_cast<unsigned int>(mesh.indices.size()), static_cast<unsigned int>(lodIndices.size()), simplifier.GetError() };
+		mesh.indices.insert(mesh.indices.end(), lodIndices.begin(), lodIndices.end());
+		OptimizeVertexCache(mesh.indices.data() + lod.indexOffset, lod.indexCount, mesh.vertices.size());
+		mesh.lods.push_back(lod);
+	}
+}
+
+size_t SelectMeshLod(const MeshLod* lods, size_t lodCount, const MeshBounds& bounds, const float world[4][4],
+	const float cameraPosition[3], float projectionScale, float viewportHeight, float maxPixelError)
+{
+	// bounding sphere in world space, grown by the largest scale
+	float center[3], radius = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		float half = (bounds.Max[k] - bounds.Min[k]) * 0.5f;
+		center[k] = bounds.Min[k] + half;
+		radius += half * half;
+	}
+	float worldCenter[3];
+	for (int j = 0; j < 3; j++)
+		worldCenter[j] = center[0] * world[0][j] + center[1] * world[1][j] + center[2] * world[2][j] + world[3][j];
+	float scale = 0;
+	for (int r = 0; r < 3; r++)
+		scale = std::max(scale, world[r][0] * world[r][0] + world[r][1] * world[r][1] + world[r][2] * world[r][2]);
+	scale = std::sqrt(scale);
+	radius = std::sqrt(radius) * scale;
+
+	// inside the bounds, anything could be right in front of the camera
+	float d[3] = { worldCenter[0] - cameraPosition[0], worldCenter[1] - cameraPosition[1], worldCenter[2] - cameraPosition[2] };
+	float distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) - radius;
+	if (distance <= 0)
+		return 0;
+
+	float pixelsPerUnit = projectionScale * viewportHeight * 0.5f / distance;
+	for (size_t i = lodCount; i-- > 1; )
+	{
+		if (lods[i].error * scale * pixelsPerUnit <= maxPixelError)
+			return i;
+	}
+	return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "MeshData.h"
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// Quadric error mesh simplification (Garland and Heckbert
+// 1997) and the level-of-detail chains built with it
+//
+// - Edges collapse onto one of their existing vertices, so
+//   every LOD indexes the mesh's own vertex buffer and only
+//   adds indices
+// - Vertices on open borders, non-manifold edges and uv or
+//   normal seams never move, which keeps holes and texture
+//   seams from opening up
+// - Collapses are ordered by the quadrics' cost, the area-
+//   weighted mean squared distance to the merged planes, but
+//   errors and limits use the worst case: the largest distance,
+//   in the mesh's own units, from any moved vertex to the plane
+//   of an original triangle around it
+// --------------------------------------------------------
+
+// fractions of the full triangle count each LOD aims for
+const float MeshLodRatios[] = { 0.5f, 0.25f, 0.125f };
+
+// no collapse may move the surface further than this fraction
+// of the mesh's largest dimension
+const float MeshLodMaxError = 0.01f;
+
+// Collapses edges, cheapest first, until at most targetIndexCount
+// indices are left or every collapse left would move a vertex
+// further than targetError (a fraction of the mesh's largest
+// dimension) from its original planes; writes
+// the remaining triangles to destination, which may be indices
+// itself, and returns their index count. resultError is the largest
+// such distance reached, in the mesh's units
+size_t SimplifyMesh(unsigned int* destination, const unsigned int* indices, size_t indexCount,
+	const MeshVertex* vertices, size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+// Replaces mesh.lods with the full mesh plus one LOD per ratio in
+// MeshLodRatios, each cache-optimized and appended to the index
+// buffer; the chain stops early once the error limit keeps a level
+// from getting meaningfully smaller than the one before
+void BuildMeshLods(MeshData& mesh);
+
+// Picks the coarsest LOD whose error, projected at the nearest
+// point of the mesh's bounds, covers at most maxPixelError pixels.
+// world is row-vector (like XMFLOAT4X4), projectionScale is the
+// projection matrix's _22 (cot(fov / 2)) and viewportHeight is in
+// pixels
+size_t SelectMeshLod(const MeshLod* lods, size_t lodCount, const MeshBounds& bounds, const float world[4][4],
+	const float cameraPosition[3], float projectionScale, float viewportHeight, float maxPixelError = 1.0f);
@@ -0,0 +1,210 @@
+#include "MeshTangents.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+namespace
+{
+	// below this many triangles per thread, starting threads costs
+	// more than it saves
+	const size_t MinTrianglesPerThread = 16384;
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	bool Normalize(float* v)
+	{
+		float lengthSquared = Dot(v, v);
+		if (lengthSquared <= 0)
+			return false;
+		float scale = 1.0f / std::sqrt(lengthSquared);
+		v[0] *= scale;
+		v[1] *= scale;
+		v[2] *= scale;
+		return true;
+	}
+
+	// removes v's part along the unit vector n and normalizes the rest
+	bool ProjectOntoPlane(float* v, const float* n)
+	{
+		float d = Dot(v, n);
+		v[0] -= n[0] * d;
+		v[1] -= n[1] * d;
+		v[2] -= n[2] * d;
+		return Normalize(v);
+	}
+
+	// runs body(thread) for each thread, the calling thread being 0
+	template <typename Body>
+	void RunThreads(unsigned int threadCount, const Body& body)
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount - 1);
+		for (unsigned int t = 1; t < threadCount; t++)
+			threads.emplace_back(std::cref(body), t);
+		body(0);
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	// Adds each corner's angle-weighted tangent for triangles
+	// [first, last) into sums, which starts at vertex base
+	void AccumulateTriangles(const MeshVertex* verts, const unsigned int* indices, size_t first, size_t last, float* sums, size_t base)
+	{
+		for (size_t t = first; t < last; t++)
+		{
+			const unsigned int* triangle = &indices[3 * t];
+			const MeshVertex& v0 = verts[triangle[0]];
+			const MeshVertex& v1 = verts[triangle[1]];
+			const MeshVertex& v2 = verts[triangle[2]];
+
+			// the u direction across the triangle, flipped where its
+			// uvs wind the other way
+			float d1[3] = { v1.Position[0] - v0.Position[0], v1.Position[1] - v0.Position[1], v1.Position[2] - v0.Position[2] };
+			float d2[3] = { v2.Position[0] - v0.Position[0], v2.Position[1] - v0.Position[1], v2.Position[2] - v0.Position[2] };
+			float s1 = v1.UV[0] - v0.UV[0];
+			float t1 = v1.UV[1] - v0.UV[1];
+			float s2 = v2.UV[0] - v0.UV[0];
+			float t2 = v2.UV[1] - v0.UV[1];
+			float uvArea = s1 * t2 - s2 * t1;
+			if (uvArea == 0)
+				continue;
+			float sign = uvArea < 0 ? -1.0f : 1.0f;
+			float faceTangent[3];
+			for (int k = 0; k < 3; k++)
+				faceTangent[k] = (t2 * d1[k] - t1 * d2[k]) * sign;
+			if (!Normalize(faceTangent))
+				continue;
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const MeshVertex& v = verts[triangle[corner]];
+				const MeshVertex& next = verts[triangle[(corner + 1) % 3]];
+				const MeshVertex& previous = verts[triangle[(corner + 2) % 3]];
+				const float* n = v.Normal;
+
+				// the face tangent in the normal's plane
+				float tangent[3];
+				float d = Dot(faceTangent, n);
+				for (int k = 0; k < 3; k++)
+					tangent[k] = faceTangent[k] - n[k] * d;
+				float tangentLengthSquared = Dot(tangent, tangent);
+				if (tangentLengthSquared <= 0)
+					continue;
+
+				// the corner's angle, measured in the normal's plane;
+				// an edge along the normal counts as a right angle
+				float a[3], b[3];
+				for (int k = 0; k < 3; k++)
+				{
+					a[k] = next.Position[k] - v.Position[k];
+					b[k] = previous.Position[k] - v.Position[k];
+				}
+				float da = Dot(a, n);
+				float db = Dot(b, n);
+				for (int k = 0; k < 3; k++)
+				{
+					a[k] -= n[k] * da;
+					b[k] -= n[k] * db;
+				}
+				float lengths = Dot(a, a) * Dot(b, b);
+				float cosine = lengths > 0 ? Dot(a, b) / std::sqrt(lengths) : 0.0f;
+				float angle = std::acos(std::max(-1.0f, std::min(1.0f, cosine)));
+
+				// normalized tangent times the angle
+				float weight = angle / std::sqrt(tangentLengthSquared);
+				float* sum = &sums[3 * (triangle[corner] - base)];
+				sum[0] += tangent[0] * weight;
+				sum[1] += tangent[1] * weight;
+				sum[2] += tangent[2] * weight;
+			}
+		}
+	}
+}
+
+void CalculateTangents(MeshVertex* verts, size_t numVerts, const unsigned int* indices, size_t numIndices,
+	unsigned int threadCount, TangentWorkspace* workspace)
+{
+	size_t triangleCount = numIndices / 3;
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threadCount, triangleCount / MinTrianglesPerThread)));
+
+	TangentWorkspace local;
+	TangentWorkspace& w = workspace ? *workspace : local;
+	w.ranges.resize(threadCount * 3);
+
+	// the vertices each thread's triangles touch
+	auto triangleRange = [&](unsigned int t, size_t& first, size_t& last)
+	{
+		first = triangleCount * t / threadCount;
+		last = triangleCount * (t + 1) / threadCount;
+	};
+	RunThreads(threadCount, [&](unsigned int t)
+	{
+		size_t first, last;
+		triangleRange(t, first, last);
+		size_t low = numVerts, high = 0;
+		for (size_t i = first * 3; i < last * 3; i++)
+		{
+			low = std::min<size_t>(low, indices[i]);
+			high = std::max<size_t>(high, indices[i] + size_t(1));
+		}
+		w.ranges[3 * t] = std::min(low, high);
+		w.ranges[3 * t + 1] = high;
+	});
+
+	size_t total = 0;
+	for (unsigned int t = 0; t < threadCount; t++)
+	{
+		w.ranges[3 * t + 2] = total;
+		total += 3 * (w.ranges[3 * t + 1] - w.ranges[3 * t]);
+	}
+	if (w.sums.size() < total)
+		w.sums.resize(total);
+
+	// each thread sums its own triangles' corners...
+	RunThreads(threadCount, [&](unsigned int t)
+	{
+		size_t first, last;
+		triangleRange(t, first, last);
+		float* sums = w.sums.data() + w.ranges[3 * t + 2];
+		std::fill(sums, sums + 3 * (w.ranges[3 * t + 1] - w.ranges[3 * t]), 0.0f);
+		AccumulateTriangles(verts, indices, first, last, sums, w.ranges[3 * t]);
+	});
+
+	// ...then each adds up every thread's sums for a slice of the
+	// vertices, in thread order so the result doesn't depend on timing
+	RunThreads(threadCount, [&](unsigned int t)
+	{
+		size_t first = numVerts * t / threadCount;
+		size_t last = numVerts * (t + 1) / threadCount;
+		for (size_t v = first; v < last; v++)
+			verts[v].Tangent[0] = verts[v].Tangent[1] = verts[v].Tangent[2] = 0;
+
+		for (unsigned int u = 0; u < threadCount; u++)
+		{
+			size_t low = std::max(first, w.ranges[3 * u]);
+			size_t high = std::min(last, w.ranges[3 * u + 1]);
+			const float* sums = w.sums.data() + w.ranges[3 * u + 2] + 3 * (low - w.ranges[3 * u]);
+			for (size_t v = low; v < high; v++, sums += 3)
+			{
+				verts[v].Tangent[0] += sums[0];
+				verts[v].Tangent[1] += sums[1];
+				verts[v].Tangent[2] += sums[2];
+			}
+		}
+
+		// every part was already in the normal's plane, so this
+		// only cleans up rounding (zero stays zero)
+		for (size_t v = first; v < last; v++)
+		{
+			if (!ProjectOntoPlane(verts[v].Tangent, verts[v].Normal))
+				verts[v].Tangent[0] = verts[v].Tangent[1] = verts[v].Tangent[2] = 0;
+		}
+	});
+}
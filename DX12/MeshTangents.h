@@ -0,0 +1,52 @@
+#pragma once
+
+#include "MeshData.h"
+
+#include <cstddef>
+#include <vector>
+
+// --------------------------------------------------------
+// Tangent generation that follows MikkTSpace (Mikkelsen 2008),
+// the convention normal map bakers use, split across threads
+//
+// - Each triangle's tangent is its uv-space u direction, with the
+//   sign of its uv winding and normalized, so tiny or stretched
+//   triangles count as much as big ones
+// - Each corner adds that tangent, projected onto the plane of
+//   its vertex normal, weighted by the corner's angle
+// - Triangles with no uv area add nothing; vertices left without
+//   a tangent get zero, like XMVector3Normalize of zero
+//
+// Vertices are shared as the loader produced them (same position,
+// normal and uv), so unlike the reference implementation this
+// never splits a vertex where mirrored uvs meet
+//
+// Only the tangent is stored, not MikkTSpace's bitangent sign:
+// PixelShader.hlsl takes B = cross(T, N) everywhere, so meshes
+// with mirrored uv islands shade those islands with the green
+// channel of a MikkTSpace-baked normal map flipped. Fixing that
+// needs a fourth tangent component through MeshVertex, the
+// packed format, the cache version and the shaders
+//
+// Threads sum into their own slices of a workspace covering only
+// the vertex range their triangles touch, which is small after
+// OptimizeVertexFetch (see MeshOptimizer.h); a second parallel
+// pass adds up the slices for each vertex and normalizes. Threads
+// are started for each of the three passes of every call, which is
+// why small meshes stay on the calling thread
+// --------------------------------------------------------
+
+// Scratch memory that can be kept between calls, so the per-vertex
+// sums for mesh after mesh reuse one buffer (MeshConverter does;
+// BuildMeshData loads one mesh and uses a temporary)
+struct TangentWorkspace
+{
+	std::vector<float> sums;	// 3 per vertex in each thread's range
+	std::vector<size_t> ranges;	// first vertex, last vertex + 1 and offset into sums per thread
+};
+
+// Writes the tangent of every vertex in place; threadCount 0 uses
+// every hardware thread. Results match to rounding whatever the
+// thread count
+void CalculateTangents(MeshVertex* verts, size_t numVerts, const unsigned int* indices, size_t numIndices,
+	unsigned int threadCount = 0, TangentWorkspace* workspace = nullptr);
@@ -0,0 +1,509 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	bool Normalize(float* v)
+	{
+		float length = std::sqrt(Dot(v, v));
+		if (length <= 0)
+			return false;
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+		return true;
+	}
+
+	// unit normal of a triangle; front faces are clockwise in
+	// DirectX's left-handed space, so this points out
+	bool TriangleNormal(const float* a, const float* b, const float* c, float* n)
+	{
+		float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		n[0] = u[1] * v[2] - u[2] * v[1];
+		n[1] = u[2] * v[0] - u[0] * v[2];
+		n[2] = u[0] * v[1] - u[1] * v[0];
+		return Normalize(n);
+	}
+
+	// row vector times matrix: [x y z w] * m
+	void Transform(const float* p, float w, const float m[4][4], float* out)
+	{
+		for (int j = 0; j < 4; j++)
+			out[j] = p[0] * m[0][j] + p[1] * m[1][j] + p[2] * m[2][j] + w * m[3][j];
+	}
+
+	void Multiply(const float a[4][4], const float b[4][4], float out[4][4])
+	{
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				out[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j] + a[i][3] * b[3][j];
+	}
+
+	// sphere and normal cone around a finished meshlet
+	void ComputeBounds(Meshlet& meshlet, const MeshletData& data, const MeshVertex* vertices)
+	{
+		const unsigned int* meshletVertices = &data.vertices[meshlet.vertexOffset];
+		const unsigned char* triangles = &data.triangles[meshlet.triangleOffset * 3];
+
+		// sphere around the center of the box
+		float minimum[3], maximum[3];
+		for (int k = 0; k < 3; k++)
+			minimum[k] = maximum[k] = vertices[meshletVertices[0]].Position[k];
+		for (unsigned int i = 1; i < meshlet.vertexCount; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				minimum[k] = std::min(minimum[k], vertices[meshletVertices[i]].Position[k]);
+				maximum[k] = std::max(maximum[k], vertices[meshletVertices[i]].Position[k]);
+			}
+		}
+		for (int k = 0; k < 3; k++)
+			meshlet.center[k] = (minimum[k] + maximum[k]) * 0.5f;
+
+		float radiusSquared = 0;
+		for (unsigned int i = 0; i < meshlet.vertexCount; i++)
+		{
+			const float* p = vertices[meshletVertices[i]].Position;
+			float d[3] = { p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2] };
+			radiusSquared = std::max(radiusSquared, Dot(d, d));
+		}
+		meshlet.radius = std::sqrt(radiusSquared);
+
+		// cone axis: the average facing direction
+		float axis[3] = { 0, 0, 0 };
+		std::vector<float> normals(meshlet.triangleCount * 3, 0.0f);
+		for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+		{
+			float* n = &normals[3 * t];
+			if (!TriangleNormal(
+				vertices[meshletVertices[triangles[3 * t]]].Position,
+				vertices[meshletVertices[triangles[3 * t + 1]]].Position,
+				vertices[meshletVertices[triangles[3 * t + 2]]].Position, n))
+				continue;
+			for (int k = 0; k < 3; k++)
+				axis[k] += n[k];
+		}
+
+		// a cone that can't cull anything unless the normals all
+		// lie within about 84 degrees of the axis
+		std::copy(meshlet.center, meshlet.center + 3, meshlet.coneApex);
+		std::fill(meshlet.coneAxis, meshlet.coneAxis + 3, 0.0f);
+		meshlet.coneCutoff = 1.0f;
+		if (!Normalize(axis))
+			return;
+
+		float minDot = 1.0f;
+		for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+		{
+			const float* n = &normals[3 * t];
+			if (Dot(n, n) > 0)
+				minDot = std::min(minDot, Dot(axis, n));
+		}
+		std::copy(axis, axis + 3, meshlet.coneAxis);
+		if (minDot <= 0.1f)
+			return;
+
+		// move the apex back along the axis until every triangle's
+		// plane is in front of it, so the test holds for viewers
+		// anywhere, not just far away
+		float maxT = 0;
+		for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+		{
+			const float* n = &normals[3 * t];
+			if (Dot(n, n) == 0)
+				continue;
+			const float* p = vertices[meshletVertices[triangles[3 * t]]].Position;
+			float toCenter[3] = { meshlet.center[0] - p[0], meshlet.center[1] - p[1], meshlet.center[2] - p[2] };
+			maxT = std::max(maxT, Dot(toCenter, n) / Dot(axis, n));
+		}
+		for (int k = 0; k < 3; k++)
+			meshlet.coneApex[k] = meshlet.center[k] - axis[k] * maxT;
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+MeshletData BuildMeshlets(const MeshVertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount)
+{
+	MeshletData data;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return data;
+
+	// triangles around each vertex
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < indexCount; i++)
+		offsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> adjacent(indexCount);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indexCount; i++)
+		adjacent[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+	// triangles not yet in a meshlet around each vertex
+	std::vector<unsigned int> live(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		live[v] = offsets[v + 1] - offsets[v];
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<int> localIndex(vertexCount, -1);
+	std::vector<unsigned int> candidates;
+
+	Meshlet meshlet = {};
+	size_t seed = 0;
+
+	auto newVertices = [&](size_t t)
+	{
+		return (localIndex[indices[3 * t]] < 0) + (localIndex[indices[3 * t + 1]] < 0) + (localIndex[indices[3 * t + 2]] < 0);
+	};
+
+	// triangles whose vertices have few others left are the ones
+	// that would otherwise be stranded in small leftover meshlets
+	auto liveNeighbors = [&](size_t t)
+	{
+		return live[indices[3 * t]] + live[indices[3 * t + 1]] + live[indices[3 * t + 2]];
+	};
+
+	auto finish = [&]()
+	{
+		ComputeBounds(meshlet, data, vertices);
+		data.meshlets.push_back(meshlet);
+		for (unsigned int i = 0; i < meshlet.vertexCount; i++)
+			localIndex[data.vertices[meshlet.vertexOffset + i]] = -1;
+
+		meshlet = {};
+		meshlet.vertexOffset = static_cast<unsigned int>(data.vertices.size());
+		meshlet.triangleOffset = static_cast<unsigned int>(data.triangles.size() / 3);
+	};
+
+	for (;;)
+	{
+		// the neighbor adding the fewest vertices, then the one with
+		// the fewest live neighbors, dropping candidates that were
+		// emitted since they were found
+		long long best = -1;
+		int bestNew = 4;
+		unsigned int bestLive = 0;
+		for (size_t c = 0; c < candidates.size(); )
+		{
+			unsigned int t = candidates[c];
+			if (emitted[t])
+			{
+				candidates[c] = candidates.back();
+				candidates.pop_back();
+				continue;
+			}
+			int added = newVertices(t);
+			unsigned int neighbors = liveNeighbors(t);
+			if (meshlet.vertexCount + added <= MeshletMaxVertices && (added < bestNew || (added == bestNew && neighbors < bestLive)))
+			{
+				best = t;
+				bestNew = added;
+				bestLive = neighbors;
+			}
+			c++;
+		}
+
+		// full, or nothing nearby fits: start another meshlet from
+		// the old one's border, where the fewest triangles are left
+		if (meshlet.triangleCount == MeshletMaxTriangles || (best < 0 && meshlet.triangleCount > 0))
+		{
+			finish();
+			best = -1;
+			for (unsigned int t : candidates)
+			{
+				if (!emitted[t] && (best < 0 || liveNeighbors(t) < bestLive))
+				{
+					best = t;
+					bestLive = liveNeighbors(t);
+				}
+			}
+			candidates.clear();
+		}
+
+		// nothing left nearby: the next triangle in index order
+		if (best < 0)
+		{
+			while (seed < triangleCount && emitted[seed])
+				seed++;
+			if (seed == triangleCount)
+				break;
+			best = static_cast<long long>(seed);
+		}
+
+		// add the triangle and queue up its neighbors
+		size_t t = static_cast<size_t>(best);
+		emitted[t] = true;
+		meshlet.triangleCount++;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[3 * t + k];
+			live[v]--;
+			if (localIndex[v] < 0)
+			{
+				localIndex[v] = static_cast<int>(meshlet.vertexCount++);
+				data.vertices.push_back(v);
+			}
+			data.triangles.push_back(static_cast<unsigned char>(localIndex[v]));
+
+			for (unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+				if (!emitted[adjacent[a]])
+					candidates.push_back(adjacent[a]);
+		}
+	}
+
+	if (meshlet.triangleCount > 0)
+		finish();
+	return data;
+}
+
+// **** culling ****
+
+void DepthPyramid::Build(const float* depth, int width, int height)
+{
+	levels.clear();
+	widths.clear();
+	heights.clear();
+
+	levels.push_back(std::vector<float>(depth, depth + static_cast<size_t>(width) * height));
+	widths.push_back(width);
+	heights.push_back(height);
+
+	// each texel keeps the farthest of the (up to) 2x2 below it
+	while (widths.back() > 1 || heights.back() > 1)
+	{
+		const std::vector<float>& below = levels.back();
+		int belowWidth = widths.back();
+		int belowHeight = heights.back();
+		int levelWidth = (belowWidth + 1) / 2;
+		int levelHeight = (belowHeight + 1) / 2;
+
+		std::vector<float> level(static_cast<size_t>(levelWidth) * levelHeight);
+		for (int y = 0; y < levelHeight; y++)
+		{
+			for (int x = 0; x < levelWidth; x++)
+			{
+				int x0 = 2 * x, x1 = std::min(2 * x + 1, belowWidth - 1);
+				int y0 = 2 * y, y1 = std::min(2 * y + 1, belowHeight - 1);
+				level[y * levelWidth + x] = std::max(
+					std::max(below[y0 * belowWidth + x0], below[y0 * belowWidth + x1]),
+					std::max(below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]));
+			}
+		}
+
+		levels.push_back(std::move(level));
+		widths.push_back(levelWidth);
+		heights.push_back(levelHeight);
+	}
+}
+
+bool DepthPyramid::IsOccluded(float minX, float minY, float maxX, float maxY, float nearestDepth) const
+{
+	if (levels.empty())
+		return false;
+
+	int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+	int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+	int x1 = std::min(widths[0] - 1, static_cast<int>(std::floor(maxX)));
+	int y1 = std::min(heights[0] - 1, static_cast<int>(std::floor(maxY)));
+	if (x0 > x1 || y0 > y1)
+		return false;
+
+	// the first level where the rectangle spans at most 2x2
+	// texels (3x3 if it straddles their edges)
+	size_t level = 0;
+	while (level + 1 < levels.size() && (std::max(x1 - x0, y1 - y0) >> level) > 1)
+		level++;
+
+	int w = widths[level];
+	float farthest = 0;
+	for (int y = y0 >> level; y <= (y1 >> level); y++)
+		for (int x = x0 >> level; x <= (x1 >> level); x++)
+			farthest = std::max(farthest, levels[level][y * w + x]);
+
+	return nearestDepth > farthest;
+}
+
+int DepthPyramid::GetWidth() const
+{
+	return widths.empty() ? 0 : widths[0];
+}
+int DepthPyramid::GetHeight() const
+{
+	return heights.empty() ? 0 : heights[0];
+}
+
+void RasterizeDepth(const MeshVertex* vertices, const unsigned int* indices, size_t indexCount,
+	const float world[4][4], const float viewProjection[4][4], int width, int height, float* depth)
+{
+	float worldViewProjection[4][4];
+	Multiply(world, viewProjection, worldViewProjection);
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		// screen position and depth of each corner; triangles
+		// crossing the near plane are skipped, which only ever
+		// makes the buffer less occluding
+		float x[3], y[3], z[3];
+		bool behind = false;
+		for (int k = 0; k < 3; k++)
+		{
+			float clip[4];
+			Transform(vertices[indices[i + k]].Position, 1.0f, worldViewProjection, clip);
+			if (clip[3] <= 1e-5f)
+			{
+				behind = true;
+				break;
+			}
+			x[k] = (clip[0] / clip[3] * 0.5f + 0.5f) * width;
+			y[k] = (0.5f - clip[1] / clip[3] * 0.5f) * height;
+			z[k] = clip[2] / clip[3];
+		}
+		if (behind)
+			continue;
+
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area == 0)
+			continue;
+
+		int minX = std::max(0, static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))));
+		int maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max({ x[0], x[1], x[2] }))));
+		int minY = std::max(0, static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))));
+		int maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max({ y[0], y[1], y[2] }))));
+
+		for (int py = minY; py <= maxY; py++)
+		{
+			for (int px = minX; px <= maxX; px++)
+			{
+				float cx = px + 0.5f;
+				float cy = py + 0.5f;
+				float w0 = ((x[2] - x[1]) * (cy - y[1]) - (cx - x[1]) * (y[2] - y[1])) / area;
+				float w1 = ((x[0] - x[2]) * (cy - y[2]) - (cx - x[2]) * (y[0] - y[2])) / area;
+				float w2 = 1.0f - w0 - w1;
+				if (w0 < 0 || w1 < 0 || w2 < 0)
+					continue;
+
+				float pixelDepth = w0 * z[0] + w1 * z[1] + w2 * z[2];
+				float& stored = depth[py * width + px];
+				if (pixelDepth >= 0 && pixelDepth < stored)
+					stored = pixelDepth;
+			}
+		}
+	}
+}
+
+void CullMeshlets(const MeshletData& data, const float world[4][4], const MeshletCullView& view,
+	MeshletCullStats& stats, std::vector<unsigned int>* visible)
+{
+	// frustum planes (xyz, w) from the columns of the row-vector
+	// matrix: -w <= x <= w, -w <= y <= w and 0 <= z <= w
+	const float(*m)[4] = view.viewProjection;
+	float planes[6][4];
+	for (int k = 0; k < 4; k++)
+	{
+		planes[0][k] = m[k][3] + m[k][0];
+		planes[1][k] = m[k][3] - m[k][0];
+		planes[2][k] = m[k][3] + m[k][1];
+		planes[3][k] = m[k][3] - m[k][1];
+		planes[4][k] = m[k][2];
+		planes[5][k] = m[k][3] - m[k][2];
+	}
+	for (float* plane : planes)
+	{
+		float length = std::sqrt(Dot(plane, plane));
+		for (int k = 0; k < 4; k++)
+			plane[k] /= length;
+	}
+
+	// the world matrix's largest scale bounds how much spheres grow
+	float scale = 0;
+	for (int r = 0; r < 3; r++)
+		scale = std::max(scale, std::sqrt(Dot(world[r], world[r])));
+
+	for (size_t i = 0; i < data.meshlets.size(); i++)
+	{
+		const Meshlet& meshlet = data.meshlets[i];
+		stats.meshlets++;
+		stats.triangles += meshlet.triangleCount;
+
+		// frustum: sphere entirely outside any plane
+		float center[4];
+		Transform(meshlet.center, 1.0f, world, center);
+		float radius = meshlet.radius * scale;
+		bool outside = false;
+		for (const float* plane : planes)
+			outside = outside || Dot(plane, center) + plane[3] < -radius;
+		if (outside)
+		{
+			stats.frustumMeshlets++;
+			stats.frustumTriangles += meshlet.triangleCount;
+			continue;
+		}
+
+		// backface: every triangle faces away from the camera
+		if (meshlet.coneCutoff < 1.0f)
+		{
+			float apex[4], axis[4];
+			Transform(meshlet.coneApex, 1.0f, world, apex);
+			Transform(meshlet.coneAxis, 0.0f, world, axis);
+			float toApex[3] = { apex[0] - view.cameraPosition[0], apex[1] - view.cameraPosition[1], apex[2] - view.cameraPosition[2] };
+			if (Normalize(toApex) && Normalize(axis) && Dot(toApex, axis) >= meshlet.coneCutoff)
+			{
+				stats.backfaceMeshlets++;
+				stats.backfaceTriangles += meshlet.triangleCount;
+				continue;
+			}
+		}
+
+		// occlusion: the screen box around the sphere's corners
+		// lies behind the depth already drawn there
+		if (view.occlusion)
+		{
+			int width = view.occlusion->GetWidth();
+			int height = view.occlusion->GetHeight();
+			float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1.0f;
+			bool inFront = true;
+			for (int corner = 0; corner < 8 && inFront; corner++)
+			{
+				float p[3] = {
+					center[0] + (corner & 1 ? radius : -radius),
+					center[1] + (corner & 2 ? radius : -radius),
+					center[2] + (corner & 4 ? radius : -radius) };
+				float clip[4];
+				Transform(p, 1.0f, view.viewProjection, clip);
+				if (clip[3] <= 1e-5f)
+				{
+					inFront = false;
+					break;
+				}
+				float sx = (clip[0] / clip[3] * 0.5f + 0.5f) * width;
+				float sy = (0.5f - clip[1] / clip[3] * 0.5f) * height;
+				minX = std::min(minX, sx);
+				maxX = std::max(maxX, sx);
+				minY = std::min(minY, sy);
+				maxY = std::max(maxY, sy);
+				nearest = std::min(nearest, clip[2] / clip[3]);
+			}
+
+			if (inFront && view.occlusion->IsOccluded(minX, minY, maxX, maxY, nearest))
+			{
+				stats.occlusionMeshlets++;
+				stats.occlusionTriangles += meshlet.triangleCount;
+				continue;
+			}
+		}
+
+		stats.visibleMeshlets++;
+		stats.visibleTriangles += meshlet.triangleCount;
+		if (visible)
+			visible->push_back(static_cast<unsigned int>(i));
+	}
+}
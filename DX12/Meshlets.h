@@ -0,0 +1,114 @@
+#pragma once
+
+#include "MeshData.h"
+
+#include <cstddef>
+#include <vector>
+
+// --------------------------------------------------------
+// Meshlets: small clusters of a mesh's triangles that can be
+// culled on their own, each with its own vertex list and local
+// indices in the layout mesh shaders expect
+//
+// Each meshlet carries a bounding sphere for frustum and
+// occlusion tests and a normal cone for backface tests.  The
+// reference culler here runs those tests on the CPU and counts
+// what they remove, so the same tests on the GPU can be checked
+// against it
+// --------------------------------------------------------
+
+// limits fitting a 128-thread mesh shader group
+const size_t MeshletMaxVertices = 64;
+const size_t MeshletMaxTriangles = 124;
+
+struct Meshlet
+{
+	// ranges in MeshletData's vertex and triangle lists
+	unsigned int vertexOffset;
+	unsigned int vertexCount;
+	unsigned int triangleOffset;	// in triangles (3 local indices each)
+	unsigned int triangleCount;
+
+	// bounding sphere
+	float center[3];
+	float radius;
+
+	// normal cone: the meshlet faces entirely away from any
+	// viewer for which dot(normalize(coneApex - viewer), coneAxis)
+	// is at least coneCutoff (a cutoff of 1 never culls)
+	float coneApex[3];
+	float coneAxis[3];
+	float coneCutoff;
+};
+
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> vertices;		// mesh vertex indices per meshlet
+	std::vector<unsigned char> triangles;		// 3 meshlet-local indices per triangle
+};
+
+// Greedy clustering: grows each meshlet by the neighboring
+// triangle that adds the fewest new vertices and seeds the next
+// one from its border, so it works best on a cache-optimized
+// index buffer
+MeshletData BuildMeshlets(const MeshVertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+
+// **** culling ****
+
+// Conservative depth (farthest value per texel) at halving
+// resolutions, for testing bounds against what's already drawn
+class DepthPyramid
+{
+public:
+	// depth is row-major, 0 near and 1 far as in Direct3D
+	void Build(const float* depth, int width, int height);
+
+	// true if a screen rectangle (in pixels) lies entirely
+	// behind the depth already drawn there
+	bool IsOccluded(float minX, float minY, float maxX, float maxY, float nearestDepth) const;
+
+	int GetWidth() const;
+	int GetHeight() const;
+
+private:
+	std::vector<std::vector<float>> levels;
+	std::vector<int> widths;
+	std::vector<int> heights;
+};
+
+// Depth-only software rasterizer for building occlusion buffers;
+// matrices are row-vector (like XMFLOAT4X4), depth starts cleared to 1
+void RasterizeDepth(const MeshVertex* vertices, const unsigned int* indices, size_t indexCount,
+	const float world[4][4], const float viewProjection[4][4], int width, int height, float* depth);
+
+struct MeshletCullView
+{
+	float viewProjection[4][4];	// row-vector, like XMFLOAT4X4
+	float cameraPosition[3];	// world space
+	const DepthPyramid* occlusion;	// built at the viewport's size, or null to skip occlusion tests
+};
+
+struct MeshletCullStats
+{
+	size_t meshlets;
+	size_t triangles;
+
+	// removed by each test, in the order they run
+	size_t frustumMeshlets;
+	size_t frustumTriangles;
+	size_t backfaceMeshlets;
+	size_t backfaceTriangles;
+	size_t occlusionMeshlets;
+	size_t occlusionTriangles;
+
+	size_t visibleMeshlets;
+	size_t visibleTriangles;
+};
+
+// Frustum, normal cone and occlusion tests for each meshlet of a
+// mesh drawn with the given world matrix (cone tests assume it has
+// uniform scale); adds the results to stats and appends visible
+// meshlets' indices to visible if it's given
+void CullMeshlets(const MeshletData& data, const float world[4][4], const MeshletCullView& view,
+	MeshletCullStats& stats, std::vector<unsigned int>* visible = nullptr);
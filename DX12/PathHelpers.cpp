@@ -1,4 +1,8 @@
 
+// The project builds as C++17 (for std::from_chars in ObjLoader),
+// where these conversions are deprecated but still work fine
+#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
+
 #include <Windows.h>
 #include <codecvt>
 #include <locale>
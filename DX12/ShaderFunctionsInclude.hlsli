@@ -14,6 +14,20 @@ static const float MIN_ROUGHNESS = 0.0000001f; // 6 zeros after decimal
 static const float PI = 3.14159265359f;
 
 
+// VERTEX FUNCTIONS ===================
+// Unit vector from an octahedral map (see MeshQuantization.h);
+// the input layout's snorm conversion has already made it -1 to 1
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 v = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    if (v.z < 0)
+    {
+        v.xy = (1.0f - abs(v.yx)) * (v.xy >= 0 ? 1.0f : -1.0f);
+    }
+    return normalize(v);
+}
+
+
 // LIGHT FUNCTIONS ===================
 float3 Diffuse(float3 normal, float3 dirToLight)
 {
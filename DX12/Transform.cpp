@@ -1,5 +1,6 @@
 #include "Transform.h"
 #include <DirectXMath.h>
+#include <algorithm>
 
 using namespace DirectX;
 
@@ -11,15 +12,60 @@ Transform::Transform() :
 	forward(0, 0, 1),
 	right(1, 0, 0),
 	up(0, 1, 0),
-	matrixIsDirty(false),
-	vectorsDirty(false)
+	vectorsDirty(false),
+	node(GetHierarchy().Create()),
+	parent(nullptr)
 {
 	// transformation values
 	SetScale(1, 1, 1);
+}
+
+Transform::~Transform()
+{
+	// children stay where they are, as roots
+	for (Transform* child : children)
+		child->parent = nullptr;
+	if (parent)
+		parent->children.erase(std::find(parent->children.begin(), parent->children.end(), this));
+	GetHierarchy().Destroy(node);
+}
+
+TransformHierarchy& Transform::GetHierarchy()
+{
+	static TransformHierarchy hierarchy;
+	return hierarchy;
+}
 
-	// matrices
-	XMStoreFloat4x4(&world, XMMatrixIdentity());
-	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixIdentity());
+// **** hierarchy ****
+
+bool Transform::SetParent(Transform* newParent)
+{
+	if (newParent == parent)
+		return true;
+	if (!GetHierarchy().SetParent(node, newParent ? newParent->node : TransformHierarchy::None))
+		return false;
+
+	if (parent)
+		parent->children.erase(std::find(parent->children.begin(), parent->children.end(), this));
+	parent = newParent;
+	if (parent)
+		parent->children.push_back(this);
+	return true;
+}
+
+Transform* Transform::GetParent()
+{
+	return parent;
+}
+
+size_t Transform::GetChildCount()
+{
+	return children.size();
+}
+
+Transform* Transform::GetChild(size_t index)
+{
+	return children[index];
 }
 
 // **** transformations: floats ****
@@ -42,7 +88,7 @@ void Transform::MoveAbsolute(float x, float y, float z)
 	// copying value back to storage type
 	XMStoreFloat3(&position, posVec);
 
-	matrixIsDirty = true;
+	UpdateLocal();
 
 }
 
@@ -60,7 +106,7 @@ void Transform::MoveRelative(float x, float y, float z)
 
 	// add and store the results
 	XMStoreFloat3(&position, XMLoadFloat3(&position) + relativeDir); // fix this
-	matrixIsDirty = true;
+	UpdateLocal();
 }
 
 void Transform::Rotate(float p, float y, float r)
@@ -80,15 +126,13 @@ void Transform::Rotate(float p, float y, float r)
 	// copying value back to storage type
 	XMStoreFloat3(&pitchYawRoll, rotVec);
 
-	matrixIsDirty = true;
+	UpdateLocal();
 	vectorsDirty = true;
 }
 
 void Transform::Scale(float x, float y, float z)
 {
 	Scale(XMFLOAT3(x, y, z));
-	matrixIsDirty = true;
-
 }
 
 // **** transformations: vectors **** 
@@ -108,7 +152,7 @@ void Transform::MoveAbsolute(XMFLOAT3 _offset)
 	// copying value back to storage type
 	XMStoreFloat3(&position, posVec);
 
-	matrixIsDirty = true;
+	UpdateLocal();
 }
 
 void Transform::Rotate(XMFLOAT3 _rotation)
@@ -125,7 +169,7 @@ void Transform::Rotate(XMFLOAT3 _rotation)
 	// copying value back to storage type
 	XMStoreFloat3(&pitchYawRoll, rotChangeVec);
 
-	matrixIsDirty = true;
+	UpdateLocal();
 }
 
 void Transform::Scale(XMFLOAT3 _scale)
@@ -142,7 +186,7 @@ void Transform::Scale(XMFLOAT3 _scale)
 	// copying value back to storage type
 	XMStoreFloat3(&scale, scaleVec);
 
-	matrixIsDirty = true;
+	UpdateLocal();
 }
 
 // **** setters: floats ****
@@ -152,19 +196,19 @@ void Transform::SetPosition(float x, float y, float z)
 	position.x = x;
 	position.y = y;
 	position.z = z;
-	matrixIsDirty = true;
+	UpdateLocal();
 }
 
 void Transform::SetRotation(float x, float y, float z)
 {
 	pitchYawRoll = XMFLOAT3(x, y, z);
-	matrixIsDirty = true;
+	UpdateLocal();
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
 	scale = XMFLOAT3(x, y, z);
-	matrixIsDirty = true;
+	UpdateLocal();
 }
 
 // **** setters: vectors ****
@@ -172,20 +216,20 @@ void Transform::SetScale(float x, float y, float z)
 void Transform::SetPosition(XMFLOAT3 _position)
 {
 	position = _position;
-	matrixIsDirty = true;
+	UpdateLocal();
 }
 
 void Transform::SetRotation(XMFLOAT3 _rotation)
 {
 	pitchYawRoll = _rotation;
-	matrixIsDirty = true;
+	UpdateLocal();
 	vectorsDirty = true;
 }
 
 void Transform::SetScale(XMFLOAT3 _scale)
 {
 	scale = _scale;
-	matrixIsDirty = true;
+	UpdateLocal();
 }
 
 // **** getters ****
@@ -229,41 +273,29 @@ XMFLOAT3 Transform::GetUp()
 
 XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	if (matrixIsDirty) {
-
-		UpdateMatrices();
-	}
-
-	matrixIsDirty = false;
-	return world;
-
+	// brings the hierarchy up to date first if anything moved
+	float world[4][4];
+	GetHierarchy().GetWorldMatrix(node, world);
+	return XMFLOAT4X4(&world[0][0]);
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldInvTranspose()
 {
+	XMFLOAT4X4 world = GetWorldMatrix();
+	XMFLOAT4X4 worldInverseTranspose;
+	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixInverse(0, XMMatrixTranspose(XMLoadFloat4x4(&world))));
 	return worldInverseTranspose;
 }
 
 // **** helpers ****
 
-void Transform::UpdateMatrices()
+// hands the hierarchy the new local transform, which it turns
+// into scale * rotation * translation * the parent's world matrix
+void Transform::UpdateLocal()
 {
-	// translation matrix
-	XMMATRIX t = XMMatrixTranslation(position.x, position.y, position.z);
-
-	// rotation matrix
-	XMMATRIX r = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-
-	// scale matrix
-	XMMATRIX s = XMMatrixScalingFromVector(XMLoadFloat3(&scale));
-
-	// multiplying matricies
-	XMMATRIX _world = s * r * t;
-
-	// storing the matrix
-	XMStoreFloat4x4(&world, _world);
-	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixInverse(0, XMMatrixTranspose(_world)));
-
+	XMFLOAT4 rotation;
+	XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll)));
+	GetHierarchy().SetLocal(node, &position.x, &rotation.x, &scale.x);
 }
 
 void Transform::UpdateVectors()
@@ -1,11 +1,44 @@
 #pragma once
 
-#include <DirectXMath.h>
+#include "TransformHierarchy.h"
 
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Position, rotation and scale of an object, relative to its
+// parent if it has one
+//
+// - Every Transform is a node in one shared TransformHierarchy,
+//   which works out world matrices for the whole scene in a
+//   single pass (see TransformHierarchy.h); call its Update()
+//   once a frame after moving things
+// - Changes push the new local transform to the hierarchy
+//   straight away, so a world matrix is never stale
+// --------------------------------------------------------
 class Transform
 {
 public:
 	Transform();
+	~Transform();
+
+	// each Transform is its own node in the hierarchy
+	Transform(const Transform&) = delete;
+	Transform& operator=(const Transform&) = delete;
+
+	// the hierarchy every Transform lives in
+	static TransformHierarchy& GetHierarchy();
+
+	// **** hierarchy ****
+
+	// keeps the local transform, so the object moves with its new
+	// parent; nullptr detaches it. False (changing nothing) if
+	// newParent is this or one of its descendants
+	bool SetParent(Transform* newParent);
+	Transform* GetParent();
+	size_t GetChildCount();
+	Transform* GetChild(size_t index);
+
 	// **** transformers ****
 
 	// floats
@@ -38,6 +71,7 @@ public:
 
 	// **** getters ****
 
+	// local, like the setters
 	DirectX::XMFLOAT3 GetPosition();
 	DirectX::XMFLOAT3 GetRotation();
 	DirectX::XMFLOAT3 GetScale();
@@ -46,6 +80,7 @@ public:
 	DirectX::XMFLOAT3 GetRight();
 	DirectX::XMFLOAT3 GetUp();
 
+	// include every parent's transform
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetWorldInvTranspose();
 
@@ -60,13 +95,14 @@ private:
 	DirectX::XMFLOAT3 right;
 	DirectX::XMFLOAT3 up;
 
-	// matrices
-	DirectX::XMFLOAT4X4 world;
-	DirectX::XMFLOAT4X4 worldInverseTranspose;
-	bool matrixIsDirty;
 	bool vectorsDirty;
 
-	void UpdateMatrices();
+	// scene graph
+	unsigned int node;
+	Transform* parent;
+	std::vector<Transform*> children;
+
+	void UpdateLocal();
 	void UpdateVectors();
 };
 
@@ -0,0 +1,340 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define TRANSFORM_HIERARCHY_SSE
+#endif
+
+namespace
+{
+	// the parent of roots
+	const float Identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+#ifdef TRANSFORM_HIERARCHY_SSE
+	// every lane set to v's lane Lane
+	template <int Lane>
+	inline __m128 Splat(__m128 v)
+	{
+		return _mm_shuffle_ps(v, v, _MM_SHUFFLE(Lane, Lane, Lane, Lane));
+	}
+
+	// a * p0 + b * p1 + c * p2, one row of a matrix product
+	inline __m128 CombineRows(__m128 a, __m128 b, __m128 c, __m128 p0, __m128 p1, __m128 p2)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, p0), _mm_mul_ps(b, p1)), _mm_mul_ps(c, p2));
+	}
+#endif
+
+	// world = scale * rotation * translation * parent for row-vector
+	// matrices; each input is four floats, the last unused, and
+	// world mustn't overlap parent
+	void ComposeWorld(const float* position, const float* rotation, const float* scale, const float* parent, float* world)
+	{
+#ifdef TRANSFORM_HIERARCHY_SSE
+		// The quaternion's products a vector at a time; lanes 0-2 of
+		// d, p and m hold every entry of the rotation:
+		//   row 0 = (d0, p0, m1)
+		//   row 1 = (m0, d1, p2)
+		//   row 2 = (p1, m2, d2)
+		// A quarter fewer instructions than building the matrix a
+		// float at a time, then multiplying; the twenty shuffles
+		// are what bound it now
+		__m128 q = _mm_loadu_ps(rotation);
+		__m128 q2 = _mm_add_ps(q, q);
+		__m128 squares = _mm_mul_ps(q, q2);
+		__m128 d = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f),
+			_mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 0, 0, 1))),
+			_mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 1, 2, 2)));
+		__m128 b = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 1, 0, 0)), _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3, 2, 2, 1)));
+		__m128 c = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 0, 1, 2)), _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3, 3, 3, 3)));
+		__m128 p = _mm_add_ps(b, c);
+		__m128 m = _mm_sub_ps(b, c);
+
+		// scale each entry by its row's scale
+		__m128 s = _mm_loadu_ps(scale);
+		d = _mm_mul_ps(d, s);
+		p = _mm_mul_ps(p, _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 1, 2, 0)));
+		m = _mm_mul_ps(m, _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 2, 0, 1)));
+
+		__m128 p0 = _mm_loadu_ps(parent);
+		__m128 p1 = _mm_loadu_ps(parent + 4);
+		__m128 p2 = _mm_loadu_ps(parent + 8);
+		__m128 t = _mm_loadu_ps(position);
+		_mm_storeu_ps(world, CombineRows(Splat<0>(d), Splat<0>(p), Splat<1>(m), p0, p1, p2));
+		_mm_storeu_ps(world + 4, CombineRows(Splat<0>(m), Splat<1>(d), Splat<2>(p), p0, p1, p2));
+		_mm_storeu_ps(world + 8, CombineRows(Splat<1>(p), Splat<2>(m), Splat<2>(d), p0, p1, p2));
+		_mm_storeu_ps(world + 12, _mm_add_ps(CombineRows(Splat<0>(t), Splat<1>(t), Splat<2>(t), p0, p1, p2), _mm_loadu_ps(parent + 12)));
+#else
+		float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+		float xx = 2 * x * x, yy = 2 * y * y, zz = 2 * z * z;
+		float xy = 2 * x * y, xz = 2 * x * z, yz = 2 * y * z;
+		float xw = 2 * x * w, yw = 2 * y * w, zw = 2 * z * w;
+		float local[4][3] =
+		{
+			{ (1 - yy - zz) * scale[0], (xy + zw) * scale[0], (xz - yw) * scale[0] },
+			{ (xy - zw) * scale[1], (1 - xx - zz) * scale[1], (yz + xw) * scale[1] },
+			{ (xz + yw) * scale[2], (yz - xw) * scale[2], (1 - xx - yy) * scale[2] },
+			{ position[0], position[1], position[2] }
+		};
+		for (int r = 0; r < 4; r++)
+		{
+			for (int j = 0; j < 4; j++)
+				world[4 * r + j] = local[r][0] * parent[j] + local[r][1] * parent[4 + j] + local[r][2] * parent[8 + j];
+		}
+		for (int j = 0; j < 4; j++)
+			world[12 + j] += parent[12 + j];
+#endif
+	}
+}
+
+TransformHierarchy::TransformHierarchy() :
+	firstDirty(0),
+	orderDirty(false)
+{
+}
+
+unsigned int TransformHierarchy::Create(unsigned int parent)
+{
+	unsigned int handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = static_cast<unsigned int>(slots.size());
+		slots.push_back(None);
+	}
+
+	// a root goes on the end; a child does too, but then its subtree
+	// isn't in one piece until the next reorder
+	unsigned int slot = static_cast<unsigned int>(parents.size());
+	slots[handle] = slot;
+	handles.push_back(handle);
+	parents.push_back(parent == None ? None : slots[parent]);
+	subtreeEnds.push_back(slot + 1);
+	locals.push_back({ { 0, 0, 0, 0 }, { 0, 0, 0, 1 }, { 1, 1, 1, 0 } });
+	worlds.resize(worlds.size() + 16);
+	dirty.push_back(0);
+	if (parent != None)
+		orderDirty = true;
+	MarkDirty(slot);
+	return handle;
+}
+
+void TransformHierarchy::Destroy(unsigned int node)
+{
+	// the slot stays until the next reorder, which is also when its
+	// children get cut loose
+	unsigned int slot = slots[node];
+	handles[slot] = None;
+	slots[node] = None;
+	freeHandles.push_back(node);
+	orderDirty = true;
+}
+
+bool TransformHierarchy::SetParent(unsigned int node, unsigned int parent)
+{
+	unsigned int slot = slots[node];
+	unsigned int parentSlot = parent == None ? None : slots[parent];
+
+	// no cycles: the new parent mustn't be this node or below it
+	for (unsigned int s = parentSlot; s != None && handles[s] != None; s = parents[s])
+	{
+		if (s == slot)
+			return false;
+	}
+
+	parents[slot] = parentSlot;
+	orderDirty = true;
+	MarkDirty(slot);
+	return true;
+}
+
+unsigned int TransformHierarchy::GetParent(unsigned int node) const
+{
+	unsigned int parentSlot = parents[slots[node]];
+	return parentSlot == None ? None : handles[parentSlot];
+}
+
+void TransformHierarchy::SetLocal(unsigned int node, const float position[3], const float rotation[4], const float scale[3])
+{
+	unsigned int slot = slots[node];
+	LocalTransform& local = locals[slot];
+	memcpy(local.position, position, 3 * sizeof(float));
+	memcpy(local.rotation, rotation, 4 * sizeof(float));
+	memcpy(local.scale, scale, 3 * sizeof(float));
+	MarkDirty(slot);
+}
+
+size_t TransformHierarchy::Update()
+{
+	if (orderDirty)
+		Reorder();
+
+	size_t count = parents.size();
+	if (firstDirty >= count)
+		return 0;
+
+	size_t updated = UpdateNodes(firstDirty, count);
+	memset(&dirty[firstDirty], 0, count - firstDirty);
+	firstDirty = count;
+	return updated;
+}
+
+void TransformHierarchy::GetWorldMatrix(unsigned int node, float world[4][4])
+{
+	if (orderDirty || firstDirty < parents.size())
+		Update();
+	memcpy(world, &worlds[16 * slots[node]], 16 * sizeof(float));
+}
+
+size_t TransformHierarchy::GetNodeCount() const
+{
+	return slots.size() - freeHandles.size();
+}
+
+// **** helpers ****
+
+// --------------------------------------------------------
+// Recomputes the dirty nodes among slots [first, last) and
+// everything under them; each subtree is in one piece (the
+// order's rebuilt first if not), so the pass finds the next
+// dirty node with memchr and then runs straight through its
+// subtree, never looking at a flag in between
+// --------------------------------------------------------
+size_t TransformHierarchy::UpdateNodes(size_t first, size_t last)
+{
+	const LocalTransform* local = locals.data();
+	const unsigned int* parent = parents.data();
+	const uint8_t* flags = dirty.data();
+	float* world = worlds.data();
+
+	size_t updated = 0;
+	size_t i = first;
+	while (i < last)
+	{
+		const void* next = memchr(flags + i, 1, last - i);
+		if (!next)
+			break;
+		i = static_cast<const uint8_t*>(next) - flags;
+
+		// parents outside the subtree were settled earlier in this
+		// pass or were clean; the rest were just done
+		size_t end = subtreeEnds[i];
+		updated += end - i;
+		for (; i < end; i++)
+		{
+			const LocalTransform& l = local[i];
+			unsigned int p = parent[i];
+			ComposeWorld(l.position, l.rotation, l.scale, p == None ? Identity : &world[16 * p], &world[16 * i]);
+		}
+	}
+	return updated;
+}
+
+void TransformHierarchy::MarkDirty(unsigned int slot)
+{
+	dirty[slot] = 1;
+	firstDirty = std::min<size_t>(firstDirty, slot);
+}
+
+// --------------------------------------------------------
+// Rebuilds the order depth first from the roots, so each
+// tree is in one piece, dropping destroyed slots; children of
+// destroyed nodes become roots
+// --------------------------------------------------------
+void TransformHierarchy::Reorder()
+{
+	size_t count = parents.size();
+
+	// children of each live slot, in slot order
+	std::vector<unsigned int> childStart(count + 1, 0);
+	for (size_t s = 0; s < count; s++)
+	{
+		if (handles[s] == None)
+			continue;
+		unsigned int parent = parents[s];
+		if (parent != None && handles[parent] == None)
+		{
+			parents[s] = None;
+			dirty[s] = 1;
+		}
+		else if (parent != None)
+			childStart[parent + 1]++;
+	}
+	for (size_t s = 0; s < count; s++)
+		childStart[s + 1] += childStart[s];
+	std::vector<unsigned int> children(childStart[count]);
+	std::vector<unsigned int> fill(childStart.begin(), childStart.end() - 1);
+	for (size_t s = 0; s < count; s++)
+	{
+		if (handles[s] != None && parents[s] != None)
+			children[fill[parents[s]]++] = static_cast<unsigned int>(s);
+	}
+
+	// depth first from each root; children are pushed in reverse so
+	// they come out in their old order
+	std::vector<unsigned int> order;
+	std::vector<unsigned int> stack;
+	order.reserve(count);
+	for (size_t root = 0; root < count; root++)
+	{
+		if (handles[root] == None || parents[root] != None)
+			continue;
+		stack.push_back(static_cast<unsigned int>(root));
+		while (!stack.empty())
+		{
+			unsigned int s = stack.back();
+			stack.pop_back();
+			order.push_back(s);
+			for (unsigned int c = childStart[s + 1]; c > childStart[s]; c--)
+				stack.push_back(children[c - 1]);
+		}
+	}
+
+	// move everything to its new slot
+	std::vector<unsigned int> newSlot(count, None);
+	for (size_t i = 0; i < order.size(); i++)
+		newSlot[order[i]] = static_cast<unsigned int>(i);
+
+	std::vector<LocalTransform> newLocals(order.size());
+	std::vector<float> newWorlds(order.size() * 16);
+	std::vector<unsigned int> newParents(order.size());
+	std::vector<uint8_t> newDirty(order.size());
+	std::vector<unsigned int> newHandles(order.size());
+	firstDirty = order.size();
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		unsigned int s = order[i];
+		newLocals[i] = locals[s];
+		memcpy(&newWorlds[16 * i], &worlds[16 * s], 16 * sizeof(float));
+		newParents[i] = parents[s] == None ? None : newSlot[parents[s]];
+		newDirty[i] = dirty[s];
+		newHandles[i] = handles[s];
+		slots[handles[s]] = static_cast<unsigned int>(i);
+		if (dirty[s])
+			firstDirty = std::min(firstDirty, i);
+	}
+
+	// each subtree runs from its root to the root plus its size
+	std::vector<unsigned int> newSubtreeEnds(order.size(), 1);
+	for (size_t i = order.size(); i-- > 0;)
+	{
+		if (newParents[i] != None)
+			newSubtreeEnds[newParents[i]] += newSubtreeEnds[i];
+		newSubtreeEnds[i] += static_cast<unsigned int>(i);
+	}
+
+	locals.swap(newLocals);
+	worlds.swap(newWorlds);
+	parents.swap(newParents);
+	subtreeEnds.swap(newSubtreeEnds);
+	dirty.swap(newDirty);
+	handles.swap(newHandles);
+	orderDirty = false;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// A scene graph of transforms, stored flat and independent
+// of DirectXMath so tools can benchmark it
+//
+// - Nodes sit in arrays ordered so every parent comes before
+//   its children (depth first, keeping each tree in one piece);
+//   one front to back pass updates world matrices, each parent's
+//   already final by the time its children read it
+// - Setting a node's local transform marks it dirty; the pass
+//   skips from one dirty node to the next and recomputes each
+//   one's whole subtree, which is in one piece
+// - The pass is single-threaded and, at a few ns a node
+//   (MeshConverter --bench-transforms times it), quick enough
+//   not to need more
+// - Handles stay valid when nodes move, which they do when the
+//   next update rebuilds the order after nodes were created
+//   under a parent, reparented or destroyed
+// - Matrices are row-vector, laid out like XMFLOAT4X4, and each
+//   node's world matrix is scale * rotation * translation *
+//   parent's world
+// --------------------------------------------------------
+
+class TransformHierarchy
+{
+public:
+	// a node without a parent, or a handle to no node
+	static constexpr unsigned int None = ~0u;
+
+	TransformHierarchy();
+
+	// new node at the identity under parent (None for a root)
+	unsigned int Create(unsigned int parent = None);
+	// children of a destroyed node become roots, keeping their
+	// local transforms
+	void Destroy(unsigned int node);
+
+	// false (changing nothing) if parent is node or under it
+	bool SetParent(unsigned int node, unsigned int parent);
+	unsigned int GetParent(unsigned int node) const;
+
+	// position, rotation as a unit quaternion (x, y, z, w) and
+	// scale, all relative to the parent
+	void SetLocal(unsigned int node, const float position[3], const float rotation[4], const float scale[3]);
+
+	// brings every dirty node's world matrix up to date; returns
+	// how many were recomputed
+	size_t Update();
+
+	// updates first if anything's dirty
+	void GetWorldMatrix(unsigned int node, float world[4][4]);
+
+	// live nodes
+	size_t GetNodeCount() const;
+
+private:
+	// each padded to four floats, so each loads as one SSE register
+	struct LocalTransform
+	{
+		float position[4];
+		float rotation[4];
+		float scale[4];
+	};
+
+	// per slot, in parent-first order
+	std::vector<LocalTransform> locals;
+	std::vector<float> worlds;		// 16 per slot
+	std::vector<unsigned int> parents;	// slot, or None
+	std::vector<unsigned int> subtreeEnds;	// one past the slot's last descendant
+	std::vector<uint8_t> dirty;
+	std::vector<unsigned int> handles;	// slot -> handle, None once destroyed
+
+	// per handle
+	std::vector<unsigned int> slots;	// handle -> slot, None if free
+	std::vector<unsigned int> freeHandles;
+
+	size_t firstDirty;			// no slot before this is dirty
+	bool orderDirty;			// a parent moved after a child, or slots died
+
+	size_t UpdateNodes(size_t first, size_t last);
+	void MarkDirty(unsigned int slot);
+	void Reorder();
+};
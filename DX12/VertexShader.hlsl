@@ -1,5 +1,6 @@
 
 #include "ShaderStructsInclude.hlsli"
+#include "ShaderFunctionsInclude.hlsli"
 
 
 cbuffer ExternalData : register(b0)
@@ -9,6 +10,11 @@ cbuffer ExternalData : register(b0)
     float4x4 worldInvTranspose;
     float4x4 view;
     float4x4 projection;
+	
+	// packed vertices (see MeshQuantization.h)
+    float3 positionScale;
+    int packedVertices;
+    float3 positionOffset;
 }
 
 // --------------------------------------------------------
@@ -25,11 +31,22 @@ VertexToPixel main( VertexShaderInput input )
 	
     matrix wvp = mul(projection, mul(view, world));
 	
-    output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
-    output.normal = normalize(mul((float3x3)worldInvTranspose, input.normal));
-    output.tangent = normalize(mul((float3x3)world, input.tangent));
+	// packed positions are fractions of the mesh's bounds, and
+	// packed normals and tangents octahedral maps in .xy
+    float3 localPosition = input.localPosition * positionScale + positionOffset;
+    float3 normal = input.normal;
+    float3 tangent = input.tangent;
+    if (packedVertices)
+    {
+        normal = DecodeOctahedral(input.normal.xy);
+        tangent = DecodeOctahedral(input.tangent.xy);
+    }
+	
+    output.screenPosition = mul(wvp, float4(localPosition, 1.0f));
+    output.normal = normalize(mul((float3x3)worldInvTranspose, normal));
+    output.tangent = normalize(mul((float3x3)world, tangent));
 	
-    output.worldPosition = mul(world, float4(input.localPosition, 1.0f)).xyz;
+    output.worldPosition = mul(world, float4(localPosition, 1.0f)).xyz;
 	
     output.uv = input.uv;
 
@@ -0,0 +1,267 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+
+#include <charconv>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	// One face corner: zero-based indices into the file's
+	// position, uv and normal lists, -1 where it gave none
+	struct CornerKey
+	{
+		int position;
+		int uv;
+		int normal;
+
+		bool operator==(const CornerKey& other) const
+		{
+			return position == other.position && uv == other.uv && normal == other.normal;
+		}
+	};
+
+	struct CornerHash
+	{
+		size_t operator()(const CornerKey& key) const
+		{
+			// multiplicative mixing of each index; the positions alone
+			// are nearly unique, the other two just split the collisions
+			unsigned long long h = static_cast<unsigned int>(key.position) * 0x9E3779B97F4A7C15ull;
+			h ^= static_cast<unsigned int>(key.uv) * 0xC2B2AE3D27D4EB4Full;
+			h ^= static_cast<unsigned int>(key.normal) * 0x165667B19E3779F9ull;
+			return static_cast<size_t>(h ^ (h >> 29));
+		}
+	};
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* SkipSpaces(const char* c, const char* end)
+	{
+		while (c < end && IsSpace(*c))
+			c++;
+		return c;
+	}
+
+	// reads one number, leaving c just past it
+	bool ParseFloat(const char*& c, const char* end, float& value)
+	{
+		c = SkipSpaces(c, end);
+
+		// from_chars doesn't accept an explicit plus sign
+		if (c < end && *c == '+')
+			c++;
+
+		std::from_chars_result result = std::from_chars(c, end, value);
+		if (result.ptr == c)
+			return false;
+
+		// exporters sometimes write denormals like 1e-45, which
+		// from_chars reports as out of range; those are just zero
+		if (result.ec == std::errc::result_out_of_range)
+			value = 0.0f;
+
+		c = result.ptr;
+		return true;
+	}
+
+	// reads one face index and turns it into a zero-based one:
+	// positive indices count from 1, negative ones back from the
+	// most recent element
+	bool ParseIndex(const char*& c, const char* end, size_t count, int& index)
+	{
+		int value = 0;
+		std::from_chars_result result = std::from_chars(c, end, value);
+		if (result.ec != std::errc() || value == 0)
+			return false;
+		c = result.ptr;
+
+		long long resolved = value > 0 ? value - 1LL : static_cast<long long>(count) + value;
+		if (resolved < 0 || resolved >= static_cast<long long>(count))
+			return false;
+
+		index = static_cast<int>(resolved);
+		return true;
+	}
+
+	bool Fail(ObjMeshData& mesh, size_t line, const char* message)
+	{
+		mesh.error = "line " + std::to_string(line) + ": " + message;
+		return false;
+	}
+}
+
+double ObjMeshData::GetReuseRatio() const
+{
+	return vertices.empty() ? 0.0 : static_cast<double>(indices.size()) / vertices.size();
+}
+
+bool LoadObj(const std::string& fileName, ObjMeshData& mesh)
+{
+	MappedFile file;
+	if (!file.Open(fileName))
+	{
+		mesh = ObjMeshData();
+		mesh.error = "can't open " + fileName;
+		return false;
+	}
+
+	bool result = ParseObj(file.GetData(), file.GetSize(), mesh);
+	mesh.fileBytes = file.GetSize();
+	return result;
+}
+
+bool ParseObj(const char* text, size_t length, ObjMeshData& mesh)
+{
+	mesh = ObjMeshData();
+	mesh.fileBytes = length;
+
+	// raw data from the file, three floats per position and
+	// normal, two per uv
+	std::vector<float> positions;
+	std::vector<float> uvs;
+	std::vector<float> normals;
+
+	// unique corners seen so far, and the vertex each became
+	std::unordered_map<CornerKey, unsigned int, CornerHash> corners;
+	std::vector<unsigned int> face;
+
+	const char* end = text + length;
+	size_t line = 0;
+	for (const char* c = text; c < end; )
+	{
+		line++;
+		const char* lineEnd = static_cast<const char*>(memchr(c, '\n', end - c));
+		if (!lineEnd)
+			lineEnd = end;
+
+		c = SkipSpaces(c, lineEnd);
+		size_t remaining = lineEnd - c;
+
+		if (remaining >= 2 && c[0] == 'v' && IsSpace(c[1]))
+		{
+			// position: three numbers (any fourth, w, is ignored)
+			c += 2;
+			float p[3];
+			if (!ParseFloat(c, lineEnd, p[0]) || !ParseFloat(c, lineEnd, p[1]) || !ParseFloat(c, lineEnd, p[2]))
+				return Fail(mesh, line, "expected three numbers after 'v'");
+			positions.insert(positions.end(), p, p + 3);
+		}
+		else if (remaining >= 3 && c[0] == 'v' && c[1] == 't' && IsSpace(c[2]))
+		{
+			// uv: the second number is optional and defaults to 0
+			c += 3;
+			float uv[2] = { 0, 0 };
+			if (!ParseFloat(c, lineEnd, uv[0]))
+				return Fail(mesh, line, "expected a number after 'vt'");
+			if (SkipSpaces(c, lineEnd) < lineEnd && !ParseFloat(c, lineEnd, uv[1]))
+				return Fail(mesh, line, "bad second number after 'vt'");
+			uvs.insert(uvs.end(), uv, uv + 2);
+		}
+		else if (remaining >= 3 && c[0] == 'v' && c[1] == 'n' && IsSpace(c[2]))
+		{
+			// normal: three numbers
+			c += 3;
+			float n[3];
+			if (!ParseFloat(c, lineEnd, n[0]) || !ParseFloat(c, lineEnd, n[1]) || !ParseFloat(c, lineEnd, n[2]))
+				return Fail(mesh, line, "expected three numbers after 'vn'");
+			normals.insert(normals.end(), n, n + 3);
+		}
+		else if (remaining >= 2 && c[0] == 'f' && IsSpace(c[1]))
+		{
+			// positions come first in practically every file, so
+			// their count is a good guess at the unique vertex count
+			if (mesh.faceCount == 0)
+			{
+				corners.reserve(positions.size() / 3 + positions.size() / 12);
+				mesh.vertices.reserve(positions.size() / 3 + positions.size() / 12);
+			}
+
+			// each corner is v, v/vt, v//vn or v/vt/vn
+			c += 2;
+			face.clear();
+			for (c = SkipSpaces(c, lineEnd); c < lineEnd; c = SkipSpaces(c, lineEnd))
+			{
+				CornerKey key = { -1, -1, -1 };
+				if (!ParseIndex(c, lineEnd, positions.size() / 3, key.position))
+					return Fail(mesh, line, "bad position index in face");
+				if (c < lineEnd && *c == '/')
+				{
+					c++;
+					if (c < lineEnd && *c != '/' && !ParseIndex(c, lineEnd, uvs.size() / 2, key.uv))
+						return Fail(mesh, line, "bad uv index in face");
+					if (c < lineEnd && *c == '/')
+					{
+						c++;
+						if (!ParseIndex(c, lineEnd, normals.size() / 3, key.normal))
+							return Fail(mesh, line, "bad normal index in face");
+					}
+				}
+				if (c < lineEnd && !IsSpace(*c))
+					return Fail(mesh, line, "unexpected character in face");
+
+				// reuse the vertex if this exact corner has been seen
+				std::pair<std::unordered_map<CornerKey, unsigned int, CornerHash>::iterator, bool> found =
+					corners.emplace(key, static_cast<unsigned int>(mesh.vertices.size()));
+				if (found.second)
+				{
+					// The model is most likely in a right-handed space,
+					// so convert to DirectX's left-handed one by inverting
+					// the Z of the position and normal (the winding order
+					// is flipped below).  V is flipped too, since DirectX
+					// puts (0,0) at the top left of a texture.
+					const float* p = &positions[3 * key.position];
+					ObjVertex v = {};
+					v.Position[0] = p[0];
+					v.Position[1] = p[1];
+					v.Position[2] = -p[2];
+
+					// corners without a uv all share (0,0), as before
+					if (key.uv >= 0)
+					{
+						v.UV[0] = uvs[2 * key.uv];
+						v.UV[1] = 1.0f - uvs[2 * key.uv + 1];
+					}
+					else
+					{
+						v.UV[1] = 1.0f;
+					}
+
+					if (key.normal >= 0)
+					{
+						const float* n = &normals[3 * key.normal];
+						v.Normal[0] = n[0];
+						v.Normal[1] = n[1];
+						v.Normal[2] = -n[2];
+					}
+
+					mesh.vertices.push_back(v);
+				}
+				face.push_back(found.first->second);
+			}
+
+			if (face.size() < 3)
+				return Fail(mesh, line, "face with fewer than three corners");
+
+			// fan out polygons into triangles, flipping the winding order
+			for (size_t k = 1; k + 1 < face.size(); k++)
+			{
+				mesh.indices.push_back(face[0]);
+				mesh.indices.push_back(face[k + 1]);
+				mesh.indices.push_back(face[k]);
+			}
+			mesh.faceCount++;
+		}
+
+		// anything else (comments, groups, materials...) is skipped
+		c = lineEnd < end ? lineEnd + 1 : end;
+	}
+
+	mesh.positionCount = positions.size() / 3;
+	mesh.uvCount = uvs.size() / 2;
+	mesh.normalCount = normals.size() / 3;
+	return true;
+}
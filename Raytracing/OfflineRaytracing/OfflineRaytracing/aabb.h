@@ -0,0 +1,78 @@
+#pragma once
+
+#ifndef AABB_H
+#define AABB_H
+
+#include "rtweekend.h"
+
+class aabb {
+public:
+    interval x, y, z;
+
+    aabb() {} // The default AABB is empty, since intervals are empty by default.
+
+    aabb(const interval& ix, const interval& iy, const interval& iz)
+        : x(ix), y(iy), z(iz) {}
+
+    aabb(const point3& a, const point3& b) {
+        // Treat the two points a and b as extrema for the bounding box, so we don't require a
+        // particular minimum/maximum coordinate order.
+        x = interval(std::fmin(a[0], b[0]), std::fmax(a[0], b[0]));
+        y = interval(std::fmin(a[1], b[1]), std::fmax(a[1], b[1]));
+        z = interval(std::fmin(a[2], b[2]), std::fmax(a[2], b[2]));
+    }
+
+    aabb(const aabb& box0, const aabb& box1) {
+        x = interval(box0.x, box1.x);
+        y = interval(box0.y, box1.y);
+        z = interval(box0.z, box1.z);
+    }
+
+    const interval& axis(int n) const {
+        if (n == 1) return y;
+        if (n == 2) return z;
+        return x;
+    }
+
+    bool is_empty() const {
+        return x.min > x.max || y.min > y.max || z.min > z.max;
+    }
+
+    point3 centroid() const {
+        return point3((x.min + x.max) / 2, (y.min + y.max) / 2, (z.min + z.max) / 2);
+    }
+
+    real surface_area() const {
+        if (is_empty())
+            return 0;
+        auto dx = x.size();
+        auto dy = y.size();
+        auto dz = z.size();
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    bool hit(const ray& r, interval ray_t) const {
+        auto orig = r.origin();
+        auto dir = r.direction();
+        return hit(orig, vec3(1 / dir[0], 1 / dir[1], 1 / dir[2]), ray_t);
+    }
+
+    bool hit(const point3& orig, const vec3& inv_dir, interval ray_t) const {
+        // Slab test against a precomputed reciprocal direction, as used by BVH traversal.
+        for (int a = 0; a < 3; a++) {
+            const interval& ax = axis(a);
+            auto t0 = (ax.min - orig[a]) * inv_dir[a];
+            auto t1 = (ax.max - orig[a]) * inv_dir[a];
+
+            if (t0 > t1) std::swap(t0, t1);
+            if (t0 > ray_t.min) ray_t.min = t0;
+            if (t1 < ray_t.max) ray_t.max = t1;
+
+            if (ray_t.max < ray_t.min)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,408 @@
+#pragma once
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "rtweekend.h"
+#include "bvh.h"
+#include "camera.h"
+#include "hittable_list.h"
+#include "image.h"
+#include "scenes.h"
+#include "sphere.h"
+#include "sphere_soa.h"
+#include "tile_scheduler.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+template <typename DrawFunc>
+double measure_samples_per_second(int num_threads, uint64_t samples_per_thread, DrawFunc draw) {
+    // Runs draw(sink) samples_per_thread times on each of num_threads threads and returns the
+    // combined throughput. The per-thread sink keeps the compiler from discarding the draws.
+    std::vector<double> sinks(num_threads, 0.0);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < num_threads; ++t) {
+        pool.emplace_back([&, t]() {
+            double sum = 0;
+            for (uint64_t k = 0; k < samples_per_thread; ++k)
+                sum += draw();
+            sinks[t] = sum;
+        });
+    }
+    for (auto& thread : pool)
+        thread.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    volatile double keep = 0;
+    for (auto s : sinks) keep = keep + s;
+
+    return num_threads * static_cast<double>(samples_per_thread) / seconds;
+}
+
+inline void benchmark_rng(std::ostream& out, int num_threads) {
+    // Compares the C rand() path random_double() used to take against the per-thread engines.
+    num_threads = resolve_thread_count(num_threads);
+    const uint64_t samples = 20000000;
+
+    auto report = [&](const char* name, double rate) {
+        out << "  " << name << ": " << rate / 1e6 << " M samples/sec\n";
+    };
+
+    for (int threads : { 1, num_threads }) {
+        out << "RNG throughput with " << threads << " thread(s):\n";
+
+        report("rand()", measure_samples_per_second(threads, samples, []() {
+            return rand() / (RAND_MAX + 1.0);
+        }));
+
+        report("pcg32", measure_samples_per_second(threads, samples, []() {
+            thread_local pcg32 engine;
+            return engine.next_double();
+        }));
+
+        report("xoshiro256+", measure_samples_per_second(threads, samples, []() {
+            thread_local xoshiro256plus engine;
+            return engine.next_double();
+        }));
+
+        report("random_double()", measure_samples_per_second(threads, samples, []() {
+            return random_double();
+        }));
+
+        if (threads == num_threads)
+            break;
+    }
+}
+
+inline void benchmark_intersection(std::ostream& out, const hittable_list& spheres, const point3& lookfrom, const point3& lookat) {
+    // Traces the same batch of closest-hit queries through the virtual hittable_list, the
+    // packed sphere_soa kernel and a BVH, single threaded, and reports rays/sec for each.
+    sphere_soa packed;
+    for (const auto& object : spheres.objects)
+        if (auto s = dynamic_cast<const sphere*>(object.get()))
+            packed.add(*s);
+
+    bvh_node bvh(spheres);
+
+    // Rays leave a small region around the camera towards a box around the look-at point,
+    // covering roughly what the final scene camera sees.
+    const size_t ray_count = 1 << 18;
+    std::vector<ray> rays;
+    rays.reserve(ray_count);
+    seed_sample(7, 0, 0);
+    for (size_t k = 0; k < ray_count; ++k) {
+        auto origin = lookfrom + vec3::random(real(-0.1), real(0.1));
+        auto target = lookat + vec3::random(-4, 4);
+        rays.emplace_back(origin, target - origin);
+    }
+
+    struct result { double rays_per_sec; size_t hits; };
+
+    auto run = [&](const hittable& world) {
+        size_t hits = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& r : rays) {
+            hit_record rec;
+            if (world.hit(r, interval(real(0.001), infinity), rec))
+                ++hits;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result{ ray_count / seconds, hits };
+    };
+
+    out << "Closest-hit throughput, " << spheres.objects.size() << " spheres, " << ray_count << " rays, "
+        << (sizeof(real) == 4 ? "float" : "double") << " precision, " << vreal::width << "-wide packets:\n";
+
+    auto report = [&](const char* name, const result& res) {
+        out << "  " << name << ": " << res.rays_per_sec / 1e6 << " M rays/sec (" << res.hits << " hits)\n";
+    };
+
+    auto baseline = run(spheres);
+    report("hittable_list (virtual)", baseline);
+
+    auto simd = run(packed);
+    report("sphere_soa (packed)    ", simd);
+    out << "  speedup: " << simd.rays_per_sec / baseline.rays_per_sec << "x\n";
+
+    report("bvh_node               ", run(bvh));
+}
+
+inline double display_rmse(const framebuffer& a, const framebuffer& b) {
+    // Root mean square difference of the two images after tone mapping, over all channels.
+    auto da = tonemap(a);
+    auto db = tonemap(b);
+    double sum = 0;
+    for (size_t k = 0; k < da.size(); ++k) {
+        double d = static_cast<double>(da[k]) - db[k];
+        sum += d * d;
+    }
+    return da.empty() ? 0.0 : std::sqrt(sum / da.size());
+}
+
+inline void benchmark_convergence(std::ostream& out, camera cam, const hittable& world, const material_table& materials,
+                                  const hittable_list& lights, int reference_spp = 1024) {
+    // Renders the scene at a reduced size with each sampler for a series of time budgets and
+    // reports the samples per pixel reached and the error against an independent-sampler
+    // reference of reference_spp samples, rendered from a different seed.
+    cam.image_width = 320;
+    cam.output_path.clear();
+    cam.checkpoint_path.clear();
+    cam.resume = false;
+    cam.adaptive_max_spp = 0;
+
+    auto reference_cam = cam;
+    reference_cam.sampler = sampler_type::independent;
+    reference_cam.seed = cam.seed + 0x5eed;
+    reference_cam.samples_per_pixel = reference_spp;
+    reference_cam.pass_samples = 0;
+    reference_cam.time_budget = 0;
+
+    out << "Rendering a " << reference_spp << " spp reference...\n";
+    auto reference = reference_cam.render_image(world, materials, lights);
+    out << "Reference done in " << reference_cam.last_render_stats().seconds << " s\n";
+
+    struct entry { const char* name; sampler_type type; };
+    const entry samplers[] = {
+        { "independent", sampler_type::independent },
+        { "sobol      ", sampler_type::sobol },
+        { "blue noise ", sampler_type::blue_noise },
+    };
+
+    out << "Display-space RMSE against the reference, " << cam.image_width << " pixels wide:\n";
+    for (double budget : { 0.25, 0.5, 1.0, 2.0, 4.0 }) {
+        out << "  " << budget << " s budget:\n";
+        for (const auto& s : samplers) {
+            // One sample per pixel per pass, so the render stops within a pass of the budget.
+            auto run = cam;
+            run.sampler = s.type;
+            run.samples_per_pixel = 1 << 16;
+            run.pass_samples = 1;
+            run.time_budget = budget;
+
+            auto image = run.render_image(world, materials, lights);
+            const auto& stats = run.last_render_stats();
+            out << "    " << s.name << "  " << stats.sample_limit << " spp in " << stats.seconds
+                << " s, RMSE " << display_rmse(image, reference) << '\n';
+        }
+    }
+}
+
+inline size_t peak_rss_bytes() {
+    // High-water mark of the process's resident memory so far. It never goes down, so scenes
+    // measured one after another in a single process each report the largest so far.
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+class cache_counters {
+    // Last-level cache references and misses of this process, including threads it starts
+    // while counting, from the Linux perf interface. available() is false where the kernel
+    // does not expose hardware counters, as in most virtual machines, and on other platforms.
+public:
+    cache_counters() {
+#ifdef __linux__
+        references_fd = open_counter(PERF_COUNT_HW_CACHE_REFERENCES);
+        misses_fd = open_counter(PERF_COUNT_HW_CACHE_MISSES);
+#endif
+    }
+
+    ~cache_counters() {
+#ifdef __linux__
+        if (references_fd >= 0) close(references_fd);
+        if (misses_fd >= 0) close(misses_fd);
+#endif
+    }
+
+    cache_counters(const cache_counters&) = delete;
+    cache_counters& operator=(const cache_counters&) = delete;
+
+    bool available() const { return references_fd >= 0 && misses_fd >= 0; }
+
+    void start() {
+#ifdef __linux__
+        for (int fd : { references_fd, misses_fd }) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void stop(uint64_t& references, uint64_t& misses) {
+        references = misses = 0;
+#ifdef __linux__
+        ioctl(references_fd, PERF_EVENT_IOC_DISABLE, 0);
+        ioctl(misses_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(references_fd, &references, sizeof(references)) != sizeof(references)
+            || read(misses_fd, &misses, sizeof(misses)) != sizeof(misses))
+            references = misses = 0;
+#endif
+    }
+
+private:
+    int references_fd = -1;
+    int misses_fd = -1;
+
+#ifdef __linux__
+    static int open_counter(uint64_t config) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+};
+
+inline void benchmark_wavefront(std::ostream& out, scene& s) {
+    // Renders the scene depth first and then as wavefront ray streams, at the --bench size,
+    // sample count and seed, and compares time, BVH nodes visited per ray and last-level cache
+    // misses. Both modes trace exactly the same rays, so nodes per ray only confirms that;
+    // the sorted streams can only pay off through the memory system, which the cache counters
+    // show where the machine exposes them.
+    auto cam = s.cam;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 16;
+    cam.seed = 1;
+    cam.adaptive_max_spp = 0;
+    cam.pass_samples = 0;
+    cam.time_budget = 0;
+    cam.output_path.clear();
+    cam.checkpoint_path.clear();
+    cam.resume = false;
+    cam.denoise = false;
+
+    cache_counters counters;
+    framebuffer images[2];
+    out << "Depth first against wavefront, " << cam.image_width << " pixels wide, " << cam.samples_per_pixel
+        << " spp, " << resolve_thread_count(cam.num_threads) << " thread(s):\n";
+
+    for (int mode = 0; mode < 2; ++mode) {
+        cam.wavefront = mode == 1;
+        uint64_t references = 0, misses = 0;
+        counters.start();
+        images[mode] = cam.render_image(*s.bvh, s.materials, s.lights);
+        counters.stop(references, misses);
+
+        const auto& stats = cam.last_render_stats();
+        auto rays = stats.rays_cast + stats.shadow_rays;
+        out << (mode ? "  wavefront  : " : "  depth first: ") << stats.seconds << " s, "
+            << stats.rays_per_second() / 1e6 << " M rays/sec, " << stats.average_nodes_visited() << " nodes/ray, ";
+        if (counters.available() && rays > 0)
+            out << misses << " LLC misses (" << 1000.0 * misses / rays << " per 1000 rays, "
+                << (references ? 100.0 * misses / references : 0.0) << "% of references)\n";
+        else
+            out << "cache misses unavailable (no hardware counters)\n";
+    }
+
+    out << "  images identical: " << (images[0].pixels == images[1].pixels ? "yes" : "no") << '\n';
+}
+
+inline std::string json_string(const std::string& text) {
+    // text as a quoted JSON string; scene names can be file paths, with backslashes or quotes.
+    std::string quoted = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += static_cast<char>(c);
+        }
+        else if (c < 0x20) {
+            const char* hex = "0123456789abcdef";
+            quoted += "\\u00";
+            quoted += hex[c >> 4];
+            quoted += hex[c & 15];
+        }
+        else {
+            quoted += static_cast<char>(c);
+        }
+    }
+    return quoted + '"';
+}
+
+inline void benchmark_scene(std::ostream& out, const std::string& name, scene& s) {
+    // Renders a built scene at a fixed size, sample count and seed, whatever the scene itself
+    // asks for, and writes one JSON object with the timings and counters. The render mode
+    // flags already set on s.cam (threads, wavefront, sampler, light sampling) are kept.
+    auto& cam = s.cam;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 16;
+    cam.seed = 1;
+    cam.adaptive_max_spp = 0;
+    cam.pass_samples = 0;
+    cam.time_budget = 0;
+    cam.output_path.clear();
+    cam.checkpoint_path.clear();
+    cam.resume = false;
+
+    auto image = cam.render_image(*s.bvh, s.materials, s.lights);
+    const auto& stats = cam.last_render_stats();
+
+    out << "  {\n"
+        << "    \"scene\": " << json_string(name) << ",\n"
+        << "    \"width\": " << image.width << ",\n"
+        << "    \"height\": " << image.height << ",\n"
+        << "    \"samples_per_pixel\": " << cam.samples_per_pixel << ",\n"
+        << "    \"seed\": " << cam.seed << ",\n"
+        << "    \"precision\": \"" << (sizeof(real) == 4 ? "float" : "double") << "\",\n"
+        << "    \"objects\": " << s.bvh->object_count() << ",\n"
+        << "    \"build_seconds\": " << s.build_seconds << ",\n"
+        << "    \"bvh_build_seconds\": " << s.bvh->build_seconds() << ",\n"
+        << "    \"render_seconds\": " << stats.seconds << ",\n"
+        << "    \"rays_per_second\": " << stats.rays_per_second() << ",\n"
+        << "    \"primary_rays\": " << stats.paths << ",\n"
+        << "    \"secondary_rays\": " << stats.rays_cast - stats.paths << ",\n"
+        << "    \"shadow_rays\": " << stats.shadow_rays << ",\n"
+        << "    \"nodes_per_ray\": " << stats.average_nodes_visited() << ",\n"
+        << "    \"peak_rss_bytes\": " << peak_rss_bytes() << ",\n"
+        << "    \"thread_utilization\": [";
+    for (size_t k = 0; k < stats.worker_seconds.size(); ++k)
+        out << (k ? ", " : "") << stats.worker_utilization(k);
+    out << "]\n  }";
+}
+
+#endif
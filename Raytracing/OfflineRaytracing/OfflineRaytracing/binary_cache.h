@@ -0,0 +1,149 @@
+#pragma once
+
+#ifndef BINARY_CACHE_H
+#define BINARY_CACHE_H
+
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <type_traits>
+#include <vector>
+
+// Raw binary reading and writing for cache files: values and arrays of trivially copyable
+// types in the machine's own byte order, each array prefixed by its 64-bit element count.
+// Readers map the file and check every read against its size, so a truncated or foreign file
+// fails cleanly instead of being read out of bounds.
+
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+    // 64-bit FNV-1a, for telling whether a cache's source has changed.
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t k = 0; k < size; ++k) {
+        hash ^= bytes[k];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline bool atomic_write_file(const std::string& path, std::initializer_list<std::pair<const void*, size_t>> parts) {
+    // Writes the parts, in order, to a temporary file and renames it over path, so readers
+    // never see a half-written file and a process killed mid-write leaves the old one intact.
+    std::string temp_path = path + ".tmp";
+    FILE* out = nullptr;
+#ifdef _WIN32
+    if (fopen_s(&out, temp_path.c_str(), "wb") != 0)
+        out = nullptr;
+#else
+    out = fopen(temp_path.c_str(), "wb");
+#endif
+    if (!out)
+        return false;
+
+    bool ok = true;
+    for (const auto& part : parts)
+        ok = ok && fwrite(part.first, 1, part.second, out) == part.second;
+    ok = fclose(out) == 0 && ok;
+    if (!ok) {
+        remove(temp_path.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    return MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+}
+
+class cache_writer {
+public:
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "cache values are written as raw bytes");
+        append(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void put_array(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "cache arrays are written as raw bytes");
+        put(static_cast<uint64_t>(values.size()));
+        append(values.data(), values.size() * sizeof(T));
+    }
+
+    template <typename T>
+    void patch(size_t offset, const T& value) {
+        // Overwrites a value put earlier at offset, for headers that point forward.
+        memcpy(&bytes[offset], &value, sizeof(T));
+    }
+
+    size_t size() const { return bytes.size(); }
+
+    bool save(const std::string& path) const {
+        return atomic_write_file(path, { { bytes.data(), bytes.size() } });
+    }
+
+private:
+    std::vector<uint8_t> bytes;
+
+    void append(const void* data, size_t size) {
+        auto src = static_cast<const uint8_t*>(data);
+        bytes.insert(bytes.end(), src, src + size);
+    }
+};
+
+class cache_reader {
+public:
+    bool open(const std::string& path) {
+        pos = 0;
+        ok = file.open_read(path);
+        return ok;
+    }
+
+    void close() {
+        file.close();
+        ok = false;
+    }
+
+    template <typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "cache values are read as raw bytes");
+        if (!ok || file.size() - pos < sizeof(T))
+            return ok = false;
+        memcpy(&value, file.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool get_array(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "cache arrays are read as raw bytes");
+        uint64_t count = 0;
+        if (!get(count) || count > (file.size() - pos) / sizeof(T))
+            return ok = false;
+        values.resize(static_cast<size_t>(count));
+        if (count)
+            memcpy(values.data(), file.data() + pos, static_cast<size_t>(count) * sizeof(T));
+        pos += static_cast<size_t>(count) * sizeof(T);
+        return true;
+    }
+
+    bool seek(uint64_t offset) {
+        if (!file.is_open() || offset > file.size())
+            return ok = false;
+        pos = static_cast<size_t>(offset);
+        return ok = true;
+    }
+
+    bool good() const { return ok; }
+
+private:
+    mapped_file file;
+    size_t pos = 0;
+    bool ok = false;
+};
+
+#endif
@@ -0,0 +1,365 @@
+#pragma once
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "binary_cache.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct bvh_flat_node {
+    aabb     box;
+    uint32_t offset;  // Leaf: first primitive slot. Interior: index of the second child.
+    uint16_t count;   // Primitive count for leaves, 0 for interior nodes
+    uint16_t axis;    // Split axis of an interior node
+};
+
+inline uint64_t& thread_nodes_visited() {
+    // BVH nodes the calling thread has visited, summed over every hierarchy, until someone
+    // collects and resets it. Counting per thread keeps traversal from writing to memory other
+    // threads use; the camera gathers the counts once per tile.
+    thread_local uint64_t count = 0;
+    return count;
+}
+
+class bvh_tree {
+    // A bounding volume hierarchy over an array of primitive boxes, built with the binned
+    // surface area heuristic and stored depth-first in one contiguous array. The first child of
+    // an interior node always sits directly after its parent, so only the second child needs an
+    // index. Leaves refer to a range of `prim_indices`; owners reorder their primitives to match
+    // so that a leaf touches contiguous memory.
+public:
+    std::vector<bvh_flat_node> nodes;
+    std::vector<uint32_t>      prim_indices;
+
+    int max_leaf_size = 4;
+
+    void build(const std::vector<aabb>& prim_boxes) {
+        nodes.clear();
+        prim_indices.resize(prim_boxes.size());
+        for (size_t k = 0; k < prim_indices.size(); ++k)
+            prim_indices[k] = static_cast<uint32_t>(k);
+
+        if (prim_boxes.empty())
+            return;
+
+        centroids.resize(prim_boxes.size());
+        for (size_t k = 0; k < prim_boxes.size(); ++k)
+            centroids[k] = prim_boxes[k].centroid();
+
+        nodes.reserve(2 * prim_boxes.size());
+        build_recursive(prim_boxes, 0, static_cast<uint32_t>(prim_boxes.size()), 0);
+
+        centroids.clear();
+        centroids.shrink_to_fit();
+    }
+
+    bool valid(size_t prim_count) const {
+        // Checks a tree that came from outside, such as a cache file, before it is traversed.
+        // Leaf ranges have to stay in bounds. Both children of an interior node have to come
+        // after it, so traversal only ever moves forward and ends. No path may be deeper than
+        // the traversal stack, which never holds more entries than the current node's depth.
+        // Children come after their parents, so one forward pass finds every node's depth.
+        std::vector<int> depth(nodes.size(), 0);
+        for (size_t k = 0; k < nodes.size(); ++k) {
+            const bvh_flat_node& node = nodes[k];
+            if (node.count > 0) {
+                if (size_t(node.offset) + node.count > prim_count)
+                    return false;
+                continue;
+            }
+
+            if (k + 1 >= nodes.size() || node.offset <= k || node.offset >= nodes.size())
+                return false;
+            int child_depth = depth[k] + 1;
+            if (child_depth >= max_stack_depth)
+                return false;
+            depth[k + 1] = std::max(depth[k + 1], child_depth);
+            depth[node.offset] = std::max(depth[node.offset], child_depth);
+        }
+        return true;
+    }
+
+    aabb bounds() const {
+        return nodes.empty() ? aabb() : nodes[0].box;
+    }
+
+    template <typename PrimHit>
+    bool traverse(const ray& r, interval& ray_t, PrimHit&& hit_prim, uint64_t& visited) const {
+        // Walks the tree front to back. hit_prim(slot, ray_t) tests the primitive in the given
+        // leaf slot and shrinks ray_t.max on a hit, so later boxes are culled against the
+        // closest hit so far.
+        if (nodes.empty())
+            return false;
+
+        auto orig = r.origin();
+        auto dir = r.direction();
+        vec3 inv_dir(1 / dir[0], 1 / dir[1], 1 / dir[2]);
+        bool dir_negative[3] = { dir[0] < 0, dir[1] < 0, dir[2] < 0 };
+
+        uint32_t stack[max_stack_depth];
+        int stack_size = 0;
+        uint32_t current = 0;
+        bool hit_anything = false;
+
+        while (true) {
+            const bvh_flat_node& node = nodes[current];
+            ++visited;
+
+            if (node.box.hit(orig, inv_dir, ray_t)) {
+                if (node.count > 0) {
+                    for (uint32_t k = node.offset; k < node.offset + node.count; ++k)
+                        if (hit_prim(k, ray_t))
+                            hit_anything = true;
+                }
+                else {
+                    // Descend into the child on the near side of the split plane first.
+                    if (dir_negative[node.axis]) {
+                        stack[stack_size++] = current + 1;
+                        current = node.offset;
+                    }
+                    else {
+                        stack[stack_size++] = node.offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+
+            if (stack_size == 0)
+                break;
+            current = stack[--stack_size];
+        }
+
+        return hit_anything;
+    }
+
+private:
+    static constexpr int bin_count = 16;
+    static constexpr int max_stack_depth = 128;
+    static constexpr int max_sah_depth = 64;  // Past this depth fall back to median splits
+
+    std::vector<point3> centroids;
+
+    void build_recursive(const std::vector<aabb>& prim_boxes, uint32_t begin, uint32_t end, int depth) {
+        uint32_t node_index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(bvh_flat_node());
+
+        aabb bounds;
+        aabb centroid_bounds;
+        for (uint32_t k = begin; k < end; ++k) {
+            bounds = aabb(bounds, prim_boxes[prim_indices[k]]);
+            const point3& c = centroids[prim_indices[k]];
+            centroid_bounds = aabb(centroid_bounds, aabb(c, c));
+        }
+        nodes[node_index].box = bounds;
+
+        uint32_t count = end - begin;
+        int axis = 0;
+        uint32_t mid = begin;
+
+        if (count <= static_cast<uint32_t>(max_leaf_size) || !choose_split(prim_boxes, begin, end, bounds, centroid_bounds, depth, axis, mid)) {
+            nodes[node_index].offset = begin;
+            nodes[node_index].count = static_cast<uint16_t>(count);
+            nodes[node_index].axis = 0;
+            return;
+        }
+
+        build_recursive(prim_boxes, begin, mid, depth + 1);
+        nodes[node_index].offset = static_cast<uint32_t>(nodes.size());
+        nodes[node_index].count = 0;
+        nodes[node_index].axis = static_cast<uint16_t>(axis);
+        build_recursive(prim_boxes, mid, end, depth + 1);
+    }
+
+    bool choose_split(const std::vector<aabb>& prim_boxes, uint32_t begin, uint32_t end,
+                      const aabb& bounds, const aabb& centroid_bounds, int depth, int& axis, uint32_t& mid) {
+        // Picks a split for [begin, end) and partitions prim_indices around it. Returns false
+        // when keeping the range as a single leaf is cheaper.
+        uint32_t count = end - begin;
+
+        axis = 0;
+        for (int a = 1; a < 3; ++a)
+            if (centroid_bounds.axis(a).size() > centroid_bounds.axis(axis).size())
+                axis = a;
+
+        if (centroid_bounds.axis(axis).size() <= 0) {
+            // Every centroid coincides; only an arbitrary split can make the leaves smaller.
+            if (count <= max_leaf_cap)
+                return false;
+            mid = begin + count / 2;
+            return true;
+        }
+
+        if (depth >= max_sah_depth) {
+            // Median splits bound the remaining depth to log2(count).
+            mid = begin + count / 2;
+            auto first = prim_indices.begin() + begin;
+            std::nth_element(first, prim_indices.begin() + mid, prim_indices.begin() + end,
+                [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+            return true;
+        }
+
+        // Bin the primitives along every axis and evaluate the SAH at each bin boundary.
+        double best_cost = infinity;
+        int best_axis = -1;
+        int best_split = 0;
+
+        for (int a = 0; a < 3; ++a) {
+            const interval& extent = centroid_bounds.axis(a);
+            if (extent.size() <= 0)
+                continue;
+
+            aabb bin_bounds[bin_count];
+            uint32_t bin_counts[bin_count] = {};
+            double scale = bin_count / extent.size();
+
+            for (uint32_t k = begin; k < end; ++k) {
+                uint32_t prim = prim_indices[k];
+                int b = std::min(bin_count - 1, static_cast<int>((centroids[prim][a] - extent.min) * scale));
+                bin_counts[b]++;
+                bin_bounds[b] = aabb(bin_bounds[b], prim_boxes[prim]);
+            }
+
+            // Sweep from the right to get the area and count of every right-hand side.
+            double right_area[bin_count];
+            uint32_t right_count[bin_count];
+            aabb right_box;
+            uint32_t running = 0;
+            for (int b = bin_count - 1; b > 0; --b) {
+                right_box = aabb(right_box, bin_bounds[b]);
+                running += bin_counts[b];
+                right_area[b] = right_box.surface_area();
+                right_count[b] = running;
+            }
+
+            aabb left_box;
+            uint32_t left_count = 0;
+            for (int b = 0; b < bin_count - 1; ++b) {
+                left_box = aabb(left_box, bin_bounds[b]);
+                left_count += bin_counts[b];
+                if (left_count == 0 || right_count[b + 1] == 0)
+                    continue;
+                double cost = left_box.surface_area() * left_count + right_area[b + 1] * right_count[b + 1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = a;
+                    best_split = b + 1;
+                }
+            }
+        }
+
+        // Leaf cost is one intersection per primitive; a split pays one traversal step plus the
+        // area-weighted cost of both children.
+        double parent_area = bounds.surface_area();
+        double leaf_cost = count;
+        double split_cost = parent_area > 0 ? traversal_cost + best_cost / parent_area : infinity;
+
+        if (best_axis < 0 || (split_cost >= leaf_cost && count <= max_leaf_cap)) {
+            if (count <= max_leaf_cap)
+                return false;
+            mid = begin + count / 2;
+            return true;
+        }
+
+        axis = best_axis;
+        const interval& extent = centroid_bounds.axis(axis);
+        double scale = bin_count / extent.size();
+        auto middle = std::partition(prim_indices.begin() + begin, prim_indices.begin() + end,
+            [&](uint32_t prim) {
+                int b = std::min(bin_count - 1, static_cast<int>((centroids[prim][axis] - extent.min) * scale));
+                return b < best_split;
+            });
+        mid = static_cast<uint32_t>(middle - prim_indices.begin());
+
+        if (mid == begin || mid == end)
+            mid = begin + count / 2;
+        return true;
+    }
+
+    static constexpr uint32_t max_leaf_cap = 16;  // Largest leaf the SAH may choose over a split
+    static constexpr double traversal_cost = 1.0;
+};
+
+class bvh_node : public hittable {
+public:
+    bvh_node(const hittable_list& list) : bvh_node(list.objects) {}
+
+    bvh_node(const std::vector<shared_ptr<hittable>>& src_objects) {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<aabb> boxes;
+        boxes.reserve(src_objects.size());
+        for (const auto& object : src_objects)
+            boxes.push_back(object->bounding_box());
+
+        tree.build(boxes);
+
+        // Store the objects in leaf order so each leaf reads a contiguous run.
+        objects.reserve(src_objects.size());
+        for (auto index : tree.prim_indices)
+            objects.push_back(src_objects[index]);
+
+        build_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bvh_node(const std::vector<shared_ptr<hittable>>& src_objects, bvh_tree&& prebuilt) : tree(std::move(prebuilt)) {
+        // Adopts a hierarchy built earlier over the same objects in the same order.
+        objects.reserve(src_objects.size());
+        for (auto index : tree.prim_indices)
+            objects.push_back(src_objects[index]);
+    }
+
+    void write_cache(cache_writer& out) const {
+        out.put_array(tree.nodes);
+        out.put_array(tree.prim_indices);
+    }
+
+    static shared_ptr<bvh_node> read_cache(cache_reader& in, const std::vector<shared_ptr<hittable>>& src_objects) {
+        // Returns the hierarchy written by write_cache for these objects, or null if the cached
+        // one does not fit them.
+        bvh_tree tree;
+        if (!in.get_array(tree.nodes) || !in.get_array(tree.prim_indices))
+            return nullptr;
+        if (tree.prim_indices.size() != src_objects.size() || !tree.valid(src_objects.size()))
+            return nullptr;
+        for (auto index : tree.prim_indices)
+            if (index >= src_objects.size())
+                return nullptr;
+        return make_shared<bvh_node>(src_objects, std::move(tree));
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        uint64_t visited = 0;
+        bool hit_anything = tree.traverse(r, ray_t, [&](uint32_t slot, interval& t) {
+            if (!objects[slot]->hit(r, t, rec))
+                return false;
+            t.max = rec.t;
+            return true;
+        }, visited);
+
+        thread_nodes_visited() += visited;
+        return hit_anything;
+    }
+
+    aabb bounding_box() const override { return tree.bounds(); }
+
+    size_t node_count() const { return tree.nodes.size(); }
+    size_t object_count() const { return objects.size(); }
+    double build_seconds() const { return build_time; }
+
+private:
+    std::vector<shared_ptr<hittable>> objects;
+    bvh_tree tree;
+    double build_time = 0;
+};
+
+#endif
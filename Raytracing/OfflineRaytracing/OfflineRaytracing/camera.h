@@ -5,49 +5,302 @@
 
 #include "rtweekend.h"
 
+#include "binary_cache.h"
+#include "bvh.h"
+#include "checkpoint.h"
+#include "denoise.h"
 #include "color.h"
 #include "hittable.h"
+#include "hittable_list.h"
+#include "image.h"
 #include "material.h"
+#include "sampler.h"
+#include "tile_scheduler.h"
+#include "wavefront.h"
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct render_stats {
+    uint64_t pixels = 0;               // Pixels rendered
+    uint64_t paths = 0;                // Camera samples traced
+    uint64_t rays_cast = 0;            // Every ray sent into the scene, primary or secondary
+    uint64_t shadow_rays = 0;          // Light sampling rays, not counted in rays_cast
+    uint64_t escaped = 0;              // Paths that left the scene and picked up the sky
+    uint64_t absorbed = 0;             // Paths ended by a material that did not scatter
+    uint64_t roulette_terminated = 0;  // Paths ended early by Russian roulette
+    uint64_t depth_limited = 0;        // Paths cut off at max_depth
+    uint64_t nodes_visited = 0;        // BVH nodes visited by all of those rays, at every level
+    double   seconds = 0;              // Wall time spent tracing
+    double   denoise_seconds = 0;      // Wall time spent on the AOV pass and the denoiser
+    uint32_t sample_limit = 0;         // Samples per pixel reached by the last pass
+    std::vector<double> worker_seconds;  // Time each worker thread spent inside tiles
+
+    void merge(const render_stats& other) {
+        pixels += other.pixels;
+        paths += other.paths;
+        rays_cast += other.rays_cast;
+        shadow_rays += other.shadow_rays;
+        escaped += other.escaped;
+        absorbed += other.absorbed;
+        roulette_terminated += other.roulette_terminated;
+        depth_limited += other.depth_limited;
+        nodes_visited += other.nodes_visited;
+    }
+
+    double average_path_length() const {
+        return paths ? static_cast<double>(rays_cast) / paths : 0.0;
+    }
+
+    double average_samples_per_pixel() const {
+        return pixels ? static_cast<double>(paths) / pixels : 0.0;
+    }
+
+    double worker_utilization(size_t worker) const {
+        // Fraction of the wall time the worker spent tracing rather than waiting.
+        return seconds > 0 && worker < worker_seconds.size() ? worker_seconds[worker] / seconds : 0.0;
+    }
+
+    double average_nodes_visited() const {
+        // Per extension or shadow ray, counting the nodes of every hierarchy the ray enters.
+        auto rays = rays_cast + shadow_rays;
+        return rays ? static_cast<double>(nodes_visited) / rays : 0.0;
+    }
+
+    double rays_per_second() const {
+        // Extension and shadow rays together.
+        return seconds > 0 ? (rays_cast + shadow_rays) / seconds : 0.0;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const render_stats& stats) {
+    return out << "Paths: " << stats.paths << " (" << stats.average_samples_per_pixel() << " per pixel)"
+               << ", rays cast: " << stats.rays_cast
+               << ", shadow rays: " << stats.shadow_rays
+               << ", average path length: " << stats.average_path_length()
+               << "\nPath ends: " << stats.escaped << " escaped, " << stats.absorbed << " absorbed, "
+               << stats.roulette_terminated << " roulette, " << stats.depth_limited << " depth limit"
+               << "\nBVH: " << stats.average_nodes_visited() << " nodes visited per ray"
+               << "\nTime: " << stats.seconds << " s, " << stats.rays_per_second() / 1e6 << " M rays/sec"
+               << (stats.denoise_seconds > 0 ? ", denoised in " + std::to_string(stats.denoise_seconds) + " s" : std::string());
+}
+
+struct pixel_accumulator {
+    // Running sums for one pixel: the color sum for the estimate and the first two moments of
+    // its luminance for the variance.
+    color    sum;
+    real     lum_sum = 0;
+    real     lum_sq_sum = 0;
+    uint32_t count = 0;
+
+    void add(const color& c) {
+        auto lum = real(0.2126) * c.x() + real(0.7152) * c.y() + real(0.0722) * c.z();
+        sum += c;
+        lum_sum += lum;
+        lum_sq_sum += lum * lum;
+        ++count;
+    }
+
+    color mean() const {
+        return count ? sum / static_cast<real>(count) : color(0, 0, 0);
+    }
+
+    real variance_of_mean() const {
+        // Estimated variance of the mean luminance: the sample variance over the count.
+        if (count < 2)
+            return 0;
+        auto n = static_cast<real>(count);
+        auto variance = std::fmax(real(0), (lum_sq_sum - lum_sum * (lum_sum / n)) / (n - 1));
+        return variance / n;
+    }
+
+    bool converged(real threshold) const {
+        // Compares the standard error of the mean luminance, carried through the gamma 2
+        // display transform, against the threshold. Dark pixels therefore need the same
+        // visible precision as bright ones rather than the same absolute error.
+        if (count < 2)
+            return false;
+        auto mean_lum = lum_sum / static_cast<real>(count);
+        auto std_error = std::sqrt(variance_of_mean());
+        auto display_error = std_error / (2 * std::sqrt(std::fmax(mean_lum, real(1e-4))));
+        return display_error <= threshold;
+    }
+};
+
+struct path_state {
+    // Everything a path carries from one bounce to the next apart from its ray.
+    color  radiance = color(0, 0, 0);
+    color  throughput = color(1, 1, 1);
+    real   scatter_pdf = 0;  // Density of the last bounce's direction, 0 after a specular one
+    point3 scatter_origin;   // Where the last bounce happened
+    int    depth = 0;        // Bounces so far
+};
+
+struct shadow_request {
+    // A light sample waiting for its visibility test. If the shadow ray's first hit is an
+    // emitter, the path gains throughput * (albedo * emission * scale).
+    ray   r;
+    color throughput;
+    color albedo;
+    real  scale = 0;
+    bool  pending = false;
+};
 
 class camera {
 public:
     /* Public Camera Parameters Here */
 
-    double aspect_ratio = 1.0;  // Ratio of image width over height
+    real   aspect_ratio = 1.0;  // Ratio of image width over height
     int    image_width = 100;  // Rendered image width in pixel count
-    int    samples_per_pixel = 10;   // Count of random samples for each pixel
+    int    samples_per_pixel = 10;   // Count of random samples for each pixel (the minimum when adaptive)
+    int    adaptive_max_spp = 0;     // Per-pixel sample cap for adaptive sampling (0 disables it)
+    real   noise_threshold = real(0.01);  // Display-space standard error at which a pixel counts as converged
+    int    adaptive_batch = 8;       // Samples taken between convergence checks
     int    max_depth = 10;   // Maximum number of ray bounces into scene
+    int    roulette_depth = 3;  // Bounces before Russian roulette may end a path (negative disables it)
+    bool   next_event = true;   // Sample the lights directly at diffuse hits and weight by MIS
+    bool   sky = true;          // Gradient sky on a miss; otherwise misses see black
 
-    double vfov = 90;  // Vertical view angle (field of view)
+    real   vfov = 90;  // Vertical view angle (field of view)
     point3 lookfrom = point3(0, 0, -1);  // Point camera is looking from
     point3 lookat = point3(0, 0, 0);   // Point camera is looking at
     vec3   vup = vec3(0, 1, 0);     // Camera-relative "up" direction
 
-    double defocus_angle = 0;  // Variation angle of rays through each pixel
-    double focus_dist = 10;    // Distance from camera lookfrom point to plane of perfect focus
+    real   defocus_angle = 0;  // Variation angle of rays through each pixel
+    real   focus_dist = 10;    // Distance from camera lookfrom point to plane of perfect focus
+
+    int      num_threads = 0;   // Worker thread count (0 uses every hardware thread)
+    int      tile_size = 32;    // Edge length in pixels of each scheduled tile
+    bool     wavefront = false; // Trace each tile breadth first as sorted ray streams
+    uint32_t seed = 1;          // Base seed; the same seed gives the same image at any thread count
+    sampler_type sampler = sampler_type::independent;  // Sequence behind every sampling decision
+
+    std::string output_path;    // Image file to write (.ppm, .pfm or .png); empty writes a PPM to stdout
+    bool        use_mmap = false;  // Encode straight into a memory-mapped output file
 
-    void render(const hittable& world) {
+    int         pass_samples = 0;   // Samples added per pixel in each progressive pass (0 renders in one pass)
+    double      time_budget = 0;    // Stop after the first pass that ends this many seconds in (0 for no limit)
+    std::string checkpoint_path;    // Accumulation state saved here after every pass (empty disables it)
+    bool        denoise = false;    // Filter the final image guided by first-hit albedo, normal and depth
+    int         aov_samples = 16;   // Camera samples per pixel averaged into those guide buffers
+    bool        resume = false;     // Continue from checkpoint_path when it matches this render
+    uint64_t    scene_hash = 0;     // Identifies the scene in checkpoints; set by the scene loader
+
+    void render(const hittable& world, const material_table& materials) {
+        render(world, materials, hittable_list());
+    }
+
+    void render(const hittable& world, const material_table& materials, const hittable_list& lights) {
+        framebuffer image = render_image(world, materials, lights);
+
+        // Emit the whole image in one write once every tile has finished.
+        if (!write_image(output_path, image, use_mmap))
+            std::cerr << "Failed to write image to " << (output_path.empty() ? "stdout" : output_path) << '\n';
+    }
+
+    framebuffer render_image(const hittable& world, const material_table& materials, const hittable_list& lights) {
+        // Renders in passes that each raise every pixel to a higher sample limit. Because each
+        // sample is seeded from its pixel and index, the passes add up to exactly the image a
+        // single pass would give, and a resumed render matches one that was never stopped.
         initialize();
 
-        std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+        framebuffer image(image_width, image_height);
+        accumulation.assign(static_cast<size_t>(image_width) * image_height, pixel_accumulator());
+
+        checkpoint_header header = checkpoint_settings();
 
-        for (int j = 0; j < image_height; ++j) {
-            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
-            for (int i = 0; i < image_width; ++i) {
-                color pixel_color(0, 0, 0);
-                for (int sample = 0; sample < samples_per_pixel; ++sample) {
-                    ray r = get_ray(i, j);
-                    pixel_color += ray_color(r, max_depth, world);
+        uint32_t cap = static_cast<uint32_t>(adaptive_max_spp > samples_per_pixel ? adaptive_max_spp : samples_per_pixel);
+        uint32_t pass_size = pass_samples > 0 ? static_cast<uint32_t>(pass_samples) : cap;
+        uint32_t limit = 0;
+
+        if (resume && !checkpoint_path.empty()) {
+            if (load_checkpoint(checkpoint_path, header, accumulation)) {
+                limit = header.sample_limit;
+                std::clog << "Resuming from " << checkpoint_path << " at " << limit << " samples per pixel\n";
+            }
+            else {
+                std::clog << "No usable checkpoint at " << checkpoint_path << ", starting over\n";
+            }
+        }
+
+        int threads = resolve_thread_count(num_threads);
+        int tiles_total = ((image_width + tile_size - 1) / tile_size) * ((image_height + tile_size - 1) / tile_size);
+        std::mutex log_lock;
+        stats = render_stats();
+        stats.pixels = image.pixel_count();
+        stats.worker_seconds.assign(threads, 0.0);
+
+        std::clog << "Rendering with " << threads << " thread(s)\n";
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+        bool out_of_time = false;
+
+        do {
+            limit = limit + pass_size < cap ? limit + pass_size : cap;
+            std::atomic<int> tiles_done{ 0 };
+
+            run_tiles(image_width, image_height, tile_size, threads, [&](const tile& t, int worker) {
+                auto tile_start = std::chrono::steady_clock::now();
+                render_stats tile_stats;
+                thread_nodes_visited() = 0;
+
+                if (wavefront)
+                    trace_tile_wavefront(t, limit, world, materials, lights, tile_stats);
+
+                for (int j = t.y0; j < t.y1; ++j) {
+                    for (int i = t.x0; i < t.x1; ++i) {
+                        auto pixel_index = static_cast<uint32_t>(j * image_width + i);
+                        auto& acc = accumulation[pixel_index];
+
+                        if (!wavefront)
+                            sample_pixel(i, j, acc, limit, world, materials, lights, tile_stats);
+                        image.set(i, j, acc.mean());
+                    }
                 }
-                write_color(std::cout, pixel_color, samples_per_pixel);
+
+                tile_stats.nodes_visited = thread_nodes_visited();
+                int done = ++tiles_done;
+                std::lock_guard<std::mutex> guard(log_lock);
+                stats.merge(tile_stats);
+                stats.worker_seconds[worker] += std::chrono::duration<double>(std::chrono::steady_clock::now() - tile_start).count();
+                std::clog << "\r" << limit << " spp, tiles remaining: " << (tiles_total - done) << ' ' << std::flush;
+            });
+
+            if (!checkpoint_path.empty()) {
+                header.sample_limit = limit;
+                if (!save_checkpoint(checkpoint_path, header, accumulation))
+                    std::cerr << "\nFailed to write checkpoint to " << checkpoint_path << '\n';
             }
+
+            // Refresh a file output after each pass so the image can be inspected while the
+            // render continues. Stdout only gets the final image.
+            out_of_time = time_budget > 0 && elapsed() >= time_budget;
+            if (limit < cap && !out_of_time && !output_path.empty())
+                write_image(output_path, image, use_mmap);
+        } while (limit < cap && !out_of_time);
+
+        stats.seconds = elapsed();
+        stats.sample_limit = limit;
+
+        if (denoise) {
+            auto aov = render_aovs(world, materials, threads);
+            std::vector<float> variance(accumulation.size());
+            for (size_t k = 0; k < variance.size(); ++k)
+                variance[k] = static_cast<float>(accumulation[k].variance_of_mean());
+            image = denoise_image(image, variance, aov, denoise_settings(), threads);
+            stats.denoise_seconds = elapsed() - stats.seconds;
         }
 
-        std::clog << "\rDone.                 \n";
+        std::clog << "\rDone.                              \n";
+        return image;
     }
 
+    const render_stats& last_render_stats() const { return stats; }
+
 private:
     /* Private Camera Variables Here */
 
@@ -59,6 +312,210 @@ private:
     vec3   u, v, w;        // Camera frame basis vectors
     vec3   defocus_disk_u;  // Defocus disk horizontal radius
     vec3   defocus_disk_v;  // Defocus disk vertical radius
+    render_stats stats;     // Counters from the most recent render
+    std::vector<pixel_accumulator> accumulation;  // Per-pixel sums and sample counts
+
+    void sample_pixel(int i, int j, pixel_accumulator& acc, uint32_t limit, const hittable& world,
+                      const material_table& materials, const hittable_list& lights, render_stats& tile_stats) const {
+        // Adds samples until the pixel holds `limit` of them or is finished.
+        auto pixel_index = static_cast<uint32_t>(j * image_width + i);
+
+        while (acc.count < limit && !pixel_done(acc)) {
+            // Seed from the pixel and sample, not the thread, so the result ignores
+            // scheduling order.
+            start_sample(sampler, seed, i, j, pixel_index, acc.count);
+            ray r = get_ray(i, j);
+            acc.add(ray_color(r, world, materials, lights, tile_stats));
+        }
+    }
+
+    void trace_tile_wavefront(const tile& t, uint32_t limit, const hittable& world, const material_table& materials,
+                              const hittable_list& lights, render_stats& tile_stats) {
+        // Breadth-first version of sample_pixel over a whole tile. Each round generates every
+        // sample the tile's unfinished pixels owe before their next convergence check, then
+        // pushes the whole stream through the stages one bounce at a time:
+        //
+        //     extend   sort live rays by direction octant and origin, then intersect them
+        //     sort     order the hits by material so each material's code runs in a batch
+        //     shade    scatter, queue light samples and retire finished paths
+        //     connect  trace the queued shadow rays
+        //
+        // Every path keeps its own generator and sampler state, and samples land in each pixel in sample
+        // order, so the image matches the depth-first one exactly.
+        ray_stream rays;
+        std::vector<path_state> paths;
+        std::vector<rng_engine> rngs;
+        std::vector<sampler_state> samplers;
+        std::vector<uint32_t> owners;  // Pixel index of each path
+        std::vector<hit_record> hits;
+        std::vector<uint8_t> hit_flags;
+        std::vector<uint8_t> keep_flags;
+        std::vector<shadow_request> shadows;
+        std::vector<uint32_t> live;
+        std::vector<keyed_slot> keys, scratch;
+
+        while (true) {
+            // Generate
+            rays.clear();
+            paths.clear();
+            rngs.clear();
+            samplers.clear();
+            owners.clear();
+
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; ++i) {
+                    auto pixel_index = static_cast<uint32_t>(j * image_width + i);
+                    const auto& acc = accumulation[pixel_index];
+                    if (acc.count >= limit || pixel_done(acc))
+                        continue;
+
+                    uint32_t stop = std::min(next_check(acc), limit);
+                    for (uint32_t s = acc.count; s < stop; ++s) {
+                        start_sample(sampler, seed, i, j, pixel_index, s);
+                        rays.push_back(get_ray(i, j));
+                        rngs.push_back(thread_rng());
+                        samplers.push_back(thread_sampler());
+                        paths.emplace_back();
+                        owners.push_back(pixel_index);
+                    }
+                }
+            }
+
+            if (paths.empty())
+                return;
+
+            size_t n = paths.size();
+            tile_stats.paths += n;
+            hits.resize(n);
+            hit_flags.resize(n);
+            keep_flags.resize(n);
+            shadows.resize(n);
+
+            live.clear();
+            if (max_depth > 0) {
+                for (uint32_t k = 0; k < n; ++k)
+                    live.push_back(k);
+            }
+            else {
+                tile_stats.depth_limited += n;
+            }
+
+            while (!live.empty()) {
+                // Extend
+                aabb origins;
+                for (auto k : live) {
+                    point3 o(rays.ox[k], rays.oy[k], rays.oz[k]);
+                    origins = aabb(origins, aabb(o, o));
+                }
+                keys.clear();
+                for (auto k : live)
+                    keys.push_back({ ray_sort_key(rays.get(k), origins), k });
+                sort_by_key(live, keys, scratch, 33);
+
+                for (auto k : live) {
+                    ++tile_stats.rays_cast;
+                    hit_flags[k] = world.hit(rays.get(k), interval(real(0.001), infinity), hits[k]);
+                }
+
+                // Sort: misses first, then by material type, then by material id.
+                keys.clear();
+                int id_bits = 1;
+                while ((size_t(1) << id_bits) < materials.size())
+                    ++id_bits;
+                for (auto k : live) {
+                    uint64_t key = 0;
+                    if (hit_flags[k]) {
+                        auto type = static_cast<uint64_t>(materials[hits[k].mat].type);
+                        key = ((type + 1) << id_bits) | hits[k].mat;
+                    }
+                    keys.push_back({ key, k });
+                }
+                sort_by_key(live, keys, scratch, id_bits + 3);
+
+                // Shade. A path that ends here keeps its slot until the connect stage has
+                // added its last light sample.
+                for (auto k : live) {
+                    thread_rng() = rngs[k];
+                    thread_sampler() = samplers[k];
+                    ray r = rays.get(k);
+                    shadows[k].pending = false;
+                    bool keep = shade(r, paths[k], hit_flags[k] ? &hits[k] : nullptr, materials, lights, shadows[k], tile_stats);
+                    rngs[k] = thread_rng();
+                    samplers[k] = thread_sampler();
+                    rays.set(k, r);
+                    keep_flags[k] = keep;
+                }
+
+                // Connect, then drop the finished paths.
+                size_t alive = 0;
+                for (auto k : live) {
+                    if (shadows[k].pending)
+                        paths[k].radiance += trace_shadow(shadows[k], world, materials, tile_stats);
+                    if (keep_flags[k])
+                        live[alive++] = k;
+                }
+                live.resize(alive);
+            }
+
+            for (size_t k = 0; k < n; ++k)
+                accumulation[owners[k]].add(paths[k].radiance);
+        }
+    }
+
+    uint32_t next_check(const pixel_accumulator& acc) const {
+        // The next sample count at which pixel_done() might report the pixel finished.
+        bool adaptive = adaptive_max_spp > samples_per_pixel;
+        auto cap = static_cast<uint32_t>(adaptive ? adaptive_max_spp : samples_per_pixel);
+        auto min_spp = static_cast<uint32_t>(samples_per_pixel);
+        auto batch = static_cast<uint32_t>(adaptive_batch);
+
+        uint32_t stop = cap;
+        if (adaptive)
+            stop = acc.count < min_spp ? min_spp : acc.count + batch - (acc.count - min_spp) % batch;
+        return std::min(stop, cap);
+    }
+
+    checkpoint_header checkpoint_settings() const {
+        // Everything that decides which samples a pass adds to the accumulation, so only a
+        // render that would have produced the same samples resumes from the checkpoint.
+        checkpoint_header header;
+        header.width = static_cast<uint32_t>(image_width);
+        header.height = static_cast<uint32_t>(image_height);
+        header.seed = seed;
+        header.sampler = static_cast<uint32_t>(sampler);
+        header.samples_per_pixel = static_cast<uint32_t>(samples_per_pixel);
+        header.adaptive_max_spp = static_cast<uint32_t>(adaptive_max_spp);
+        header.adaptive_batch = static_cast<uint32_t>(adaptive_batch);
+        header.noise_threshold = static_cast<float>(noise_threshold);
+        header.max_depth = max_depth;
+        header.roulette_depth = roulette_depth;
+        header.path_flags = (next_event ? checkpoint_next_event : 0) | (sky ? checkpoint_sky : 0);
+
+        const real view[] = {
+            aspect_ratio, vfov, defocus_angle, focus_dist,
+            lookfrom.x(), lookfrom.y(), lookfrom.z(),
+            lookat.x(), lookat.y(), lookat.z(),
+            vup.x(), vup.y(), vup.z(),
+        };
+        header.scene_hash = hash_bytes(view, sizeof(view), scene_hash);
+        return header;
+    }
+
+    bool pixel_done(const pixel_accumulator& acc) const {
+        // A pixel is finished at samples_per_pixel samples, or with adaptive sampling once it
+        // converges or reaches adaptive_max_spp. Convergence is only tested after the first
+        // samples_per_pixel and then every adaptive_batch samples, which depends on the count
+        // alone, so pass boundaries never change where a pixel stops.
+        bool adaptive = adaptive_max_spp > samples_per_pixel;
+        auto cap = static_cast<uint32_t>(adaptive ? adaptive_max_spp : samples_per_pixel);
+        auto min_spp = static_cast<uint32_t>(samples_per_pixel);
+
+        if (acc.count >= cap)
+            return true;
+        if (!adaptive || acc.count < min_spp || (acc.count - min_spp) % static_cast<uint32_t>(adaptive_batch) != 0)
+            return false;
+        return acc.converged(noise_threshold);
+    }
 
     void initialize() {
         image_height = static_cast<int>(image_width / aspect_ratio);
@@ -68,9 +525,9 @@ private:
 
         // Determine viewport dimensions.
         auto theta = degrees_to_radians(vfov);
-        auto h = tan(theta / 2);
+        auto h = std::tan(theta / 2);
         auto viewport_height = 2 * h * focus_dist;
-        auto viewport_width = viewport_height * (static_cast<double>(image_width) / image_height);
+        auto viewport_width = viewport_height * (static_cast<real>(image_width) / image_height);
 
         // Calculate the u,v,w unit basis vectors for the camera coordinate frame.
         w = unit_vector(lookfrom - lookat);
@@ -90,11 +547,76 @@ private:
         pixel00_loc = viewport_upper_left + 0.5 * (pixel_delta_u + pixel_delta_v);
 
         // Calculate the camera defocus disk basis vectors.
-        auto defocus_radius = focus_dist * tan(degrees_to_radians(defocus_angle / 2));
+        auto defocus_radius = focus_dist * std::tan(degrees_to_radians(defocus_angle / 2));
         defocus_disk_u = u * defocus_radius;
         defocus_disk_v = v * defocus_radius;
     }
 
+    aov_buffers render_aovs(const hittable& world, const material_table& materials, int threads) const {
+        // First-hit albedo, normal and depth for the denoiser, averaged over aov_samples camera
+        // samples so edges and defocus blur line up with the render. The albedo follows
+        // specular bounces to the first diffuse surface, so what a mirror or glass shows keeps
+        // its own color detail; the normal and depth stay at the first hit.
+        aov_buffers aov;
+        size_t pixels = static_cast<size_t>(image_width) * image_height;
+        aov.albedo.assign(3 * pixels, 0.0f);
+        aov.normal.assign(3 * pixels, 0.0f);
+        aov.depth.assign(pixels, 0.0f);
+        int samples = aov_samples > 0 ? aov_samples : 1;
+
+        run_tiles(image_width, image_height, tile_size, threads, [&](const tile& t, int) {
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; ++i) {
+                    auto pixel_index = static_cast<uint32_t>(j * image_width + i);
+                    color albedo_sum(0, 0, 0);
+                    vec3 normal_sum(0, 0, 0);
+                    real depth_sum = 0;
+
+                    for (int s = 0; s < samples; ++s) {
+                        // Stratified whatever the render uses: the guides only need pixel and
+                        // lens coverage, and Sobol points give it in far fewer samples.
+                        start_sample(sampler_type::sobol, seed ^ 0x6a09e667u, i, j, pixel_index, static_cast<uint32_t>(s));
+                        ray r = get_ray(i, j);
+                        color albedo(1, 1, 1);  // Sky and emitters pass their color through unchanged
+
+                        for (int bounce = 0; bounce < 4; ++bounce) {
+                            hit_record rec;
+                            if (!world.hit(r, interval(real(0.001), infinity), rec))
+                                break;
+                            if (bounce == 0) {
+                                normal_sum += rec.normal;
+                                depth_sum += rec.t * r.direction().length();
+                            }
+
+                            const material& mat = materials[rec.mat];
+                            if (mat.type == material_type::lambertian) {
+                                albedo = albedo * mat.albedo;
+                                break;
+                            }
+
+                            ray scattered;
+                            color attenuation;
+                            sampler_seek(sampler_slot::bounce(bounce, sampler_slot::bsdf));
+                            if (!mat.scatter(r, rec, attenuation, scattered))
+                                break;
+                            albedo = albedo * attenuation;
+                            r = scattered;
+                        }
+                        albedo_sum += albedo;
+                    }
+
+                    auto normal = normal_sum.length_squared() > 0 ? unit_vector(normal_sum) : vec3(0, 0, 0);
+                    for (int c = 0; c < 3; ++c) {
+                        aov.albedo[3 * pixel_index + c] = static_cast<float>(albedo_sum[c] / samples);
+                        aov.normal[3 * pixel_index + c] = static_cast<float>(normal[c]);
+                    }
+                    aov.depth[pixel_index] = static_cast<float>(depth_sum / samples);
+                }
+            }
+        });
+        return aov;
+    }
+
     ray get_ray(int i, int j) const {
         // Get a randomly-sampled camera ray for the pixel at location i,j, originating from
         // the camera defocus disk.
@@ -110,34 +632,162 @@ private:
 
     vec3 pixel_sample_square() const {
         // Returns a random point in the square surrounding a pixel at the origin.
-        auto px = -0.5 + random_double();
-        auto py = -0.5 + random_double();
+        sampler_seek(sampler_slot::pixel);
+        auto s = sample_2d();
+        auto px = s.u - real(0.5);
+        auto py = s.v - real(0.5);
         return (px * pixel_delta_u) + (py * pixel_delta_v);
     }
 
-    color ray_color(const ray& r, int depth, const hittable& world) const {
-        hit_record rec;
+    color ray_color(ray r, const hittable& world, const material_table& materials, const hittable_list& lights,
+                    render_stats& path_stats) const {
+        // Follows one path depth first, alternating a closest-hit query with shade() until the
+        // path ends. The wavefront mode runs the same two steps over whole streams of paths.
+        path_state path;
+        ++path_stats.paths;
+
+        if (max_depth <= 0) {
+            ++path_stats.depth_limited;
+            return path.radiance;
+        }
+
+        while (true) {
+            hit_record rec;
+            ++path_stats.rays_cast;
+            bool hit = world.hit(r, interval(real(0.001), infinity), rec);
+
+            shadow_request shadow;
+            bool alive = shade(r, path, hit ? &rec : nullptr, materials, lights, shadow, path_stats);
+            if (shadow.pending)
+                path.radiance += trace_shadow(shadow, world, materials, path_stats);
+
+            if (!alive)
+                return path.radiance;
+        }
+    }
+
+    bool shade(ray& r, path_state& path, const hit_record* rec, const material_table& materials,
+               const hittable_list& lights, shadow_request& shadow, render_stats& path_stats) const {
+        // Advances a path by one bounce given the closest hit of its ray r (null on a miss),
+        // replacing r with the scattered ray. Returns false once the path has ended.
+        //
+        // The path carries the product of the attenuations so far as its throughput. Once it
+        // has bounced roulette_depth times it survives each further bounce with probability
+        // equal to its brightest throughput channel, and survivors are reweighted by 1/p so the
+        // estimate stays unbiased.
+        //
+        // With next-event estimation every diffuse hit also queues one shadow ray towards a
+        // sampled light. Emitters are then reachable two ways, by the shadow ray and by the
+        // scattered ray, and the power heuristic weights each by how likely the other was to
+        // find the same direction.
+        bool sample_lights = next_event && !lights.objects.empty();
+
+        if (!rec) {
+            ++path_stats.escaped;
+            path.radiance += path.throughput * background(r);
+            return false;
+        }
+
+        const material& mat = materials[rec->mat];
+        color emission = mat.emitted(r, *rec);
+        if (!emission.near_zero()) {
+            real weight = 1;
+            if (sample_lights && path.scatter_pdf > 0)
+                weight = power_heuristic(path.scatter_pdf, lights.pdf_value(path.scatter_origin, r.direction()));
+            path.radiance += path.throughput * emission * weight;
+        }
+
+        ray scattered;
+        color attenuation;
+        sampler_seek(sampler_slot::bounce(path.depth, sampler_slot::bsdf));
+        if (!mat.scatter(r, *rec, attenuation, scattered)) {
+            ++path_stats.absorbed;
+            return false;
+        }
+
+        path.scatter_pdf = mat.scattering_pdf(r, *rec, scattered);
+        path.scatter_origin = rec->p;
+
+        if (sample_lights && path.scatter_pdf > 0) {
+            sampler_seek(sampler_slot::bounce(path.depth, sampler_slot::light_choice));
+            sample_light(r, *rec, attenuation, path.throughput, materials, lights, shadow);
+        }
+
+        path.throughput = path.throughput * attenuation;
+        r = scattered;
+
+        if (roulette_depth >= 0 && path.depth >= roulette_depth) {
+            auto survive = std::fmax(path.throughput.x(), std::fmax(path.throughput.y(), path.throughput.z()));
+            if (survive < 1) {
+                sampler_seek(sampler_slot::bounce(path.depth, sampler_slot::roulette));
+                if (sample_1d() >= survive) {
+                    ++path_stats.roulette_terminated;
+                    return false;
+                }
+                path.throughput /= survive;
+            }
+        }
 
         // If we've exceeded the ray bounce limit, no more light is gathered.
-        if (depth <= 0)
+        if (++path.depth >= max_depth) {
+            ++path_stats.depth_limited;
+            return false;
+        }
+        return true;
+    }
+
+    void sample_light(const ray& r_in, const hit_record& rec, const color& albedo, const color& throughput,
+                      const material_table& materials, const hittable_list& lights, shadow_request& shadow) const {
+        // Picks one light direction from a diffuse hit and fills in the shadow request with its
+        // MIS-weighted contribution, leaving only the visibility test for trace_shadow().
+        ray to_light(rec.p, lights.random(rec.p));
+        auto light_pdf = lights.pdf_value(rec.p, to_light.direction());
+        if (light_pdf <= 0)
+            return;
+
+        auto bsdf_pdf = materials[rec.mat].scattering_pdf(r_in, rec, to_light);
+        if (bsdf_pdf <= 0)
+            return;
+
+        auto weight = power_heuristic(light_pdf, bsdf_pdf);
+        shadow.r = to_light;
+        shadow.throughput = throughput;
+        shadow.albedo = albedo;
+        shadow.scale = bsdf_pdf * weight / light_pdf;
+        shadow.pending = true;
+    }
+
+    color trace_shadow(const shadow_request& shadow, const hittable& world, const material_table& materials,
+                       render_stats& path_stats) const {
+        // The shadow ray's radiance is only counted if the first thing it reaches is an emitter.
+        hit_record light_rec;
+        ++path_stats.shadow_rays;
+        if (!world.hit(shadow.r, interval(real(0.001), infinity), light_rec))
             return color(0, 0, 0);
 
-        if (world.hit(r, interval(0.001, infinity), rec)) {
-            ray scattered;
-            color attenuation;
-            if (rec.mat->scatter(r, rec, attenuation, scattered))
-                return attenuation * ray_color(scattered, depth - 1, world);
+        color emission = materials[light_rec.mat].emitted(shadow.r, light_rec);
+        return shadow.throughput * (shadow.albedo * emission * shadow.scale);
+    }
+
+    static real power_heuristic(real pdf, real other_pdf) {
+        auto a = pdf * pdf;
+        auto b = other_pdf * other_pdf;
+        return a / (a + b);
+    }
+
+    color background(const ray& r) const {
+        if (!sky)
             return color(0, 0, 0);
-        }
 
         vec3 unit_direction = unit_vector(r.direction());
-        auto a = 0.5 * (unit_direction.y() + 1.0);
-        return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
+        auto a = (unit_direction.y() + 1) / 2;
+        return (1 - a) * color(1, 1, 1) + a * color(real(0.5), real(0.7), 1);
     }
 
     point3 defocus_disk_sample() const {
         // Returns a random point in the camera defocus disk.
-        auto p = random_in_unit_disk();
+        sampler_seek(sampler_slot::lens);
+        auto p = sample_unit_disk(sample_2d());
         return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
     }
 };
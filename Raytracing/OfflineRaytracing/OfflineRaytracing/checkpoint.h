@@ -0,0 +1,95 @@
+#pragma once
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "binary_cache.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Checkpoint files hold a render's per-pixel accumulation state so a long render can stop and
+// pick up where it left off. The layout is a fixed header followed by the raw accumulator array
+// in row order, in the machine's own byte order:
+//
+//     checkpoint_header   magic, scene and view hash, image size, seed, sampling and path
+//                         settings, sample limit reached, accumulator size
+//     cell[width*height]  one accumulator per pixel
+//
+// A render only resumes from a checkpoint whose header agrees on everything but the sample
+// limit; anything else would add samples of a different image to the old sums.
+
+// Bits of checkpoint_header::path_flags.
+const uint32_t checkpoint_next_event = 1;  // Light sampling with MIS
+const uint32_t checkpoint_sky = 2;         // Gradient sky on a miss
+
+struct checkpoint_header {
+    char     magic[8] = { 'R', 'T', 'C', 'K', 'P', 'T', '0', '2' };
+    uint64_t scene_hash = 0;        // What the scene was built from, and the camera's view
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t seed = 0;
+    uint32_t sampler = 0;           // sampler_type
+    uint32_t samples_per_pixel = 0;
+    uint32_t adaptive_max_spp = 0;
+    uint32_t adaptive_batch = 0;
+    float    noise_threshold = 0;
+    int32_t  max_depth = 0;
+    int32_t  roulette_depth = 0;
+    uint32_t path_flags = 0;        // checkpoint_next_event, checkpoint_sky
+    uint32_t sample_limit = 0;      // Every pixel has at least this many samples, or has converged
+    uint32_t cell_bytes = 0;        // sizeof the accumulator type, so other precision builds are rejected
+    uint32_t reserved = 0;
+
+    bool matches(const checkpoint_header& other) const {
+        // True when other describes the same render, however far along it is. The fields are
+        // laid out without padding, so the headers compare as bytes.
+        checkpoint_header a = *this;
+        checkpoint_header b = other;
+        a.sample_limit = b.sample_limit = 0;
+        return memcmp(&a, &b, sizeof(checkpoint_header)) == 0;
+    }
+};
+
+static_assert(sizeof(checkpoint_header) == 72, "checkpoint_header must not contain padding");
+
+template <typename Cell>
+bool save_checkpoint(const std::string& path, checkpoint_header header, const std::vector<Cell>& cells) {
+    // Replaces the file atomically (see atomic_write_file), so a process killed mid-write still
+    // leaves the previous checkpoint intact.
+    static_assert(std::is_trivially_copyable<Cell>::value, "checkpoint cells are written as raw bytes");
+    header.cell_bytes = sizeof(Cell);
+
+    return atomic_write_file(path, { { &header, sizeof(header) }, { cells.data(), cells.size() * sizeof(Cell) } });
+}
+
+template <typename Cell>
+bool load_checkpoint(const std::string& path, checkpoint_header& expected, std::vector<Cell>& cells) {
+    // Fills cells and expected.sample_limit from the file if its header matches expected (the
+    // scene, view, image size, seed and sampling and path settings) and the accumulator layout
+    // of this build. On any mismatch the outputs are left untouched and false is returned.
+    static_assert(std::is_trivially_copyable<Cell>::value, "checkpoint cells are read as raw bytes");
+    expected.cell_bytes = sizeof(Cell);
+
+    mapped_file in;
+    if (!in.open_read(path) || in.size() < sizeof(checkpoint_header))
+        return false;
+
+    checkpoint_header header;
+    memcpy(&header, in.data(), sizeof(header));
+    size_t count = static_cast<size_t>(header.width) * header.height;
+    if (!expected.matches(header) || in.size() != sizeof(header) + count * sizeof(Cell))
+        return false;
+
+    cells.resize(count);
+    memcpy(cells.data(), in.data() + sizeof(header), count * sizeof(Cell));
+    expected.sample_limit = header.sample_limit;
+    return true;
+}
+
+#endif
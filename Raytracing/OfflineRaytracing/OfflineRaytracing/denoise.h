@@ -0,0 +1,161 @@
+#pragma once
+
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include "image.h"
+#include "tile_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Edge-avoiding a-trous wavelet filtering of a noisy render (Dammertz et al. 2010), with the
+// luminance edge stopping function scaled by each pixel's estimated noise as in SVGF (Schied
+// et al. 2017). Each iteration applies the same 5x5 B3-spline kernel with its taps spread
+// twice as far apart as the last, so five iterations cover a 61-pixel footprint for 125 taps
+// per pixel. Taps are weighted down across edges in the first-hit normal and depth buffers
+// and across luminance differences larger than the local noise explains.
+//
+// The filter runs on illumination: the color divided by the first-hit albedo. Texture and
+// material color in the albedo buffer therefore stay sharp however far the lighting is blurred.
+
+struct aov_buffers {
+    // First-hit features per pixel, averaged over several camera samples.
+    std::vector<float> albedo;  // Three per pixel; the albedo seen through any specular chain
+    std::vector<float> normal;  // Three per pixel; zero where the sky was hit
+    std::vector<float> depth;   // Distance to the first hit, zero for the sky
+};
+
+struct denoise_settings {
+    int   iterations = 5;
+    float sigma_luminance = 4.0f;   // Luminance differences allowed, in local standard deviations
+    float sigma_normal = 2.0f;      // Exponent on the cosine between normals
+    float sigma_depth = 1.0f;       // Depth differences allowed, in units of the local depth slope
+};
+
+inline framebuffer denoise_image(const framebuffer& image, const std::vector<float>& variance, const aov_buffers& aov,
+                                 const denoise_settings& settings, int num_threads) {
+    // Returns the filtered image. variance holds one value per pixel: the variance of that
+    // pixel's mean luminance, which the camera's accumulators estimate from their samples.
+    const int width = image.width;
+    const int height = image.height;
+    const size_t pixels = image.pixel_count();
+    const int tile_size = 32;
+
+    auto luminance = [](const float* c) { return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2]; };
+
+    // Demodulate, carrying the variance through the same division.
+    std::vector<float> color(pixels * 3), next_color(pixels * 3);
+    std::vector<float> var(pixels), next_var(pixels), blurred_var(pixels);
+    for (size_t k = 0; k < pixels; ++k) {
+        for (int c = 0; c < 3; ++c)
+            color[3 * k + c] = image.pixels[3 * k + c] / std::max(aov.albedo[3 * k + c], 1e-3f);
+        float albedo_lum = std::max(luminance(&aov.albedo[3 * k]), 1e-3f);
+        var[k] = variance[k] / (albedo_lum * albedo_lum);
+    }
+
+    // Screen-space depth slope, which sets how much depth change a neighbor may show.
+    std::vector<float> depth_slope(pixels);
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            size_t k = static_cast<size_t>(j) * width + i;
+            float z = aov.depth[k];
+            float dx = std::max(std::fabs(aov.depth[j * width + std::min(i + 1, width - 1)] - z),
+                                std::fabs(z - aov.depth[j * width + std::max(i - 1, 0)]));
+            float dy = std::max(std::fabs(aov.depth[std::min(j + 1, height - 1) * width + i] - z),
+                                std::fabs(z - aov.depth[std::max(j - 1, 0) * width + i]));
+            depth_slope[k] = std::max(dx, dy);
+        }
+    }
+
+    const float kernel[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+    const float gauss[2] = { 1.0f / 2.0f, 1.0f / 4.0f };
+
+    for (int iteration = 0; iteration < settings.iterations; ++iteration) {
+        const int step = 1 << iteration;
+
+        // The luminance test reads a 3x3 blur of the variance, which is itself noisy.
+        run_tiles(width, height, tile_size, num_threads, [&](const tile& t, int) {
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; ++i) {
+                    float sum = 0, weight = 0;
+                    for (int dy = -1; dy <= 1; ++dy) {
+                        for (int dx = -1; dx <= 1; ++dx) {
+                            int x = i + dx, y = j + dy;
+                            if (x < 0 || x >= width || y < 0 || y >= height)
+                                continue;
+                            float w = gauss[std::abs(dx)] * gauss[std::abs(dy)];
+                            sum += w * var[static_cast<size_t>(y) * width + x];
+                            weight += w;
+                        }
+                    }
+                    blurred_var[static_cast<size_t>(j) * width + i] = sum / weight;
+                }
+            }
+        });
+
+        run_tiles(width, height, tile_size, num_threads, [&](const tile& t, int) {
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; ++i) {
+                    size_t p = static_cast<size_t>(j) * width + i;
+                    const float* cp = &color[3 * p];
+                    const float* np = &aov.normal[3 * p];
+                    float lp = luminance(cp);
+                    float zp = aov.depth[p];
+                    bool sky_p = np[0] == 0 && np[1] == 0 && np[2] == 0;
+                    float luminance_scale = settings.sigma_luminance * std::sqrt(blurred_var[p]) + 1e-6f;
+
+                    float sum[3] = { 0, 0, 0 };
+                    float sum_var = 0, weight = 0;
+                    for (int dy = -2; dy <= 2; ++dy) {
+                        for (int dx = -2; dx <= 2; ++dx) {
+                            int x = i + dx * step, y = j + dy * step;
+                            if (x < 0 || x >= width || y < 0 || y >= height)
+                                continue;
+                            size_t q = static_cast<size_t>(y) * width + x;
+                            const float* cq = &color[3 * q];
+                            const float* nq = &aov.normal[3 * q];
+
+                            // Normals: sky only blends with sky, surfaces by the cosine.
+                            bool sky_q = nq[0] == 0 && nq[1] == 0 && nq[2] == 0;
+                            float w_normal;
+                            if (sky_p || sky_q)
+                                w_normal = sky_p == sky_q ? 1.0f : 0.0f;
+                            else
+                                w_normal = std::pow(std::max(0.0f, np[0] * nq[0] + np[1] * nq[1] + np[2] * nq[2]), settings.sigma_normal);
+                            if (w_normal <= 0)
+                                continue;
+
+                            float depth_scale = settings.sigma_depth * depth_slope[p] * step * std::sqrt(float(dx * dx + dy * dy)) + 1e-3f * zp + 1e-6f;
+                            float w_depth = std::exp(-std::fabs(zp - aov.depth[q]) / depth_scale);
+                            float w_lum = std::exp(-std::fabs(lp - luminance(cq)) / luminance_scale);
+
+                            float w = kernel[std::abs(dx)] * kernel[std::abs(dy)] * w_normal * w_depth * w_lum;
+                            for (int c = 0; c < 3; ++c)
+                                sum[c] += w * cq[c];
+                            sum_var += w * w * var[q];
+                            weight += w;
+                        }
+                    }
+
+                    // The center tap always has weight, so the sum is never empty.
+                    for (int c = 0; c < 3; ++c)
+                        next_color[3 * p + c] = sum[c] / weight;
+                    next_var[p] = sum_var / (weight * weight);
+                }
+            }
+        });
+
+        color.swap(next_color);
+        var.swap(next_var);
+    }
+
+    // Put the albedo back.
+    framebuffer result(width, height);
+    for (size_t k = 0; k < pixels * 3; ++k)
+        result.pixels[k] = color[k] * std::max(aov.albedo[k], 1e-3f);
+    return result;
+}
+
+#endif
@@ -3,18 +3,20 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
+#include "aabb.h"
 #include "ray.h"
 #include "interval.h"
 #include "rtweekend.h"
 
-class material;
+const uint32_t no_material = 0xffffffff;
 
 class hit_record {
+    // Plain data, so copying one is a handful of stores.
 public:
     point3 p;
     vec3 normal;
-    shared_ptr<material> mat;
-    double t;
+    uint32_t mat;  // Index into the scene's material_table
+    real t;
     bool front_face;
 
     void set_face_normal(const ray& r, const vec3& outward_normal) {
@@ -32,6 +34,18 @@ public:
     virtual ~hittable() = default;
 
     virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
+
+    virtual aabb bounding_box() const = 0;
+
+    // Light sampling: the solid-angle density of random(origin) generating a direction, and
+    // a random direction from origin towards this object. Only emitters need these.
+    virtual real pdf_value(const point3& /*origin*/, const vec3& /*direction*/) const {
+        return 0;
+    }
+
+    virtual vec3 random(const point3& /*origin*/) const {
+        return vec3(1, 0, 0);
+    }
 };
 
 #endif
@@ -4,6 +4,7 @@
 #define HITTABLE_LIST_H
 
 #include "hittable.h"
+#include "sampler.h"
 
 #include <memory>
 #include <vector>
@@ -18,10 +19,14 @@ public:
     hittable_list() {}
     hittable_list(shared_ptr<hittable> object) { add(object); }
 
-    void clear() { objects.clear(); }
+    void clear() {
+        objects.clear();
+        bbox = aabb();
+    }
 
     void add(shared_ptr<hittable> object) {
         objects.push_back(object);
+        bbox = aabb(bbox, object->bounding_box());
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
@@ -39,6 +44,28 @@ public:
 
         return hit_anything;
     }
+
+    aabb bounding_box() const override { return bbox; }
+
+    real pdf_value(const point3& origin, const vec3& direction) const override {
+        // random() picks one member uniformly, so the density is the average of theirs.
+        if (objects.empty())
+            return 0;
+
+        real sum = 0;
+        for (const auto& object : objects)
+            sum += object->pdf_value(origin, direction);
+        return sum / static_cast<real>(objects.size());
+    }
+
+    vec3 random(const point3& origin) const override {
+        auto count = objects.size();
+        auto index = static_cast<size_t>(sample_1d() * static_cast<real>(count));
+        return objects[index < count ? index : count - 1]->random(origin);
+    }
+
+private:
+    aabb bbox;
 };
 
 #endif
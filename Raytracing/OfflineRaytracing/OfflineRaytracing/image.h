@@ -0,0 +1,326 @@
+#pragma once
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "color.h"
+#include "mapped_file.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RT_IMAGE_SSE2
+#endif
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+class framebuffer {
+    // Linear-light RGB image stored as 32-bit floats, three per pixel, rows top to bottom.
+public:
+    int width = 0;
+    int height = 0;
+    std::vector<float> pixels;
+
+    framebuffer() {}
+    framebuffer(int w, int h) : width(w), height(h), pixels(static_cast<size_t>(w) * h * 3, 0.0f) {}
+
+    size_t pixel_count() const { return static_cast<size_t>(width) * height; }
+
+    void set(int i, int j, const color& c) {
+        float* p = &pixels[(static_cast<size_t>(j) * width + i) * 3];
+        p[0] = static_cast<float>(c.x());
+        p[1] = static_cast<float>(c.y());
+        p[2] = static_cast<float>(c.z());
+    }
+
+    color get(int i, int j) const {
+        const float* p = &pixels[(static_cast<size_t>(j) * width + i) * 3];
+        return color(p[0], p[1], p[2]);
+    }
+};
+
+enum class image_format { ppm, pfm, png16 };
+
+inline image_format image_format_from_path(const std::string& path) {
+    auto ends_with = [&](const char* ext) {
+        size_t n = strlen(ext);
+        if (path.size() < n) return false;
+        for (size_t k = 0; k < n; ++k)
+            if (tolower(static_cast<unsigned char>(path[path.size() - n + k])) != ext[k]) return false;
+        return true;
+    };
+    if (ends_with(".pfm")) return image_format::pfm;
+    if (ends_with(".png")) return image_format::png16;
+    return image_format::ppm;
+}
+
+inline std::vector<float> tonemap(const framebuffer& image, float exposure = 1.0f) {
+    // Scales linear radiance by the exposure, applies the gamma 2 transform and clamps to
+    // [0,1]. This is one pass over the flat float array, four channels at a time with SSE2.
+    size_t n = image.pixels.size();
+    std::vector<float> display(n);
+    const float* src = image.pixels.data();
+    float* dst = display.data();
+    size_t k = 0;
+
+#ifdef RT_IMAGE_SSE2
+    __m128 scale = _mm_set1_ps(exposure);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    for (; k + 4 <= n; k += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(src + k), scale);
+        v = _mm_sqrt_ps(_mm_max_ps(v, zero));
+        _mm_storeu_ps(dst + k, _mm_min_ps(v, one));
+    }
+#endif
+
+    for (; k < n; ++k) {
+        float v = src[k] * exposure;
+        v = v > 0.0f ? static_cast<float>(linear_to_gamma(v)) : 0.0f;
+        dst[k] = v < 1.0f ? v : 1.0f;
+    }
+
+    return display;
+}
+
+// Encoders. Each format reports its exact encoded size up front and then writes into a caller
+// provided buffer, which is either a std::vector or a memory-mapped output file.
+
+inline size_t write_header(uint8_t* dst, const std::string& header) {
+    memcpy(dst, header.data(), header.size());
+    return header.size();
+}
+
+inline std::string ppm_header(const framebuffer& image) {
+    return "P6\n" + std::to_string(image.width) + ' ' + std::to_string(image.height) + "\n255\n";
+}
+
+inline size_t ppm_size(const framebuffer& image) {
+    return ppm_header(image).size() + image.pixel_count() * 3;
+}
+
+inline void encode_ppm(const framebuffer& image, const std::vector<float>& display, uint8_t* dst) {
+    dst += write_header(dst, ppm_header(image));
+    for (size_t k = 0; k < display.size(); ++k) {
+        // Same quantization as the old P3 path: [0,1) maps onto 256 equal buckets.
+        float v = display[k] < 0.999f ? display[k] : 0.999f;
+        dst[k] = static_cast<uint8_t>(256 * v);
+    }
+}
+
+inline std::string pfm_header(const framebuffer& image) {
+    // A negative scale marks the samples as little-endian.
+    return "PF\n" + std::to_string(image.width) + ' ' + std::to_string(image.height) + "\n-1.0\n";
+}
+
+inline size_t pfm_size(const framebuffer& image) {
+    return pfm_header(image).size() + image.pixel_count() * 3 * sizeof(float);
+}
+
+inline void encode_pfm(const framebuffer& image, uint8_t* dst) {
+    // PFM stores untouched linear values with rows from bottom to top.
+    dst += write_header(dst, pfm_header(image));
+    size_t row_bytes = static_cast<size_t>(image.width) * 3 * sizeof(float);
+    for (int j = image.height - 1; j >= 0; --j) {
+        const float* row = &image.pixels[static_cast<size_t>(j) * image.width * 3];
+        for (size_t k = 0; k < static_cast<size_t>(image.width) * 3; ++k) {
+            uint32_t bits;
+            memcpy(&bits, &row[k], 4);
+            dst[4 * k + 0] = static_cast<uint8_t>(bits);
+            dst[4 * k + 1] = static_cast<uint8_t>(bits >> 8);
+            dst[4 * k + 2] = static_cast<uint8_t>(bits >> 16);
+            dst[4 * k + 3] = static_cast<uint8_t>(bits >> 24);
+        }
+        dst += row_bytes;
+    }
+}
+
+inline uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t n) {
+    static const auto table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t k = 0; k < 256; ++k) {
+            uint32_t c = k;
+            for (int b = 0; b < 8; ++b)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[k] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t k = 0; k < n; ++k)
+        crc = table[(crc ^ data[k]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline void put_be32(uint8_t* dst, uint32_t v) {
+    dst[0] = static_cast<uint8_t>(v >> 24);
+    dst[1] = static_cast<uint8_t>(v >> 16);
+    dst[2] = static_cast<uint8_t>(v >> 8);
+    dst[3] = static_cast<uint8_t>(v);
+}
+
+const size_t png_max_stored_block = 65535;
+
+inline size_t png_raw_size(const framebuffer& image) {
+    // One filter byte per row followed by 16-bit RGB samples.
+    return static_cast<size_t>(image.height) * (1 + static_cast<size_t>(image.width) * 6);
+}
+
+inline size_t png_idat_size(const framebuffer& image) {
+    // zlib header, stored deflate blocks with a 5 byte header each, Adler-32 trailer.
+    size_t raw = png_raw_size(image);
+    size_t blocks = raw == 0 ? 1 : (raw + png_max_stored_block - 1) / png_max_stored_block;
+    return 2 + raw + 5 * blocks + 4;
+}
+
+inline size_t png_size(const framebuffer& image) {
+    return 8 + (12 + 13) + (12 + png_idat_size(image)) + 12;
+}
+
+inline void encode_png16(const framebuffer& image, const std::vector<float>& display, uint8_t* dst) {
+    // 16-bit RGB PNG. The pixel data is wrapped in uncompressed (stored) deflate blocks, so
+    // encoding is a single linear pass with no compressor in the loop.
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    memcpy(dst, signature, 8);
+    dst += 8;
+
+    auto chunk = [&](const char* type, size_t length, auto&& fill) {
+        put_be32(dst, static_cast<uint32_t>(length));
+        memcpy(dst + 4, type, 4);
+        fill(dst + 8);
+        put_be32(dst + 8 + length, crc32_update(0, dst + 4, length + 4));
+        dst += 12 + length;
+    };
+
+    chunk("IHDR", 13, [&](uint8_t* p) {
+        put_be32(p, static_cast<uint32_t>(image.width));
+        put_be32(p + 4, static_cast<uint32_t>(image.height));
+        p[8] = 16;  // Bit depth
+        p[9] = 2;   // Color type: RGB
+        p[10] = 0;  // Deflate
+        p[11] = 0;  // Adaptive filtering
+        p[12] = 0;  // No interlace
+    });
+
+    chunk("IDAT", png_idat_size(image), [&](uint8_t* p) {
+        *p++ = 0x78;
+        *p++ = 0x01;
+
+        size_t raw_total = png_raw_size(image);
+        size_t row_bytes = 1 + static_cast<size_t>(image.width) * 6;
+        size_t produced = 0;
+        size_t block_left = 0;
+        uint32_t a = 1, b = 0;
+        size_t since_mod = 0;
+
+        auto put = [&](uint8_t byte) {
+            if (block_left == 0) {
+                size_t len = raw_total - produced < png_max_stored_block ? raw_total - produced : png_max_stored_block;
+                *p++ = (produced + len == raw_total) ? 1 : 0;
+                *p++ = static_cast<uint8_t>(len);
+                *p++ = static_cast<uint8_t>(len >> 8);
+                *p++ = static_cast<uint8_t>(~len);
+                *p++ = static_cast<uint8_t>(~len >> 8);
+                block_left = len;
+            }
+            *p++ = byte;
+            --block_left;
+            ++produced;
+            // Adler-32, reducing modulo 65521 only as often as the sums could overflow.
+            a += byte;
+            b += a;
+            if (++since_mod == 5552) {
+                a %= 65521;
+                b %= 65521;
+                since_mod = 0;
+            }
+        };
+
+        if (raw_total == 0) {
+            *p++ = 1;
+            *p++ = 0; *p++ = 0; *p++ = 0xff; *p++ = 0xff;
+        }
+
+        for (int j = 0; j < image.height; ++j) {
+            put(0);
+            const float* row = &display[static_cast<size_t>(j) * image.width * 3];
+            for (size_t k = 0; k + 1 < row_bytes; k += 2) {
+                auto v = static_cast<uint16_t>(row[k / 2] * 65535.0f + 0.5f);
+                put(static_cast<uint8_t>(v >> 8));
+                put(static_cast<uint8_t>(v));
+            }
+        }
+
+        put_be32(p, ((b % 65521) << 16) | (a % 65521));
+    });
+
+    chunk("IEND", 0, [](uint8_t*) {});
+}
+
+inline bool write_image(const std::string& path, const framebuffer& image, bool use_mmap = false, float exposure = 1.0f) {
+    // Encodes the image in the format implied by the path's extension and writes it in a single
+    // write, or straight into a memory-mapped file. An empty path writes a binary PPM to stdout.
+    auto format = path.empty() ? image_format::ppm : image_format_from_path(path);
+
+    std::vector<float> display;
+    if (format != image_format::pfm)
+        display = tonemap(image, exposure);
+
+    size_t size = format == image_format::pfm ? pfm_size(image)
+                : format == image_format::png16 ? png_size(image)
+                : ppm_size(image);
+
+    auto encode = [&](uint8_t* dst) {
+        switch (format) {
+        case image_format::pfm:   encode_pfm(image, dst); break;
+        case image_format::png16: encode_png16(image, display, dst); break;
+        default:                  encode_ppm(image, display, dst); break;
+        }
+    };
+
+    if (use_mmap && !path.empty()) {
+        mapped_file out;
+        if (!out.create(path, size))
+            return false;
+        encode(out.data());
+        return true;
+    }
+
+    std::vector<uint8_t> bytes(size);
+    encode(bytes.data());
+
+    FILE* out = stdout;
+    if (!path.empty()) {
+#ifdef _WIN32
+        if (fopen_s(&out, path.c_str(), "wb") != 0)
+            out = nullptr;
+#else
+        out = fopen(path.c_str(), "wb");
+#endif
+        if (!out)
+            return false;
+    }
+#ifdef _WIN32
+    else {
+        _setmode(_fileno(stdout), _O_BINARY);
+    }
+#endif
+
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+    if (out == stdout)
+        ok = fflush(out) == 0 && ok;
+    else
+        ok = fclose(out) == 0 && ok;
+    return ok;
+}
+
+#endif
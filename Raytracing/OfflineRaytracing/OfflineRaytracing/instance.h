@@ -0,0 +1,167 @@
+#pragma once
+
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "hittable.h"
+
+class affine {
+    // A 3x4 affine transform, the same layout as the Transform field of a DXR instance
+    // description: the left 3x3 block is the linear part and the last column the translation.
+public:
+    real m[3][4];
+
+    affine() : m{ {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0} } {}
+
+    static affine translate(const vec3& offset) {
+        affine a;
+        for (int r = 0; r < 3; ++r)
+            a.m[r][3] = offset[r];
+        return a;
+    }
+
+    static affine scale(real s) {
+        affine a;
+        for (int r = 0; r < 3; ++r)
+            a.m[r][r] = s;
+        return a;
+    }
+
+    static affine rotate_y(real degrees) {
+        auto radians = degrees_to_radians(degrees);
+        auto c = std::cos(radians);
+        auto s = std::sin(radians);
+
+        affine a;
+        a.m[0][0] = c;  a.m[0][2] = s;
+        a.m[2][0] = -s; a.m[2][2] = c;
+        return a;
+    }
+
+    point3 apply_point(const point3& p) const {
+        return point3(m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3],
+                      m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3],
+                      m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3]);
+    }
+
+    vec3 apply_vector(const vec3& v) const {
+        return vec3(m[0][0] * v[0] + m[0][1] * v[1] + m[0][2] * v[2],
+                    m[1][0] * v[0] + m[1][1] * v[1] + m[1][2] * v[2],
+                    m[2][0] * v[0] + m[2][1] * v[1] + m[2][2] * v[2]);
+    }
+
+    vec3 apply_transposed(const vec3& v) const {
+        // Transposed linear part, which is how normals go back through an inverse transform.
+        return vec3(m[0][0] * v[0] + m[1][0] * v[1] + m[2][0] * v[2],
+                    m[0][1] * v[0] + m[1][1] * v[1] + m[2][1] * v[2],
+                    m[0][2] * v[0] + m[1][2] * v[1] + m[2][2] * v[2]);
+    }
+
+    real determinant() const {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+             - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+             + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    bool invertible() const {
+        // False for a singular or near-singular linear part (say a zero scale), whose inverse
+        // would be inf or NaN. Measured against the largest entry cubed, so a uniformly tiny
+        // but well-shaped transform still passes.
+        real largest = 0;
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c)
+                largest = std::fmax(largest, std::fabs(m[r][c]));
+        auto det = std::fabs(determinant());
+        return std::isfinite(det) && det > 0 && det > 1e-9 * largest * largest * largest;
+    }
+
+    affine inverse() const {
+        // Inverts the 3x3 block by cofactors, then moves the translation through it. Only
+        // meaningful when invertible().
+        affine inv;
+        auto inv_det = 1 / determinant();
+
+        inv.m[0][0] =  (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv_det;
+        inv.m[0][1] = -(m[0][1] * m[2][2] - m[0][2] * m[2][1]) * inv_det;
+        inv.m[0][2] =  (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+        inv.m[1][0] = -(m[1][0] * m[2][2] - m[1][2] * m[2][0]) * inv_det;
+        inv.m[1][1] =  (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+        inv.m[1][2] = -(m[0][0] * m[1][2] - m[0][2] * m[1][0]) * inv_det;
+        inv.m[2][0] =  (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv_det;
+        inv.m[2][1] = -(m[0][0] * m[2][1] - m[0][1] * m[2][0]) * inv_det;
+        inv.m[2][2] =  (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+
+        auto t = inv.apply_vector(vec3(m[0][3], m[1][3], m[2][3]));
+        for (int r = 0; r < 3; ++r)
+            inv.m[r][3] = -t[r];
+        return inv;
+    }
+};
+
+inline affine operator*(const affine& a, const affine& b) {
+    // a * b applies b first, then a.
+    affine out;
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 4; ++c) {
+            out.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c];
+        }
+        out.m[r][3] += a.m[r][3];
+    }
+    return out;
+}
+
+class instance : public hittable {
+    // One placement of a shared bottom-level object (a triangle_mesh or any BVH'd hittable).
+    // Many instances can point at the same object, so repeats cost a transform pair and a
+    // pointer instead of a copy of the geometry. A top-level bvh_node over the instances plays
+    // the role of the TLAS and each shared object's own BVH the role of a BLAS.
+    //
+    // Rays are moved into object space without renormalizing the direction, so the object
+    // reports hit distances in the same t units as the world ray. The optional material
+    // replaces the object's own, like the per-instance color in the DXR path. The transform
+    // must be invertible(); the scene loader refuses ones that are not.
+public:
+    instance(shared_ptr<hittable> object, const affine& object_to_world, uint32_t mat = no_material)
+        : object(object), to_world(object_to_world), to_object(object_to_world.inverse()), mat(mat)
+    {
+        // World bounds enclose the eight transformed corners of the object's box.
+        aabb local = object->bounding_box();
+        for (int k = 0; k < 8; ++k) {
+            point3 corner((k & 1) ? local.x.max : local.x.min,
+                          (k & 2) ? local.y.max : local.y.min,
+                          (k & 4) ? local.z.max : local.z.min);
+            auto p = to_world.apply_point(corner);
+            bbox = aabb(bbox, aabb(p, p));
+        }
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        ray local(to_object.apply_point(r.origin()), to_object.apply_vector(r.direction()));
+
+        if (!object->hit(local, ray_t, rec))
+            return false;
+
+        // The object already oriented its normal against the local ray, and the inverse
+        // transpose keeps that orientation, so front_face carries over unchanged.
+        rec.p = r.at(rec.t);
+        rec.normal = unit_vector(to_object.apply_transposed(rec.normal));
+        if (mat != no_material)
+            rec.mat = mat;
+
+        return true;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    shared_ptr<hittable> object;
+    affine to_world;
+    affine to_object;
+    uint32_t mat;
+    aabb bbox;
+};
+
+#endif
@@ -5,21 +5,33 @@
 
 class interval {
 public:
-    double min, max;
+    real min, max;
 
     interval() : min(+infinity), max(-infinity) {} // Default interval is empty
 
-    interval(double _min, double _max) : min(_min), max(_max) {}
+    interval(real _min, real _max) : min(_min), max(_max) {}
 
-    bool contains(double x) const {
+    interval(const interval& a, const interval& b)
+        : min(std::fmin(a.min, b.min)), max(std::fmax(a.max, b.max)) {} // Tightly encloses both intervals
+
+    real size() const {
+        return max - min;
+    }
+
+    interval expand(real delta) const {
+        auto padding = delta / 2;
+        return interval(min - padding, max + padding);
+    }
+
+    bool contains(real x) const {
         return min <= x && x <= max;
     }
 
-    bool surrounds(double x) const {
+    bool surrounds(real x) const {
         return min < x && x < max;
     }
 
-    double clamp(double x) const {
+    real clamp(real x) const {
         if (x < min) return min;
         if (x > max) return max;
         return x;
@@ -1,69 +1,222 @@
 #include "rtweekend.h"
+#include "benchmark.h"
 #include "camera.h"
-#include "color.h"
-#include "hittable_list.h"
-#include "material.h"
-#include "sphere.h"
+#include "scene_file.h"
+#include "scenes.h"
 
-int main() {
-    hittable_list world;
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
 
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+static bool parse_sampler(const char* name, sampler_type& type) {
+    if (strcmp(name, "independent") == 0)
+        type = sampler_type::independent;
+    else if (strcmp(name, "sobol") == 0)
+        type = sampler_type::sobol;
+    else if (strcmp(name, "bluenoise") == 0)
+        type = sampler_type::blue_noise;
+    else
+        return false;
+    return true;
+}
 
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+int main(int argc, char* argv[]) {
+    int num_threads = 0;
+    bool bench_rng = false;
+    bool bench_hit = false;
+    bool bench_convergence = false;
+    bool bench_wavefront = false;
+    std::string output_path;
+    bool use_mmap = false;
+    bool roulette = true;
+    bool night = false;
+    bool next_event = true;
+    bool wavefront = false;
+    sampler_type sampler = sampler_type::independent;
+    int adaptive_max_spp = 0;
+    double noise_threshold = 0.01;
+    std::string obj_path;
+    int instance_count = 0;
+    int pass_samples = 0;
+    std::string checkpoint_path;
+    bool resume = false;
+    bool bvh_cache = true;
+    bool denoise = false;
+    std::string scene_name = "final";
+    std::vector<std::string> bench_scenes;
 
-            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.8) {
-                    // diffuse
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else if (choose_mat < 0.95) {
-                    // metal
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else {
-                    // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-            }
+    for (int k = 1; k < argc; ++k) {
+        if (strcmp(argv[k], "--threads") == 0 && k + 1 < argc) {
+            num_threads = atoi(argv[++k]);
+        }
+        else if (strcmp(argv[k], "--output") == 0 && k + 1 < argc) {
+            output_path = argv[++k];
+        }
+        else if (strcmp(argv[k], "--mmap") == 0) {
+            use_mmap = true;
+        }
+        else if (strcmp(argv[k], "--adaptive") == 0 && k + 1 < argc) {
+            adaptive_max_spp = atoi(argv[++k]);
+        }
+        else if (strcmp(argv[k], "--noise-threshold") == 0 && k + 1 < argc) {
+            noise_threshold = atof(argv[++k]);
+        }
+        else if (strcmp(argv[k], "--scene") == 0 && k + 1 < argc) {
+            scene_name = argv[++k];
+        }
+        else if (strcmp(argv[k], "--no-bvh-cache") == 0) {
+            bvh_cache = false;
+        }
+        else if (strcmp(argv[k], "--obj") == 0 && k + 1 < argc) {
+            obj_path = argv[++k];
+        }
+        else if (strcmp(argv[k], "--instances") == 0 && k + 1 < argc) {
+            instance_count = atoi(argv[++k]);
+        }
+        else if (strcmp(argv[k], "--pass-samples") == 0 && k + 1 < argc) {
+            pass_samples = atoi(argv[++k]);
+        }
+        else if (strcmp(argv[k], "--checkpoint") == 0 && k + 1 < argc) {
+            checkpoint_path = argv[++k];
+        }
+        else if (strcmp(argv[k], "--resume") == 0) {
+            resume = true;
+        }
+        else if (strcmp(argv[k], "--lights") == 0) {
+            night = true;
+        }
+        else if (strcmp(argv[k], "--no-nee") == 0) {
+            next_event = false;
+        }
+        else if (strcmp(argv[k], "--wavefront") == 0) {
+            wavefront = true;
+        }
+        else if (strcmp(argv[k], "--sampler") == 0 && k + 1 < argc && parse_sampler(argv[k + 1], sampler)) {
+            ++k;
+        }
+        else if (strcmp(argv[k], "--denoise") == 0) {
+            denoise = true;
+        }
+        else if (strcmp(argv[k], "--no-roulette") == 0) {
+            roulette = false;
+        }
+        else if (strcmp(argv[k], "--bench-rng") == 0) {
+            bench_rng = true;
+        }
+        else if (strcmp(argv[k], "--bench-hit") == 0) {
+            bench_hit = true;
+        }
+        else if (strcmp(argv[k], "--bench-convergence") == 0) {
+            bench_convergence = true;
+        }
+        else if (strcmp(argv[k], "--bench-wavefront") == 0) {
+            bench_wavefront = true;
+        }
+        else if (strcmp(argv[k], "--bench") == 0 && k + 1 < argc) {
+            std::string name = argv[++k];
+            if (name == "all")
+                bench_scenes.assign(std::begin(scene_names), std::end(scene_names));
+            else
+                bench_scenes.push_back(name);
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [options]\n"
+                      << "  --threads N            Worker threads (default: all hardware threads)\n"
+                      << "  --output FILE          Write .ppm, .pfm or .png instead of a PPM on stdout\n"
+                      << "  --mmap                 Encode the output straight into a mapped file\n"
+                      << "  --adaptive MAX_SPP     Keep sampling noisy pixels up to MAX_SPP\n"
+                      << "  --noise-threshold T    Adaptive convergence threshold (default 0.01)\n"
+                      << "  --scene NAME|FILE      final (default), spheres100k, mesh, glass or a .scene file\n"
+                      << "  --no-bvh-cache         Build a scene file's BVHs without reading or writing FILE.bvh\n"
+                      << "  --obj FILE             OBJ mesh for the final scene's center object and the mesh scene\n"
+                      << "  --instances N          Scatter N more instances of the --obj mesh\n"
+                      << "  --pass-samples N       Render progressively, adding N samples per pixel per pass\n"
+                      << "  --checkpoint FILE      Save the accumulation buffer to FILE after every pass\n"
+                      << "  --resume               Continue from the --checkpoint file if it matches\n"
+                      << "  --lights               Light the scene with small area lights instead of the sky\n"
+                      << "  --no-nee               Disable light sampling (BSDF sampling only)\n"
+                      << "  --wavefront            Trace tiles breadth first as sorted ray streams\n"
+                      << "  --sampler NAME         independent (default), sobol or bluenoise\n"
+                      << "  --denoise              Filter the final image with the edge-aware a-trous denoiser\n"
+                      << "  --no-roulette          Disable Russian roulette path termination\n"
+                      << "  --bench-rng            Benchmark random number generators\n"
+                      << "  --bench-hit            Benchmark sphere intersection kernels\n"
+                      << "  --bench-convergence    Compare sampler error against a reference at fixed time budgets\n"
+                      << "  --bench-wavefront      Compare depth-first and wavefront tracing: time, nodes per ray, cache misses\n"
+                      << "  --bench SCENE          Render SCENE (or all) at a fixed size and seed and print JSON stats;\n"
+                      << "                         repeatable, run one scene per process for its own peak RSS\n";
+            return 1;
         }
     }
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+    if (bench_rng) {
+        benchmark_rng(std::cout, num_threads);
+        return 0;
+    }
+
+    scene_options options;
+    options.obj_path = obj_path;
+    options.instance_count = instance_count;
+    options.night = night;
+    options.bvh_cache = bvh_cache;
 
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+    // Render settings from the command line, applied on top of the scene's own camera.
+    auto configure = [&](camera& cam) {
+        cam.num_threads = num_threads;
+        cam.output_path = output_path;
+        cam.use_mmap = use_mmap;
+        if (!roulette)
+            cam.roulette_depth = -1;
+        cam.next_event = next_event;
+        cam.wavefront = wavefront;
+        cam.sampler = sampler;
+        if (adaptive_max_spp > 0)
+            cam.adaptive_max_spp = adaptive_max_spp;
+        cam.noise_threshold = static_cast<real>(noise_threshold);
+        cam.pass_samples = pass_samples;
+        cam.checkpoint_path = checkpoint_path;
+        cam.resume = resume;
+        cam.denoise = denoise;
+    };
+
+    if (!bench_scenes.empty()) {
+        // One JSON array with an object per scene on stdout; progress stays on stderr.
+        std::cout << "[\n";
+        for (size_t k = 0; k < bench_scenes.size(); ++k) {
+            scene s;
+            if (!load_scene(bench_scenes[k], options, s))
+                return 1;
+            configure(s.cam);
+            benchmark_scene(std::cout, bench_scenes[k], s);
+            std::cout << (k + 1 < bench_scenes.size() ? ",\n" : "\n");
+        }
+        std::cout << "]\n";
+        return 0;
+    }
 
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+    scene s;
+    if (!load_scene(scene_name, options, s))
+        return 1;
+    configure(s.cam);
 
-    camera cam;
+    if (bench_hit) {
+        benchmark_intersection(std::cout, s.objects, s.cam.lookfrom, s.cam.lookat);
+        return 0;
+    }
 
-    cam.aspect_ratio = 16.0 / 9.0;
-    cam.image_width = 1200;
-    cam.samples_per_pixel = 10;
-    cam.max_depth = 50;
+    if (bench_convergence) {
+        benchmark_convergence(std::cout, s.cam, *s.bvh, s.materials, s.lights);
+        return 0;
+    }
 
-    cam.vfov = 20;
-    cam.lookfrom = point3(13, 2, 3);
-    cam.lookat = point3(0, 0, 0);
-    cam.vup = vec3(0, 1, 0);
+    if (bench_wavefront) {
+        benchmark_wavefront(std::cout, s);
+        return 0;
+    }
 
-    cam.defocus_angle = 0.6;
-    cam.focus_dist = 10.0;
+    s.cam.render(*s.bvh, s.materials, s.lights);
 
-    cam.render(world);
+    std::clog << s.cam.last_render_stats() << '\n';
 }
\ No newline at end of file
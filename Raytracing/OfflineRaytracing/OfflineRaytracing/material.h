@@ -5,90 +5,145 @@
 
 #include "rtweekend.h"
 #include "color.h"
+#include "hittable.h"
+#include "sampler.h"
 
-class hit_record;
+#include <vector>
 
-class material {
-public:
-    virtual ~material() = default;
+// Materials are plain values kept in one material_table and referred to by index, so a hit
+// record carries a 32-bit id instead of a reference-counted pointer, and shading dispatches
+// with a switch on the material's type instead of a virtual call.
 
-    virtual bool scatter(
-        const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const = 0;
+enum class material_type : uint32_t {
+    lambertian,
+    metal,
+    dielectric,
+    diffuse_light,
 };
 
-class lambertian : public material {
-public:
-    lambertian(const color& a) : albedo(a) {}
-
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-        const override {
-        auto scatter_direction = rec.normal + random_unit_vector();
-
-        // Catch degenerate scatter direction
-        if (scatter_direction.near_zero())
-            scatter_direction = rec.normal;
+struct material {
+    material_type type;
+    color albedo;  // Lambertian and metal reflectance
+    real  fuzz;    // Metal reflection blur
+    real  ir;      // Dielectric index of refraction
+    color emit;    // Radiance of a diffuse light
+
+    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
+        switch (type) {
+        case material_type::lambertian: {
+            auto scatter_direction = rec.normal + sample_unit_vector(sample_2d());
+
+            // Catch degenerate scatter direction
+            if (scatter_direction.near_zero())
+                scatter_direction = rec.normal;
+
+            scattered = ray(rec.p, scatter_direction);
+            attenuation = albedo;
+            return true;
+        }
+        case material_type::metal: {
+            vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
+            scattered = ray(rec.p, reflected + fuzz * sample_unit_vector(sample_2d()));
+            attenuation = albedo;
+            return (dot(scattered.direction(), rec.normal) > 0);
+        }
+        case material_type::dielectric: {
+            attenuation = color(1, 1, 1);
+            real refraction_ratio = rec.front_face ? (1 / ir) : ir;
+
+            vec3 unit_direction = unit_vector(r_in.direction());
+            real cos_theta = std::fmin(dot(-unit_direction, rec.normal), real(1));
+            real sin_theta = sqrt(1 - cos_theta * cos_theta);
+
+            bool cannot_refract = refraction_ratio * sin_theta > 1.0;
+            vec3 direction;
+
+            if (cannot_refract || reflectance(cos_theta, refraction_ratio) > sample_1d())
+                direction = reflect(unit_direction, rec.normal);
+            else
+                direction = refract(unit_direction, rec.normal, refraction_ratio);
+
+            scattered = ray(rec.p, direction);
+            return true;
+        }
+        default:
+            // Lights absorb everything that reaches them.
+            return false;
+        }
+    }
 
-        scattered = ray(rec.p, scatter_direction);
-        attenuation = albedo;
-        return true;
+    color emitted(const ray& /*r_in*/, const hit_record& rec) const {
+        // Diffuse lights emit from the front of the surface only.
+        if (type == material_type::diffuse_light && rec.front_face)
+            return emit;
+        return color(0, 0, 0);
     }
 
-private:
-    color albedo;
-};
+    real scattering_pdf(const ray& /*r_in*/, const hit_record& rec, const ray& scattered) const {
+        // Solid-angle density of scatter() producing this direction. Zero marks a specular
+        // material, which light sampling cannot help and skips.
+        if (type != material_type::lambertian)
+            return 0;
 
-class metal : public material {
-public:
-    metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
-
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-        const override {
-        vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
-        scattered = ray(rec.p, reflected + fuzz * random_unit_vector());
-        attenuation = albedo;
-        return (dot(scattered.direction(), rec.normal) > 0);
+        // scatter() is cosine weighted, so its density is also the BRDF times the cosine over
+        // the albedo: albedo * scattering_pdf is the reflected fraction for any direction.
+        auto cos_theta = dot(rec.normal, unit_vector(scattered.direction()));
+        return cos_theta < 0 ? 0 : cos_theta / pi;
     }
 
 private:
-    color albedo;
-    double fuzz;
+    static real reflectance(real cosine, real ref_idx) {
+        // Use Schlick's approximation for reflectance.
+        auto r0 = (1 - ref_idx) / (1 + ref_idx);
+        r0 = r0 * r0;
+        return r0 + (1 - r0) * std::pow((1 - cosine), real(5));
+    }
 };
 
-class dielectric : public material {
+inline material lambertian(const color& a) {
+    material m{};
+    m.type = material_type::lambertian;
+    m.albedo = a;
+    return m;
+}
+
+inline material metal(const color& a, real f) {
+    material m{};
+    m.type = material_type::metal;
+    m.albedo = a;
+    m.fuzz = f < 1 ? f : 1;
+    return m;
+}
+
+inline material dielectric(real index_of_refraction) {
+    material m{};
+    m.type = material_type::dielectric;
+    m.ir = index_of_refraction;
+    return m;
+}
+
+inline material diffuse_light(const color& c) {
+    material m{};
+    m.type = material_type::diffuse_light;
+    m.emit = c;
+    return m;
+}
+
+class material_table {
+    // Every material in the scene, stored by value. Ids are indices and stay valid as the
+    // table grows.
 public:
-    dielectric(double index_of_refraction) : ir(index_of_refraction) {}
-
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-        const override {
-        attenuation = color(1.0, 1.0, 1.0);
-        double refraction_ratio = rec.front_face ? (1.0 / ir) : ir;
-
-        vec3 unit_direction = unit_vector(r_in.direction());
-        double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
-        double sin_theta = sqrt(1.0 - cos_theta * cos_theta);
-
-        bool cannot_refract = refraction_ratio * sin_theta > 1.0;
-        vec3 direction;
+    uint32_t add(const material& m) {
+        entries.push_back(m);
+        return static_cast<uint32_t>(entries.size() - 1);
+    }
 
-        if (cannot_refract || reflectance(cos_theta, refraction_ratio) > random_double())
-            direction = reflect(unit_direction, rec.normal);
-        else
-            direction = refract(unit_direction, rec.normal, refraction_ratio);
+    const material& operator[](uint32_t id) const { return entries[id]; }
 
-        scattered = ray(rec.p, direction);
-        return true;
-    }
+    size_t size() const { return entries.size(); }
 
 private:
-    double ir; // Index of Refraction
-
-    static double reflectance(double cosine, double ref_idx) {
-        // Use Schlick's approximation for reflectance.
-        auto r0 = (1 - ref_idx) / (1 + ref_idx);
-        r0 = r0 * r0;
-        return r0 + (1 - r0) * pow((1 - cosine), 5);
-    }
+    std::vector<material> entries;
 };
 
-
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef ONB_H
+#define ONB_H
+
+#include "rtweekend.h"
+#include "sampler.h"
+
+class onb {
+    // Orthonormal basis whose w axis points along a given direction.
+public:
+    onb(const vec3& n) {
+        axis[2] = unit_vector(n);
+        vec3 a = (std::fabs(axis[2].x()) > real(0.9)) ? vec3(0, 1, 0) : vec3(1, 0, 0);
+        axis[1] = unit_vector(cross(axis[2], a));
+        axis[0] = cross(axis[2], axis[1]);
+    }
+
+    const vec3& u() const { return axis[0]; }
+    const vec3& v() const { return axis[1]; }
+    const vec3& w() const { return axis[2]; }
+
+    vec3 local(const vec3& a) const {
+        // Converts coordinates in this basis to world space.
+        return (a[0] * axis[0]) + (a[1] * axis[1]) + (a[2] * axis[2]);
+    }
+
+private:
+    vec3 axis[3];
+};
+
+inline vec3 random_to_sphere(real radius, real distance_squared) {
+    // A direction around +z, uniform over the cone subtended by a sphere of the given radius
+    // whose center is distance_squared away along +z.
+    auto s = sample_2d();
+    auto r1 = s.u;
+    auto r2 = s.v;
+    auto z = 1 + r2 * (std::sqrt(1 - radius * radius / distance_squared) - 1);
+
+    auto phi = 2 * pi * r1;
+    auto x = std::cos(phi) * std::sqrt(1 - z * z);
+    auto y = std::sin(phi) * std::sqrt(1 - z * z);
+
+    return vec3(x, y, z);
+}
+
+#endif
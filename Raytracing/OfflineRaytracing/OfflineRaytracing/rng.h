@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// Pseudo-random generators for the renderer. Each thread owns one generator, and the camera
+// reseeds it from (seed, pixel, sample) before every camera sample, so a sample's random sequence
+// depends only on where it is in the image. Define RT_RNG_XOSHIRO to switch to xoshiro256+.
+
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+class pcg32 {
+    // PCG-XSH-RR with 64-bit state: one multiply-add per draw and 2^63 selectable streams.
+public:
+    pcg32() { seed(0x853c49e6748fea9bull, 0xda3e39cb94b95bdbull); }
+
+    void seed(uint64_t initstate, uint64_t stream) {
+        state = 0;
+        inc = (stream << 1u) | 1u;
+        next_u32();
+        state += initstate;
+        next_u32();
+    }
+
+    uint32_t next_u32() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ull + inc;
+        uint32_t xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = static_cast<uint32_t>(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+    }
+
+    double next_double() {
+        // 32 random mantissa bits are plenty for sample positions and scatter decisions.
+        return next_u32() * (1.0 / 4294967296.0);
+    }
+
+    float next_float() {
+        // Only 24 bits survive in a float, and more could round up to exactly 1.
+        return (next_u32() >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+class xoshiro256plus {
+    // xoshiro256+ (Blackman & Vigna): four words of state, the high 53 bits feed doubles.
+public:
+    xoshiro256plus() { seed(0, 0); }
+
+    void seed(uint64_t initstate, uint64_t stream) {
+        uint64_t sm = initstate ^ (stream * 0xd1342543de82ef95ull);
+        for (auto& word : s)
+            word = splitmix64(sm);
+    }
+
+    uint64_t next_u64() {
+        uint64_t result = s[0] + s[3];
+        uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = (s[3] << 45) | (s[3] >> 19);
+
+        return result;
+    }
+
+    double next_double() {
+        return (next_u64() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    float next_float() {
+        return static_cast<float>(next_u64() >> 40) * (1.0f / 16777216.0f);
+    }
+
+private:
+    uint64_t s[4];
+};
+
+#if defined(RT_RNG_XOSHIRO)
+using rng_engine = xoshiro256plus;
+#else
+using rng_engine = pcg32;
+#endif
+
+inline rng_engine& thread_rng() {
+    thread_local rng_engine engine;
+    return engine;
+}
+
+inline void seed_sample(uint32_t base_seed, uint32_t pixel_index, uint32_t sample_index) {
+    // Gives each (pixel, sample) pair its own decorrelated sequence: the pixel picks the stream
+    // and the base seed and sample index are hashed into the starting state.
+    uint64_t key = (static_cast<uint64_t>(base_seed) << 32) | sample_index;
+    thread_rng().seed(splitmix64(key), pixel_index);
+}
+
+#endif
@@ -6,8 +6,20 @@
 #include <cmath>
 #include <limits>
 #include <memory>
-#include <cstdlib>
+#include <cstdint>
 
+#include "rng.h"
+
+
+// Precision
+
+// Geometry and shading use `real`. Define RT_USE_FLOAT to build the whole renderer in single
+// precision, which halves the size of vectors, rays and BVH nodes.
+#if defined(RT_USE_FLOAT)
+using real = float;
+#else
+using real = double;
+#endif
 
 // Usings
 
@@ -17,25 +29,35 @@ using std::sqrt;
 
 // Constants
 
-const double infinity = std::numeric_limits<double>::infinity();
-const double pi = 3.1415926535897932385;
+const real infinity = std::numeric_limits<real>::infinity();
+const real pi = static_cast<real>(3.1415926535897932385);
 
 // Utility Functions
 
-inline double degrees_to_radians(double degrees) {
-    return degrees * pi / 180.0;
+inline real degrees_to_radians(real degrees) {
+    return degrees * pi / 180;
 }
 
-inline double random_double() {
-    // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+inline real random_double() {
+    // Returns a random real in [0,1) from this thread's generator.
+#if defined(RT_USE_FLOAT)
+    return thread_rng().next_float();
+#else
+    return thread_rng().next_double();
+#endif
 }
 
-inline double random_double(double min, double max) {
+inline real random_double(real min, real max) {
     // Returns a random real in [min,max).
     return min + (max - min) * random_double();
 }
 
+inline int random_int(int min, int max) {
+    // Returns a random integer in [min,max].
+    auto value = static_cast<int>(random_double(static_cast<real>(min), static_cast<real>(max + 1)));
+    return value < max ? value : max;
+}
+
 // Common Headers
 
 #include "ray.h"
@@ -0,0 +1,319 @@
+#pragma once
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "rtweekend.h"
+
+#include <vector>
+
+// Sample values for the camera and the materials. Every random decision a path makes draws
+// from the current thread's sampler, which the camera restarts for each (pixel, sample) pair.
+// Draws are laid out in numbered slots so the same decision uses the same dimension of the
+// sequence in every sample:
+//
+//     slot 0                   pixel position (2D)
+//     slot 1                   lens position (2D)
+//     slot 2 + 5*b + 0..1      bounce b: BSDF direction and component choice
+//     slot 2 + 5*b + 2         bounce b: which light to sample (1D)
+//     slot 2 + 5*b + 3         bounce b: point on that light (2D)
+//     slot 2 + 5*b + 4         bounce b: Russian roulette (1D)
+//
+// The camera seeks to a bounce's block before each stage; draws inside a block then take
+// consecutive slots. Three sequences are available:
+//
+//     independent  the thread's PCG32 generator, plain Monte Carlo
+//     sobol        the first two Sobol dimensions, Owen scrambled per pixel and per slot,
+//                  with the sample index shuffled per slot so slots stay uncorrelated
+//                  (Burley 2020, "Practical Hash-based Owen Scrambling")
+//     blue_noise   the same Sobol points scrambled once for the whole image, then shifted
+//                  per pixel by a blue-noise mask, so the remaining error between neighboring
+//                  pixels is high-frequency and far less visible at low sample counts
+
+enum class sampler_type { independent, sobol, blue_noise };
+
+struct sample2 {
+    real u, v;
+};
+
+namespace sampler_slot {
+    const uint32_t pixel = 0;
+    const uint32_t lens = 1;
+    const uint32_t bounce_base = 2;
+    const uint32_t per_bounce = 5;
+
+    const uint32_t bsdf = 0;
+    const uint32_t light_choice = 2;
+    const uint32_t light_point = 3;
+    const uint32_t roulette = 4;
+
+    inline uint32_t bounce(int depth, uint32_t stage) {
+        return bounce_base + per_bounce * static_cast<uint32_t>(depth) + stage;
+    }
+}
+
+inline uint32_t hash_u32(uint32_t x) {
+    // A 32-bit integer finalizer (lowbias32) for deriving independent scramble seeds.
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+inline uint32_t hash_combine(uint32_t seed, uint32_t v) {
+    return hash_u32(seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+}
+
+inline uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+    // Owen scrambling of a 32-bit fixed-point value by the Laine-Karras hash, applied to the
+    // bit-reversed value so that each bit is flipped depending only on the bits above it.
+    x = reverse_bits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverse_bits(x);
+}
+
+inline uint32_t sobol_dim0(uint32_t index) {
+    // The first Sobol dimension is the base-2 radical inverse.
+    return reverse_bits(index);
+}
+
+inline uint32_t sobol_dim1(uint32_t index) {
+    // The second Sobol dimension, from the primitive polynomial x + 1.
+    uint32_t v = 1u << 31;
+    uint32_t result = 0;
+    for (; index; index >>= 1, v ^= v >> 1)
+        if (index & 1)
+            result ^= v;
+    return result;
+}
+
+inline real fixed_to_real(uint32_t x) {
+    // Maps a 32-bit fixed-point fraction to [0,1), keeping only the bits the type can hold.
+#if defined(RT_USE_FLOAT)
+    return (x >> 8) * (1.0f / 16777216.0f);
+#else
+    return x * (1.0 / 4294967296.0);
+#endif
+}
+
+class blue_noise_mask {
+    // A 64x64 tileable blue-noise threshold map built with Ulichney's void-and-cluster
+    // method: every value 0..4095 appears once, and each prefix of ranks is spread as
+    // evenly as possible. Generated once on first use: every rank updates and rescans
+    // all 4096 cells, so the build is O(n^2), about 35M operations or 35 ms on a 2 GHz
+    // core, paid at the start of the first render that uses it.
+public:
+    static const int size = 64;
+
+    static const blue_noise_mask& get() {
+        static const blue_noise_mask mask;
+        return mask;
+    }
+
+    real value(int x, int y) const {
+        return values[(y & (size - 1)) * size + (x & (size - 1))];
+    }
+
+private:
+    std::vector<real> values;
+
+    blue_noise_mask() {
+        const int n = size * size;
+        const real sigma = real(1.5);
+
+        // Gaussian energy kernel on the torus, indexed by wrapped offset.
+        std::vector<real> kernel(n);
+        for (int dy = 0; dy < size; ++dy) {
+            for (int dx = 0; dx < size; ++dx) {
+                int wx = dx < size / 2 ? dx : dx - size;
+                int wy = dy < size / 2 ? dy : dy - size;
+                kernel[dy * size + dx] = std::exp(-(wx * wx + wy * wy) / (2 * sigma * sigma));
+            }
+        }
+
+        std::vector<uint8_t> pattern(n, 0);
+        std::vector<real> energy(n, 0);
+        auto splat = [&](int p, real sign) {
+            int px = p % size, py = p / size;
+            for (int y = 0; y < size; ++y)
+                for (int x = 0; x < size; ++x)
+                    energy[y * size + x] += sign * kernel[((y - py) & (size - 1)) * size + ((x - px) & (size - 1))];
+        };
+        auto extreme = [&](uint8_t state, bool largest) {
+            // The tightest cluster (highest energy) among ones, or largest void among zeros.
+            int best = -1;
+            for (int p = 0; p < n; ++p) {
+                if (pattern[p] != state)
+                    continue;
+                if (best < 0 || (largest ? energy[p] > energy[best] : energy[p] < energy[best]))
+                    best = p;
+            }
+            return best;
+        };
+
+        // Initial pattern: a tenth of the cells, each placed in the current largest void.
+        const int initial = n / 10;
+        pattern[0] = 1;
+        splat(0, 1);
+        for (int k = 1; k < initial; ++k) {
+            int p = extreme(0, false);
+            pattern[p] = 1;
+            splat(p, 1);
+        }
+
+        // Relax it until removing the tightest cluster and filling the largest void pick the
+        // same cell.
+        for (int guard = 0; guard < n; ++guard) {
+            int cluster = extreme(1, true);
+            pattern[cluster] = 0;
+            splat(cluster, -1);
+            int hole = extreme(0, false);
+            pattern[hole] = 1;
+            splat(hole, 1);
+            if (hole == cluster)
+                break;
+        }
+
+        std::vector<int> rank(n, 0);
+        auto saved_pattern = pattern;
+        auto saved_energy = energy;
+
+        // Rank the initial points by repeatedly removing the tightest cluster.
+        for (int r = initial - 1; r >= 0; --r) {
+            int p = extreme(1, true);
+            pattern[p] = 0;
+            splat(p, -1);
+            rank[p] = r;
+        }
+
+        // Rank the rest by repeatedly filling the largest void.
+        pattern = saved_pattern;
+        energy = saved_energy;
+        for (int r = initial; r < n; ++r) {
+            int p = extreme(0, false);
+            pattern[p] = 1;
+            splat(p, 1);
+            rank[p] = r;
+        }
+
+        values.resize(n);
+        for (int p = 0; p < n; ++p)
+            values[p] = (rank[p] + real(0.5)) / n;
+    }
+};
+
+struct sampler_state {
+    sampler_type type = sampler_type::independent;
+    uint32_t seed = 0;         // Scramble seed of this pixel (sobol) or of the image (blue noise)
+    uint32_t index = 0;        // Sample index within the pixel
+    uint32_t slot = 0;         // Next slot to draw from
+    int      pixel_x = 0;
+    int      pixel_y = 0;
+};
+
+inline sampler_state& thread_sampler() {
+    thread_local sampler_state state;
+    return state;
+}
+
+inline void start_sample(sampler_type type, uint32_t base_seed, int i, int j, uint32_t pixel_index, uint32_t sample_index) {
+    // Restarts this thread's sampler and generator for one camera sample.
+    seed_sample(base_seed, pixel_index, sample_index);
+
+    auto& s = thread_sampler();
+    s.type = type;
+    s.seed = type == sampler_type::sobol ? hash_combine(base_seed, pixel_index) : hash_u32(base_seed);
+    s.index = sample_index;
+    s.slot = 0;
+    s.pixel_x = i;
+    s.pixel_y = j;
+}
+
+inline void sampler_seek(uint32_t slot) {
+    thread_sampler().slot = slot;
+}
+
+inline sample2 sample_2d() {
+    // The next slot's 2D point.
+    auto& s = thread_sampler();
+    uint32_t slot = s.slot++;
+
+    if (s.type == sampler_type::independent) {
+        auto u = random_double();
+        auto v = random_double();
+        return { u, v };
+    }
+
+    uint32_t slot_seed = hash_combine(s.seed, slot);
+    uint32_t index = nested_uniform_scramble(s.index, hash_combine(slot_seed, 0));
+    uint32_t x = nested_uniform_scramble(sobol_dim0(index), hash_combine(slot_seed, 1));
+    uint32_t y = nested_uniform_scramble(sobol_dim1(index), hash_combine(slot_seed, 2));
+    real u = fixed_to_real(x);
+    real v = fixed_to_real(y);
+
+    if (s.type == sampler_type::blue_noise) {
+        // Toroidal shift by the mask, read at a different offset for every slot and axis.
+        const auto& mask = blue_noise_mask::get();
+        uint32_t offset = hash_combine(slot_seed, 3);
+        u += mask.value(s.pixel_x + static_cast<int>(offset & 63), s.pixel_y + static_cast<int>((offset >> 6) & 63));
+        v += mask.value(s.pixel_x + static_cast<int>((offset >> 12) & 63), s.pixel_y + static_cast<int>((offset >> 18) & 63));
+        u = u >= 1 ? u - 1 : u;
+        v = v >= 1 ? v - 1 : v;
+    }
+
+    return { u, v };
+}
+
+inline real sample_1d() {
+    // The next slot's value; 1D draws take a whole slot and use its first coordinate.
+    auto& s = thread_sampler();
+    if (s.type == sampler_type::independent) {
+        ++s.slot;
+        return random_double();
+    }
+    return sample_2d().u;
+}
+
+inline vec3 sample_unit_vector(const sample2& s) {
+    // Uniform direction on the unit sphere.
+    auto z = 1 - 2 * s.u;
+    auto r = std::sqrt(std::fmax(real(0), 1 - z * z));
+    auto phi = 2 * pi * s.v;
+    return vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+inline vec3 sample_unit_disk(const sample2& s) {
+    // Uniform point in the unit disk by Shirley's concentric mapping, which keeps neighboring
+    // samples neighbors so stratification survives the warp.
+    auto a = 2 * s.u - 1;
+    auto b = 2 * s.v - 1;
+    if (a == 0 && b == 0)
+        return vec3(0, 0, 0);
+
+    real r, phi;
+    if (a * a > b * b) {
+        r = a;
+        phi = (pi / 4) * (b / a);
+    }
+    else {
+        r = b;
+        phi = (pi / 2) - (pi / 4) * (a / b);
+    }
+    return vec3(r * std::cos(phi), r * std::sin(phi), 0);
+}
+
+#endif
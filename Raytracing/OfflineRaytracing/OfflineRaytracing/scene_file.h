@@ -0,0 +1,387 @@
+#pragma once
+
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "rtweekend.h"
+
+#include "binary_cache.h"
+#include "bvh.h"
+#include "instance.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "scenes.h"
+#include "sphere.h"
+#include "triangle_mesh.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Text scene files. One statement per line, words separated by spaces, '#' starts a comment:
+//
+//     camera KEY VALUE...        aspect A, width W, spp N, depth D, vfov DEG, lookfrom X Y Z,
+//                                lookat X Y Z, vup X Y Z, defocus DEG, focus DIST, sky 0|1
+//     material NAME lambertian R G B
+//     material NAME metal R G B FUZZ
+//     material NAME dielectric IR
+//     material NAME light R G B
+//     sphere X Y Z RADIUS MATERIAL
+//     mesh NAME FILE.obj MATERIAL
+//     instance MESH [MATERIAL] [translate X Y Z] [rotate_y DEG] [scale S] ...
+//
+// Camera settings not given keep the final scene's values; the ones given must be finite and in
+// range (a positive size, at least one sample, a field of view under 180 degrees). Names must be
+// declared before use, spheres with a light material are also sampled as lights, and relative
+// mesh paths are from the scene file's directory. Instance transforms apply in the order written.
+//
+// The built hierarchies are cached next to the scene in FILE.bvh: every mesh's arrays and BVH,
+// keyed by a hash of its OBJ contents, and the top-level BVH, keyed by a hash of the geometry
+// statements. Later runs map the cache and skip both the OBJ parsing and the builds for
+// anything unchanged; camera and material edits keep the whole cache valid.
+//
+//     scene_cache_header
+//     scene_cache_entry[mesh_count]   source hash and file offset of each cached mesh
+//     mesh data...                    triangle_mesh::write_cache
+//     top-level tree                  bvh_node::write_cache, at top_offset
+
+// Largest image width or height a scene file may ask for.
+const int max_image_size = 1 << 16;
+
+struct scene_cache_header {
+    char     magic[8] = { 'R', 'T', 'B', 'V', 'H', '0', '0', '1' };
+    uint32_t real_bytes = sizeof(real);            // Rejects caches from the other precision build
+    uint32_t node_bytes = sizeof(bvh_flat_node);
+    uint64_t geometry_hash = 0;
+    uint64_t top_offset = 0;
+    uint32_t mesh_count = 0;
+    uint32_t reserved = 0;
+
+    bool compatible(const scene_cache_header& other) const {
+        return memcmp(magic, other.magic, sizeof(magic)) == 0
+            && real_bytes == other.real_bytes && node_bytes == other.node_bytes;
+    }
+};
+
+struct scene_cache_entry {
+    uint64_t source_hash;
+    uint64_t offset;
+};
+
+inline bool load_scene_file(const std::string& path, const scene_options& options, scene& s) {
+    // Reads the scene at path into s, including its top-level BVH. Reports the first error
+    // with its line number and returns false.
+    s = scene();
+    auto start = std::chrono::steady_clock::now();
+
+    mapped_file file;
+    if (!file.open_read(path)) {
+        std::cerr << "Could not open " << path << '\n';
+        return false;
+    }
+
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+    std::string cache_path = path + ".bvh";
+
+    // Index whatever cache is there; stale entries are simply never looked up.
+    cache_reader cache;
+    scene_cache_header cached_header;
+    std::unordered_map<uint64_t, uint64_t> cached_meshes;
+    if (options.bvh_cache && cache.open(cache_path) && cache.get(cached_header)
+        && cached_header.compatible(scene_cache_header())) {
+        for (uint32_t k = 0; k < cached_header.mesh_count; ++k) {
+            scene_cache_entry entry;
+            if (!cache.get(entry))
+                break;
+            cached_meshes[entry.source_hash] = entry.offset;
+        }
+    }
+    else {
+        cached_header = scene_cache_header();
+    }
+
+    std::unordered_map<std::string, uint32_t> material_ids;
+    std::unordered_map<std::string, shared_ptr<triangle_mesh>> meshes;
+    std::vector<std::pair<uint64_t, shared_ptr<triangle_mesh>>> mesh_sources;
+    uint64_t geometry_hash = hash_bytes(nullptr, 0);
+    bool meshes_from_cache = true;
+
+    default_view(s.cam);
+
+    const char* p = reinterpret_cast<const char*>(file.data());
+    const char* end = p + file.size();
+    std::string line;
+    std::vector<char*> words;
+    int line_number = 0;
+
+    auto fail = [&](const std::string& message) {
+        std::cerr << path << ':' << line_number << ": " << message << '\n';
+        return false;
+    };
+
+    while (p < end) {
+        // Copy the line out of the mapping so the number parsing below always stops at a
+        // terminator, then split it into words in place.
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+        line.assign(p, eol);
+        p = eol < end ? eol + 1 : end;
+        ++line_number;
+
+        // The splitter below treats NUL as the end of a word, so a NUL already in the text
+        // would leave it stuck mid-line. No scene file has one; refuse the file instead.
+        if (line.find('\0') != std::string::npos)
+            return fail("unexpected NUL byte");
+
+        auto comment = line.find('#');
+        if (comment != std::string::npos)
+            line.resize(comment);
+
+        words.clear();
+        for (char* c = &line[0]; c < line.data() + line.size();) {
+            while (*c == ' ' || *c == '\t' || *c == '\r')
+                *c++ = '\0';
+            if (!*c)
+                continue;
+            words.push_back(c);
+            while (*c && *c != ' ' && *c != '\t' && *c != '\r')
+                ++c;
+        }
+        if (words.empty())
+            continue;
+
+        size_t next = 1;
+        bool bad_number = false;
+        auto number = [&]() -> real {
+            if (next >= words.size()) {
+                bad_number = true;
+                return 0;
+            }
+            char* stop;
+            auto value = strtod(words[next], &stop);
+            if (stop == words[next] || *stop || !std::isfinite(value))
+                bad_number = true;
+            ++next;
+            return static_cast<real>(value);
+        };
+        auto vector3 = [&]() {
+            auto x = number();
+            auto y = number();
+            auto z = number();
+            return vec3(x, y, z);
+        };
+        auto material_named = [&](const char* name, uint32_t& id) {
+            auto found = material_ids.find(name);
+            if (found == material_ids.end())
+                return false;
+            id = found->second;
+            return true;
+        };
+
+        const std::string command = words[0];
+        bool geometry = command == "sphere" || command == "mesh" || command == "instance";
+
+        if (command == "camera") {
+            auto& cam = s.cam;
+            std::string range_error;
+            auto integer = [&](const char* key, int low, int high) {
+                auto value = number();
+                if (!bad_number && range_error.empty() && !(value >= low && value <= high))
+                    range_error = std::string("camera ") + key + " must be from " + std::to_string(low) + " to " + std::to_string(high);
+                return static_cast<int>(value >= low && value <= high ? value : low);
+            };
+            while (next < words.size() && !bad_number && range_error.empty()) {
+                std::string key = words[next++];
+                if (key == "aspect") cam.aspect_ratio = number();
+                else if (key == "width") cam.image_width = integer("width", 1, max_image_size);
+                else if (key == "spp") cam.samples_per_pixel = integer("spp", 1, 1 << 20);
+                else if (key == "depth") cam.max_depth = integer("depth", 0, 1 << 20);
+                else if (key == "vfov") cam.vfov = number();
+                else if (key == "lookfrom") cam.lookfrom = vector3();
+                else if (key == "lookat") cam.lookat = vector3();
+                else if (key == "vup") cam.vup = vector3();
+                else if (key == "defocus") cam.defocus_angle = number();
+                else if (key == "focus") cam.focus_dist = number();
+                else if (key == "sky") cam.sky = number() != 0;
+                else return fail("unknown camera setting " + key);
+            }
+
+            // What the renderer divides by or sizes its buffers with, checked on the values so
+            // far since settings can be spread over several camera lines.
+            if (!range_error.empty())
+                return fail(range_error);
+            if (!bad_number) {
+                if (!(cam.aspect_ratio > 0) || cam.image_width / cam.aspect_ratio > max_image_size)
+                    return fail("camera aspect must be positive and leave the height at most " + std::to_string(max_image_size));
+                if (!(cam.vfov > 0 && cam.vfov < 180))
+                    return fail("camera vfov must be between 0 and 180 degrees");
+            }
+        }
+        else if (command == "material") {
+            if (words.size() < 3)
+                return fail("material needs a name and a type");
+            std::string type = words[2];
+            next = 3;
+            material m;
+            if (type == "lambertian") m = lambertian(vector3());
+            else if (type == "metal") { auto albedo = vector3(); m = metal(albedo, number()); }
+            else if (type == "dielectric") m = dielectric(number());
+            else if (type == "light") m = diffuse_light(vector3());
+            else return fail("unknown material type " + type);
+            material_ids[words[1]] = s.materials.add(m);
+        }
+        else if (command == "sphere") {
+            auto center = vector3();
+            auto radius = number();
+            uint32_t mat;
+            if (next >= words.size() || !material_named(words[next], mat))
+                return fail("sphere needs a declared material");
+            ++next;
+            auto object = make_shared<sphere>(point3(center.x(), center.y(), center.z()), radius, mat);
+            s.objects.add(object);
+            if (s.materials[mat].type == material_type::diffuse_light)
+                s.lights.add(object);
+        }
+        else if (command == "mesh") {
+            uint32_t mat;
+            if (words.size() < 4 || !material_named(words[3], mat))
+                return fail("mesh needs a name, a file and a declared material");
+            next = 4;
+            // Relative paths are from the scene file; absolute ones (/..., \\..., C:...) stand.
+            std::string obj_path = words[2];
+            bool absolute = obj_path[0] == '/' || obj_path[0] == '\\' || (obj_path.size() > 1 && obj_path[1] == ':');
+            if (!absolute)
+                obj_path = directory + obj_path;
+
+            // The OBJ is hashed from a mapping, which is cheap next to parsing it; only a miss
+            // in the cache pays for load_obj and the build.
+            mapped_file source;
+            if (!source.open_read(obj_path))
+                return fail("could not open " + obj_path);
+            uint64_t source_hash = hash_bytes(source.data(), source.size());
+            source.close();
+
+            shared_ptr<triangle_mesh> mesh;
+            auto cached = cached_meshes.find(source_hash);
+            if (cached != cached_meshes.end() && cache.seek(cached->second))
+                mesh = triangle_mesh::read_cache(cache, mat);
+
+            if (mesh) {
+                std::clog << "Mesh: " << mesh->triangle_count() << " triangles from the cache\n";
+            }
+            else {
+                meshes_from_cache = false;
+                mesh_data data;
+                if (!load_obj(obj_path, data))
+                    return fail("could not read " + obj_path);
+                mesh = make_shared<triangle_mesh>(std::move(data), mat);
+                std::clog << "Mesh: " << mesh->triangle_count() << " triangles, " << mesh->node_count() << " BVH nodes, built in "
+                          << mesh->build_seconds() * 1000.0 << " ms\n";
+            }
+            meshes[words[1]] = mesh;
+            mesh_sources.emplace_back(source_hash, mesh);
+            geometry_hash = hash_bytes(&source_hash, sizeof(source_hash), geometry_hash);
+        }
+        else if (command == "instance") {
+            if (words.size() < 2 || !meshes.count(words[1]))
+                return fail("instance needs a declared mesh");
+            auto mesh = meshes[words[1]];
+            uint32_t mat = no_material;
+            next = 2;
+            if (next < words.size() && material_named(words[next], mat))
+                ++next;
+
+            affine placement;
+            while (next < words.size() && !bad_number) {
+                std::string op = words[next++];
+                if (op == "translate") placement = affine::translate(vector3()) * placement;
+                else if (op == "rotate_y") placement = affine::rotate_y(number()) * placement;
+                else if (op == "scale") placement = affine::scale(number()) * placement;
+                else return fail("unknown instance transform " + op);
+            }
+            if (!bad_number && !placement.invertible())
+                return fail("instance transform is singular, as with scale 0");
+            s.objects.add(make_shared<instance>(mesh, placement, mat));
+        }
+        else {
+            return fail("unknown statement " + command);
+        }
+
+        if (bad_number)
+            return fail("missing or malformed number in " + command);
+        if (next < words.size())
+            return fail(std::string("unexpected ") + words[next]);
+
+        if (geometry) {
+            geometry_hash = hash_bytes(line.data(), line.size(), geometry_hash);
+        }
+    }
+
+    if (s.objects.objects.empty())
+        return fail("no objects");
+
+    // The whole file and the contents of every mesh it names.
+    s.cam.scene_hash = hash_bytes(file.data(), file.size(), geometry_hash);
+
+    // Use the cached top-level tree only when nothing under it has changed.
+    if (meshes_from_cache && cached_header.geometry_hash == geometry_hash && cache.seek(cached_header.top_offset))
+        s.bvh = bvh_node::read_cache(cache, s.objects.objects);
+    cache.close();
+
+    if (s.bvh) {
+        std::clog << "BVH: " << s.bvh->object_count() << " objects, " << s.bvh->node_count() << " nodes from the cache\n";
+    }
+    else {
+        s.bvh = make_shared<bvh_node>(s.objects);
+        std::clog << "BVH: " << s.bvh->object_count() << " objects, " << s.bvh->node_count() << " nodes, built in "
+                  << s.bvh->build_seconds() * 1000.0 << " ms\n";
+
+        if (options.bvh_cache) {
+            // Rewrite the whole cache, with each distinct mesh once.
+            std::unordered_map<uint64_t, shared_ptr<triangle_mesh>> unique;
+            for (const auto& source : mesh_sources)
+                unique.emplace(source.first, source.second);
+
+            scene_cache_header header;
+            header.geometry_hash = geometry_hash;
+            header.mesh_count = static_cast<uint32_t>(unique.size());
+
+            cache_writer out;
+            out.put(header);
+            size_t table = out.size();
+            for (size_t k = 0; k < unique.size(); ++k)
+                out.put(scene_cache_entry{ 0, 0 });
+
+            size_t k = 0;
+            for (const auto& mesh : unique) {
+                out.patch(table + k++ * sizeof(scene_cache_entry), scene_cache_entry{ mesh.first, out.size() });
+                mesh.second->write_cache(out);
+            }
+
+            header.top_offset = out.size();
+            s.bvh->write_cache(out);
+            out.patch(0, header);
+
+            if (!out.save(cache_path))
+                std::cerr << "Failed to write BVH cache to " << cache_path << '\n';
+        }
+    }
+
+    s.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+inline bool load_scene(const std::string& name, const scene_options& options, scene& s) {
+    // A built-in scene by name, or otherwise a scene file.
+    for (auto builtin : scene_names)
+        if (name == builtin)
+            return build_scene(name, options, s);
+    return load_scene_file(name, options, s);
+}
+
+#endif
@@ -0,0 +1,325 @@
+#pragma once
+
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "rtweekend.h"
+
+#include "binary_cache.h"
+#include "bvh.h"
+#include "camera.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "sphere.h"
+#include "triangle_mesh.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// The named scenes the renderer and the benchmark know how to build. Each builder fills in the
+// objects, the materials, the emitters and a camera framed for the scene, and restarts the
+// generator first so a scene comes out the same no matter what was built before it.
+
+struct scene_options {
+    std::string obj_path;     // Mesh for the final scene's center object and the mesh scene
+    int  instance_count = 0;  // Extra copies of that mesh scattered around the final scene
+    bool night = false;       // Light the final scene with small area lights instead of the sky
+    bool bvh_cache = true;    // Scene files reuse and refresh the BVH cache next to them
+};
+
+struct scene {
+    hittable_list objects;     // Every top-level object
+    material_table materials;
+    hittable_list lights;      // Emitters for light sampling; also present in objects
+    camera cam;                // View and quality settings chosen by the scene
+    shared_ptr<bvh_node> bvh;  // Hierarchy over objects, the world the camera renders
+    double build_seconds = 0;  // Scene construction and BVH build together
+};
+
+const char* const scene_names[] = { "final", "spheres100k", "mesh", "glass" };
+
+inline void default_view(camera& cam) {
+    // The view and settings of the book's final render.
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 1200;
+    cam.samples_per_pixel = 10;
+    cam.max_depth = 50;
+
+    cam.vfov = 20;
+    cam.lookfrom = point3(13, 2, 3);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    cam.defocus_angle = 0.6;
+    cam.focus_dist = 10.0;
+}
+
+inline mesh_data torus_mesh(real major_radius, real minor_radius, int rings, int sides) {
+    // A torus around the y axis with smooth vertex normals, for scenes that need a dense mesh
+    // without an OBJ file at hand.
+    mesh_data mesh;
+    for (int r = 0; r < rings; ++r) {
+        auto phi = 2 * pi * r / rings;
+        vec3 radial(std::cos(phi), 0, std::sin(phi));
+        for (int s = 0; s < sides; ++s) {
+            auto theta = 2 * pi * s / sides;
+            vec3 normal = std::cos(theta) * radial + vec3(0, std::sin(theta), 0);
+            mesh.positions.push_back(point3(0, 0, 0) + major_radius * radial + minor_radius * normal);
+            mesh.normals.push_back(normal);
+        }
+    }
+
+    for (int r = 0; r < rings; ++r) {
+        for (int s = 0; s < sides; ++s) {
+            auto a = static_cast<uint32_t>(r * sides + s);
+            auto b = static_cast<uint32_t>(((r + 1) % rings) * sides + s);
+            auto c = static_cast<uint32_t>(((r + 1) % rings) * sides + (s + 1) % sides);
+            auto d = static_cast<uint32_t>(r * sides + (s + 1) % sides);
+            for (auto index : { a, b, c, a, c, d }) {
+                mesh.position_indices.push_back(index);
+                mesh.normal_indices.push_back(index);
+            }
+        }
+    }
+    return mesh;
+}
+
+inline shared_ptr<triangle_mesh> make_mesh(const std::string& obj_path, uint32_t mat) {
+    // Loads obj_path, or builds a 128k-triangle torus when it is empty, scaled to a unit radius
+    // around the origin. Returns null when the file cannot be read.
+    mesh_data data;
+    if (obj_path.empty()) {
+        data = torus_mesh(real(0.7), real(0.3), 512, 128);
+    }
+    else if (!load_obj(obj_path, data)) {
+        std::cerr << "Could not load " << obj_path << '\n';
+        return nullptr;
+    }
+    fit_mesh(data, point3(0, 0, 0), 1.0);
+
+    auto mesh = make_shared<triangle_mesh>(std::move(data), mat);
+    std::clog << "Mesh: " << mesh->triangle_count() << " triangles, " << mesh->node_count() << " BVH nodes, "
+              << mesh->bytes_per_triangle() << " bytes per triangle, built in " << mesh->build_seconds() * 1000.0 << " ms\n";
+    return mesh;
+}
+
+inline bool build_final_scene(const scene_options& options, scene& s) {
+    auto& world = s.objects;
+    auto& materials = s.materials;
+
+    auto ground_material = materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
+                uint32_t sphere_material;
+
+                if (choose_mat < 0.8) {
+                    // diffuse
+                    auto albedo = color::random() * color::random();
+                    sphere_material = materials.add(lambertian(albedo));
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+                else if (choose_mat < 0.95) {
+                    // metal
+                    auto albedo = color::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    sphere_material = materials.add(metal(albedo, fuzz));
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+                else {
+                    // glass
+                    sphere_material = materials.add(dielectric(1.5));
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+            }
+        }
+    }
+
+    auto material1 = materials.add(dielectric(1.5));
+    if (options.obj_path.empty()) {
+        world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+    }
+    else {
+        // The mesh and its BVH are built once; every placement below is an instance of it.
+        auto mesh = make_mesh(options.obj_path, material1);
+        if (!mesh)
+            return false;
+        world.add(make_shared<instance>(mesh, affine::translate(vec3(0, 1, 0))));
+
+        for (int k = 0; k < options.instance_count; k++) {
+            // Small copies resting on the ground outside the area covered by the random spheres.
+            auto size = random_double(0.3, 0.8);
+            auto angle = random_double(0, 2 * pi);
+            auto distance = random_double(13, 30);
+            point3 center(distance * std::cos(angle), size, distance * std::sin(angle));
+
+            auto albedo = color::random() * color::random();
+            auto placement = affine::translate(center) * affine::rotate_y(random_double(0, 360)) * affine::scale(size);
+            world.add(make_shared<instance>(mesh, placement, materials.add(lambertian(albedo))));
+        }
+
+        if (options.instance_count > 0) {
+            std::clog << "Instances: " << options.instance_count + 1 << " copies of the mesh in "
+                      << mesh->memory_bytes() + (options.instance_count + 1) * sizeof(instance) << " bytes, "
+                      << (options.instance_count + 1) * mesh->memory_bytes() << " bytes if copied\n";
+        }
+    }
+
+    auto material2 = materials.add(lambertian(color(0.4, 0.2, 0.1)));
+    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+
+    auto material3 = materials.add(metal(color(0.7, 0.6, 0.5), 0.0));
+    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+
+    // Small spherical area lights hovering over the scene. They go in the world like any
+    // other object and also in the emitter list the camera samples.
+    if (options.night) {
+        auto warm = materials.add(diffuse_light(color(40, 32, 20)));
+        auto cool = materials.add(diffuse_light(color(16, 20, 36)));
+        auto lamp1 = make_shared<sphere>(point3(2, 3, -1.5), 0.25, warm);
+        auto lamp2 = make_shared<sphere>(point3(-3, 2.5, 2), 0.25, cool);
+        world.add(lamp1);
+        world.add(lamp2);
+        s.lights.add(lamp1);
+        s.lights.add(lamp2);
+    }
+
+    default_view(s.cam);
+    s.cam.sky = !options.night;
+    return true;
+}
+
+inline bool build_sphere_field(scene& s) {
+    // 100,000 small spheres jittered over a 317-wide grid, drawing on a shared palette of
+    // diffuse and metal materials. Stresses BVH depth and traversal rather than shading.
+    auto& materials = s.materials;
+    s.objects.add(make_shared<sphere>(point3(0, -1000, 0), 1000, materials.add(lambertian(color(0.5, 0.5, 0.5)))));
+
+    std::vector<uint32_t> palette;
+    for (int k = 0; k < 48; ++k)
+        palette.push_back(materials.add(lambertian(color::random() * color::random())));
+    for (int k = 0; k < 16; ++k)
+        palette.push_back(materials.add(metal(color::random(0.5, 1), random_double(0, 0.3))));
+
+    const int count = 100000;
+    const int side = 317;
+    const real spacing = real(0.12);
+    for (int k = 0; k < count; ++k) {
+        int a = k / side, b = k % side;
+        auto radius = random_double(0.02, 0.05);
+        point3 center((a - side / 2 + 0.8 * random_double()) * spacing, radius,
+                      (b - side / 2 + 0.8 * random_double()) * spacing);
+        auto mat = palette[random_int(0, static_cast<int>(palette.size()) - 1)];
+        s.objects.add(make_shared<sphere>(center, radius, mat));
+    }
+
+    default_view(s.cam);
+    s.cam.lookfrom = point3(12, 3, 9);
+    s.cam.lookat = point3(0, 0, 0);
+    s.cam.vfov = 30;
+    s.cam.defocus_angle = 0.2;
+    s.cam.focus_dist = 15.0;
+    return true;
+}
+
+inline bool build_mesh_scene(const scene_options& options, scene& s) {
+    // One dense mesh in the middle and a ring of rotated instances of it on a diffuse floor.
+    auto& materials = s.materials;
+    s.objects.add(make_shared<sphere>(point3(0, -1000, 0), 1000, materials.add(lambertian(color(0.5, 0.5, 0.5)))));
+
+    auto mesh = make_mesh(options.obj_path, materials.add(metal(color(0.8, 0.6, 0.4), 0.1)));
+    if (!mesh)
+        return false;
+    s.objects.add(make_shared<instance>(mesh, affine::translate(vec3(0, 1.5, 0)) * affine::scale(1.5)));
+
+    for (int k = 0; k < 12; ++k) {
+        auto angle = 2 * pi * k / 12;
+        point3 center(4 * std::cos(angle), 0.6, 4 * std::sin(angle));
+        auto placement = affine::translate(center) * affine::rotate_y(random_double(0, 360)) * affine::scale(0.6);
+        s.objects.add(make_shared<instance>(mesh, placement, materials.add(lambertian(color::random() * color::random()))));
+    }
+
+    default_view(s.cam);
+    s.cam.lookfrom = point3(9, 5, 9);
+    s.cam.lookat = point3(0, 1, 0);
+    s.cam.vfov = 35;
+    s.cam.defocus_angle = 0;
+    return true;
+}
+
+inline bool build_glass_scene(scene& s) {
+    // A 9 x 9 grid of glass spheres in front of a row of colored diffuse ones, so most paths
+    // refract and reflect many times before they reach anything diffuse.
+    auto& materials = s.materials;
+    s.objects.add(make_shared<sphere>(point3(0, -1000, 0), 1000, materials.add(lambertian(color(0.6, 0.6, 0.6)))));
+
+    for (int a = -4; a <= 4; ++a) {
+        for (int b = -4; b <= 4; ++b) {
+            auto ir = random_double(1.3, 1.8);
+            s.objects.add(make_shared<sphere>(point3(a, 0.4, b), 0.4, materials.add(dielectric(ir))));
+        }
+    }
+
+    // A row behind the grid, across the line of sight.
+    for (int k = -3; k <= 3; ++k) {
+        point3 center(-5.5 + 1.2 * k, 0.5, -5.5 - 1.2 * k);
+        s.objects.add(make_shared<sphere>(center, 0.5, materials.add(lambertian(color::random(0.2, 0.9)))));
+    }
+
+    default_view(s.cam);
+    s.cam.lookfrom = point3(7, 2.5, 7);
+    s.cam.lookat = point3(-0.5, 0.3, -0.5);
+    s.cam.vfov = 32;
+    s.cam.defocus_angle = 0;
+    return true;
+}
+
+inline bool build_scene(const std::string& name, const scene_options& options, scene& s) {
+    // Builds the named scene and its top-level BVH into s. Returns false for an unknown name
+    // or a mesh that fails to load.
+    s = scene();
+    thread_rng() = rng_engine();
+    auto start = std::chrono::steady_clock::now();
+
+    bool built = false;
+    if (name == "final")
+        built = build_final_scene(options, s);
+    else if (name == "spheres100k")
+        built = build_sphere_field(s);
+    else if (name == "mesh")
+        built = build_mesh_scene(options, s);
+    else if (name == "glass")
+        built = build_glass_scene(s);
+    else
+        std::cerr << "Unknown scene " << name << '\n';
+
+    if (!built)
+        return false;
+
+    // Built-in scenes come out the same from the same options, so those and the mesh file
+    // identify the scene.
+    uint64_t scene_hash = hash_bytes(name.data(), name.size());
+    scene_hash = hash_bytes(&options.instance_count, sizeof(options.instance_count), scene_hash);
+    scene_hash = hash_bytes(&options.night, sizeof(options.night), scene_hash);
+    mapped_file obj;
+    if (!options.obj_path.empty() && obj.open_read(options.obj_path))
+        scene_hash = hash_bytes(obj.data(), obj.size(), scene_hash);
+    s.cam.scene_hash = scene_hash;
+
+    s.bvh = make_shared<bvh_node>(s.objects);
+    s.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::clog << "BVH: " << s.bvh->object_count() << " objects, " << s.bvh->node_count() << " nodes, built in "
+              << s.bvh->build_seconds() * 1000.0 << " ms\n";
+    return true;
+}
+
+#endif
@@ -0,0 +1,145 @@
+#pragma once
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "rtweekend.h"
+
+// A small fixed-width vector of `real` for data-parallel kernels. The width and instruction set
+// follow the precision mode and the compiler's target:
+//
+//     AVX,  float   8 lanes of __m256
+//     AVX,  double  4 lanes of __m256d
+//     SSE2, float   4 lanes of __m128
+//     SSE2, double  4 lanes as two __m128d
+//
+// Comparisons return a vreal whose lanes are all-ones or all-zeros, like the hardware masks.
+// RT_SIMD is defined whenever one of these is available.
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RT_SIMD
+#define RT_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RT_SIMD
+#define RT_SIMD_SSE2
+#endif
+
+#if defined(RT_SIMD_AVX) && defined(RT_USE_FLOAT)
+
+struct vreal {
+    static constexpr int width = 8;
+    __m256 v;
+
+    vreal() {}
+    vreal(__m256 x) : v(x) {}
+    explicit vreal(real x) : v(_mm256_set1_ps(x)) {}
+
+    static vreal load(const real* p) { return _mm256_loadu_ps(p); }
+    void store(real* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline vreal operator+(vreal a, vreal b) { return _mm256_add_ps(a.v, b.v); }
+inline vreal operator-(vreal a, vreal b) { return _mm256_sub_ps(a.v, b.v); }
+inline vreal operator*(vreal a, vreal b) { return _mm256_mul_ps(a.v, b.v); }
+inline vreal operator<(vreal a, vreal b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline vreal operator>(vreal a, vreal b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline vreal operator>=(vreal a, vreal b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline vreal operator&(vreal a, vreal b) { return _mm256_and_ps(a.v, b.v); }
+inline vreal vsqrt(vreal a) { return _mm256_sqrt_ps(a.v); }
+inline vreal vmax(vreal a, vreal b) { return _mm256_max_ps(a.v, b.v); }
+inline vreal select(vreal mask, vreal a, vreal b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+inline int movemask(vreal mask) { return _mm256_movemask_ps(mask.v); }
+
+#elif defined(RT_SIMD_AVX)
+
+struct vreal {
+    static constexpr int width = 4;
+    __m256d v;
+
+    vreal() {}
+    vreal(__m256d x) : v(x) {}
+    explicit vreal(real x) : v(_mm256_set1_pd(x)) {}
+
+    static vreal load(const real* p) { return _mm256_loadu_pd(p); }
+    void store(real* p) const { _mm256_storeu_pd(p, v); }
+};
+
+inline vreal operator+(vreal a, vreal b) { return _mm256_add_pd(a.v, b.v); }
+inline vreal operator-(vreal a, vreal b) { return _mm256_sub_pd(a.v, b.v); }
+inline vreal operator*(vreal a, vreal b) { return _mm256_mul_pd(a.v, b.v); }
+inline vreal operator<(vreal a, vreal b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+inline vreal operator>(vreal a, vreal b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+inline vreal operator>=(vreal a, vreal b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ); }
+inline vreal operator&(vreal a, vreal b) { return _mm256_and_pd(a.v, b.v); }
+inline vreal vsqrt(vreal a) { return _mm256_sqrt_pd(a.v); }
+inline vreal vmax(vreal a, vreal b) { return _mm256_max_pd(a.v, b.v); }
+inline vreal select(vreal mask, vreal a, vreal b) { return _mm256_blendv_pd(b.v, a.v, mask.v); }
+inline int movemask(vreal mask) { return _mm256_movemask_pd(mask.v); }
+
+#elif defined(RT_SIMD_SSE2) && defined(RT_USE_FLOAT)
+
+struct vreal {
+    static constexpr int width = 4;
+    __m128 v;
+
+    vreal() {}
+    vreal(__m128 x) : v(x) {}
+    explicit vreal(real x) : v(_mm_set1_ps(x)) {}
+
+    static vreal load(const real* p) { return _mm_loadu_ps(p); }
+    void store(real* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline vreal operator+(vreal a, vreal b) { return _mm_add_ps(a.v, b.v); }
+inline vreal operator-(vreal a, vreal b) { return _mm_sub_ps(a.v, b.v); }
+inline vreal operator*(vreal a, vreal b) { return _mm_mul_ps(a.v, b.v); }
+inline vreal operator<(vreal a, vreal b) { return _mm_cmplt_ps(a.v, b.v); }
+inline vreal operator>(vreal a, vreal b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline vreal operator>=(vreal a, vreal b) { return _mm_cmpge_ps(a.v, b.v); }
+inline vreal operator&(vreal a, vreal b) { return _mm_and_ps(a.v, b.v); }
+inline vreal vsqrt(vreal a) { return _mm_sqrt_ps(a.v); }
+inline vreal vmax(vreal a, vreal b) { return _mm_max_ps(a.v, b.v); }
+inline vreal select(vreal mask, vreal a, vreal b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+inline int movemask(vreal mask) { return _mm_movemask_ps(mask.v); }
+
+#elif defined(RT_SIMD_SSE2)
+
+struct vreal {
+    static constexpr int width = 4;
+    __m128d lo, hi;
+
+    vreal() {}
+    vreal(__m128d l, __m128d h) : lo(l), hi(h) {}
+    explicit vreal(real x) : lo(_mm_set1_pd(x)), hi(_mm_set1_pd(x)) {}
+
+    static vreal load(const real* p) { return vreal(_mm_loadu_pd(p), _mm_loadu_pd(p + 2)); }
+    void store(real* p) const { _mm_storeu_pd(p, lo); _mm_storeu_pd(p + 2, hi); }
+};
+
+inline vreal operator+(vreal a, vreal b) { return vreal(_mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi)); }
+inline vreal operator-(vreal a, vreal b) { return vreal(_mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi)); }
+inline vreal operator*(vreal a, vreal b) { return vreal(_mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi)); }
+inline vreal operator<(vreal a, vreal b) { return vreal(_mm_cmplt_pd(a.lo, b.lo), _mm_cmplt_pd(a.hi, b.hi)); }
+inline vreal operator>(vreal a, vreal b) { return vreal(_mm_cmpgt_pd(a.lo, b.lo), _mm_cmpgt_pd(a.hi, b.hi)); }
+inline vreal operator>=(vreal a, vreal b) { return vreal(_mm_cmpge_pd(a.lo, b.lo), _mm_cmpge_pd(a.hi, b.hi)); }
+inline vreal operator&(vreal a, vreal b) { return vreal(_mm_and_pd(a.lo, b.lo), _mm_and_pd(a.hi, b.hi)); }
+inline vreal vsqrt(vreal a) { return vreal(_mm_sqrt_pd(a.lo), _mm_sqrt_pd(a.hi)); }
+inline vreal vmax(vreal a, vreal b) { return vreal(_mm_max_pd(a.lo, b.lo), _mm_max_pd(a.hi, b.hi)); }
+inline vreal select(vreal mask, vreal a, vreal b) {
+    return vreal(_mm_or_pd(_mm_and_pd(mask.lo, a.lo), _mm_andnot_pd(mask.lo, b.lo)),
+                 _mm_or_pd(_mm_and_pd(mask.hi, a.hi), _mm_andnot_pd(mask.hi, b.hi)));
+}
+inline int movemask(vreal mask) { return _mm_movemask_pd(mask.lo) | (_mm_movemask_pd(mask.hi) << 2); }
+
+#else
+
+struct vreal {
+    // No vector unit: kernels check RT_SIMD and fall back to plain scalar loops.
+    static constexpr int width = 1;
+};
+
+#endif
+
+#endif
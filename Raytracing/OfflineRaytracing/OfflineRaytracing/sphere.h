@@ -4,13 +4,17 @@
 #define SPHERE_H
 
 #include "hittable.h"
+#include "onb.h"
 #include "vec3.h"
-#include "material.h"
 
 class sphere : public hittable {
 public:
-    sphere(point3 _center, double _radius, shared_ptr<material> _material)
-        : center(_center), radius(_radius), mat(_material) {}
+    sphere(point3 _center, real _radius, uint32_t _material)
+        : center(_center), radius(_radius), mat(_material)
+    {
+        auto rvec = vec3(radius, radius, radius);
+        bbox = aabb(center - rvec, center + rvec);
+    }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
         vec3 oc = r.origin() - center;
@@ -39,10 +43,42 @@ public:
         return true;
     }
 
+    aabb bounding_box() const override { return bbox; }
+
+    real pdf_value(const point3& origin, const vec3& direction) const override {
+        // Uniform over the cone of directions that see the sphere from origin.
+        auto distance_squared = (center - origin).length_squared();
+        if (distance_squared <= radius * radius)
+            return 0;
+
+        hit_record rec;
+        if (!this->hit(ray(origin, direction), interval(real(0.001), infinity), rec))
+            return 0;
+
+        auto cos_theta_max = std::sqrt(1 - radius * radius / distance_squared);
+        auto solid_angle = 2 * pi * (1 - cos_theta_max);
+        return 1 / solid_angle;
+    }
+
+    vec3 random(const point3& origin) const override {
+        vec3 direction = center - origin;
+        auto distance_squared = direction.length_squared();
+        if (distance_squared <= radius * radius)
+            return direction;
+
+        onb uvw(direction);
+        return uvw.local(random_to_sphere(radius, distance_squared));
+    }
+
+    point3 get_center() const { return center; }
+    real get_radius() const { return radius; }
+    uint32_t get_material() const { return mat; }
+
 private:
     point3 center;
-    double radius;
-    shared_ptr<material> mat;
+    real radius;
+    uint32_t mat;
+    aabb bbox;
 };
 
 #endif
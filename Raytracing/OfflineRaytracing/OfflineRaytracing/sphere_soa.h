@@ -0,0 +1,169 @@
+#pragma once
+
+#ifndef SPHERE_SOA_H
+#define SPHERE_SOA_H
+
+#include "hittable.h"
+#include "simd.h"
+#include "sphere.h"
+
+#include <vector>
+
+class sphere_soa : public hittable {
+    // Spheres packed as structure-of-arrays so one ray is tested against vreal::width spheres
+    // (4 or 8) per step without any virtual calls. The arrays are padded to a whole number of
+    // packets with spheres that can never be hit. Without SIMD the same arrays are walked with
+    // a scalar loop.
+public:
+    sphere_soa() {}
+
+    void add(point3 center, real radius, uint32_t mat) {
+        // Fill the first padding slot if there is one, otherwise open a new packet.
+        if (count % vreal::width == 0)
+            grow_packet();
+
+        cx[count] = center.x();
+        cy[count] = center.y();
+        cz[count] = center.z();
+        r2[count] = radius * radius;
+        radii[count] = radius;
+        materials[count] = mat;
+        ++count;
+
+        auto rvec = vec3(radius, radius, radius);
+        bbox = aabb(bbox, aabb(center - rvec, center + rvec));
+    }
+
+    void add(const sphere& s) {
+        add(s.get_center(), s.get_radius(), s.get_material());
+    }
+
+    size_t size() const { return count; }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        real closest = ray_t.max;
+        size_t best = closest_sphere(r, ray_t.min, closest);
+
+        if (best == count)
+            return false;
+
+        point3 center(cx[best], cy[best], cz[best]);
+        rec.t = closest;
+        rec.p = r.at(rec.t);
+        vec3 outward_normal = (rec.p - center) / radii[best];
+        rec.set_face_normal(r, outward_normal);
+        rec.mat = materials[best];
+
+        return true;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    std::vector<real> cx, cy, cz, r2, radii;
+    std::vector<uint32_t> materials;
+    size_t count = 0;
+    aabb bbox;
+
+#if defined(RT_SIMD)
+    size_t closest_sphere(const ray& r, real t_lo, real& closest) const {
+        // Returns the index of the nearest sphere hit in (t_lo, closest) and shrinks closest to
+        // its root, or returns count on a miss.
+        auto orig = r.origin();
+        auto dir = r.direction();
+
+        vreal ox(orig.x()), oy(orig.y()), oz(orig.z());
+        vreal dx(dir.x()), dy(dir.y()), dz(dir.z());
+        vreal a(dir.length_squared());
+        vreal inv_a(1 / dir.length_squared());
+        vreal zero(0);
+        vreal t_min(t_lo);
+
+        size_t best = count;
+        alignas(32) real lane_t[vreal::width];
+
+        for (size_t base = 0; base < cx.size(); base += vreal::width) {
+            vreal t_max(closest);
+
+            // Same quadratic as sphere::hit, with oc = origin - center.
+            vreal ocx = ox - vreal::load(&cx[base]);
+            vreal ocy = oy - vreal::load(&cy[base]);
+            vreal ocz = oz - vreal::load(&cz[base]);
+
+            vreal half_b = ocx * dx + ocy * dy + ocz * dz;
+            vreal c = ocx * ocx + ocy * ocy + ocz * ocz - vreal::load(&r2[base]);
+            vreal discriminant = half_b * half_b - a * c;
+            vreal valid = discriminant >= zero;
+            if (!movemask(valid))
+                continue;
+
+            vreal sqrtd = vsqrt(vmax(discriminant, zero));
+            vreal near_root = (zero - half_b - sqrtd) * inv_a;
+            vreal far_root = (sqrtd - half_b) * inv_a;
+
+            // Prefer the near root, falling back to the far one when the near root is out of range.
+            vreal near_ok = valid & (near_root > t_min) & (near_root < t_max);
+            vreal root = select(near_ok, near_root, far_root);
+            vreal hit_mask = valid & (root > t_min) & (root < t_max);
+
+            int bits = movemask(hit_mask);
+            if (!bits)
+                continue;
+
+            root.store(lane_t);
+            for (int k = 0; k < vreal::width; ++k) {
+                if ((bits & (1 << k)) && lane_t[k] < closest) {
+                    closest = lane_t[k];
+                    best = base + k;
+                }
+            }
+        }
+
+        return best;
+    }
+#else
+    size_t closest_sphere(const ray& r, real t_lo, real& closest) const {
+        auto orig = r.origin();
+        auto dir = r.direction();
+        auto a = dir.length_squared();
+        size_t best = count;
+
+        for (size_t k = 0; k < count; ++k) {
+            auto ocx = orig.x() - cx[k];
+            auto ocy = orig.y() - cy[k];
+            auto ocz = orig.z() - cz[k];
+            auto half_b = ocx * dir.x() + ocy * dir.y() + ocz * dir.z();
+            auto c = ocx * ocx + ocy * ocy + ocz * ocz - r2[k];
+            auto discriminant = half_b * half_b - a * c;
+            if (discriminant < 0)
+                continue;
+
+            auto sqrtd = sqrt(discriminant);
+            auto root = (-half_b - sqrtd) / a;
+            if (!(root > t_lo && root < closest)) {
+                root = (-half_b + sqrtd) / a;
+                if (!(root > t_lo && root < closest))
+                    continue;
+            }
+            closest = root;
+            best = k;
+        }
+
+        return best;
+    }
+#endif
+
+    void grow_packet() {
+        // Padding lanes sit at the origin with a radius squared of -infinity, which makes the
+        // quadratic's c term +infinity and the discriminant negative for every ray.
+        size_t n = cx.size() + vreal::width;
+        cx.resize(n, 0);
+        cy.resize(n, 0);
+        cz.resize(n, 0);
+        r2.resize(n, -infinity);
+        radii.resize(n, 1);
+        materials.resize(n, no_material);
+    }
+};
+
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct tile {
+    int x0, y0;  // Upper left pixel (inclusive)
+    int x1, y1;  // Lower right pixel (exclusive)
+};
+
+class tile_scheduler {
+public:
+    // Splits a width x height image into square tiles and hands each worker a contiguous
+    // run of them. Workers that run dry steal from the far end of another worker's queue.
+    tile_scheduler(int width, int height, int tile_size, int num_workers)
+        : queues(num_workers) {
+        std::vector<tile> tiles;
+        for (int y = 0; y < height; y += tile_size)
+            for (int x = 0; x < width; x += tile_size)
+                tiles.push_back({ x, y, std::min(x + tile_size, width), std::min(y + tile_size, height) });
+
+        total = static_cast<int>(tiles.size());
+
+        for (auto& q : queues)
+            q = std::make_unique<worker_queue>();
+
+        for (int k = 0; k < total; ++k) {
+            auto owner = static_cast<size_t>(k) * num_workers / total;
+            queues[owner]->tiles.push_back(tiles[k]);
+        }
+    }
+
+    int tile_count() const { return total; }
+
+    bool next(int worker, tile& out) {
+        // Take from the front of our own queue first so neighbouring tiles stay on one thread.
+        {
+            auto& own = *queues[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.tiles.empty()) {
+                out = own.tiles.front();
+                own.tiles.pop_front();
+                return true;
+            }
+        }
+
+        // Otherwise steal from the back of the other queues.
+        int n = static_cast<int>(queues.size());
+        for (int k = 1; k < n; ++k) {
+            auto& victim = *queues[(worker + k) % n];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tiles.empty()) {
+                out = victim.tiles.back();
+                victim.tiles.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    struct worker_queue {
+        std::mutex lock;
+        std::deque<tile> tiles;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    int total = 0;
+};
+
+inline int resolve_thread_count(int requested) {
+    // Returns the requested worker count, or every hardware thread when it is 0 or less.
+    if (requested > 0)
+        return requested;
+    int hw = static_cast<int>(std::thread::hardware_concurrency());
+    return hw > 0 ? hw : 1;
+}
+
+template <typename TileFunc>
+void run_tiles(int width, int height, int tile_size, int num_threads, TileFunc&& func) {
+    // Calls func(tile, worker_index) once for every tile of the image across num_threads
+    // workers. The calling thread acts as worker 0.
+    num_threads = resolve_thread_count(num_threads);
+    tile_scheduler scheduler(width, height, tile_size, num_threads);
+
+    auto worker = [&](int index) {
+        tile t;
+        while (scheduler.next(index, t))
+            func(t, index);
+    };
+
+    std::vector<std::thread> pool;
+    for (int k = 1; k < num_threads; ++k)
+        pool.emplace_back(worker, k);
+
+    worker(0);
+
+    for (auto& thread : pool)
+        thread.join();
+}
+
+#endif
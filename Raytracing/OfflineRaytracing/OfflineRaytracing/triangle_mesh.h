@@ -0,0 +1,347 @@
+#pragma once
+
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct mesh_data {
+    // Shared vertex arrays plus three position indices per triangle, and optionally three
+    // normal indices per triangle when the source provides vertex normals.
+    std::vector<point3>   positions;
+    std::vector<vec3>     normals;
+    std::vector<uint32_t> position_indices;
+    std::vector<uint32_t> normal_indices;
+
+    size_t triangle_count() const { return position_indices.size() / 3; }
+};
+
+inline bool load_obj(const std::string& path, mesh_data& mesh) {
+    // Reads the v, vn and f records of a Wavefront OBJ file. Polygons are split into triangle
+    // fans and negative (relative) indices are resolved. Texture coordinates are skipped.
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    mesh = mesh_data();
+
+    const char* p = text.c_str();
+    const char* end = p + text.size();
+
+    auto skip_spaces = [&]() { while (p < end && (*p == ' ' || *p == '\t')) ++p; };
+    auto next_line = [&]() { while (p < end && *p != '\n') ++p; if (p < end) ++p; };
+    auto read_real = [&]() {
+        char* stop;
+        auto value = static_cast<real>(strtod(p, &stop));
+        p = stop;
+        return value;
+    };
+    auto resolve = [](long index, size_t count) -> long {
+        // OBJ indices are 1-based; negative ones count back from the latest element.
+        return index < 0 ? static_cast<long>(count) + index : index - 1;
+    };
+
+    std::vector<long> face_positions, face_normals;
+    bool has_normals = true;
+
+    while (p < end) {
+        skip_spaces();
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            p += 2;
+            auto x = read_real();
+            auto y = read_real();
+            auto z = read_real();
+            mesh.positions.emplace_back(x, y, z);
+        }
+        else if (p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            p += 3;
+            auto x = read_real();
+            auto y = read_real();
+            auto z = read_real();
+            mesh.normals.emplace_back(x, y, z);
+        }
+        else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            p += 2;
+            face_positions.clear();
+            face_normals.clear();
+
+            while (true) {
+                skip_spaces();
+                if (p >= end || *p == '\n' || *p == '\r' || *p == '#')
+                    break;
+
+                char* stop;
+                long v = strtol(p, &stop, 10);
+                if (stop == p)
+                    return false;
+                p = stop;
+
+                long vn = 0;
+                if (*p == '/') {
+                    ++p;
+                    if (*p != '/') {
+                        strtol(p, &stop, 10);  // Texture coordinate, unused
+                        p = stop;
+                    }
+                    if (*p == '/') {
+                        ++p;
+                        vn = strtol(p, &stop, 10);
+                        p = stop;
+                    }
+                }
+
+                face_positions.push_back(resolve(v, mesh.positions.size()));
+                face_normals.push_back(vn == 0 ? -1 : resolve(vn, mesh.normals.size()));
+            }
+
+            for (size_t k = 2; k < face_positions.size(); ++k) {
+                const size_t corners[3] = { 0, k - 1, k };
+                for (auto c : corners) {
+                    if (face_positions[c] < 0 || face_positions[c] >= static_cast<long>(mesh.positions.size()))
+                        return false;
+                    mesh.position_indices.push_back(static_cast<uint32_t>(face_positions[c]));
+                    if (face_normals[c] < 0 || face_normals[c] >= static_cast<long>(mesh.normals.size()))
+                        has_normals = false;
+                    else
+                        mesh.normal_indices.push_back(static_cast<uint32_t>(face_normals[c]));
+                }
+            }
+        }
+        next_line();
+    }
+
+    // Smooth shading needs a normal at every corner; otherwise fall back to face normals.
+    if (!has_normals || mesh.normal_indices.size() != mesh.position_indices.size()) {
+        mesh.normals.clear();
+        mesh.normal_indices.clear();
+    }
+
+    return true;
+}
+
+inline void fit_mesh(mesh_data& mesh, const point3& center, real radius) {
+    // Uniformly scales and moves the mesh so its bounding box is centered on `center` and its
+    // longest half-extent equals `radius`.
+    aabb box;
+    for (const auto& p : mesh.positions)
+        box = aabb(box, aabb(p, p));
+    if (box.is_empty())
+        return;
+
+    auto half_extent = std::fmax(box.x.size(), std::fmax(box.y.size(), box.z.size())) / 2;
+    auto scale = half_extent > 0 ? radius / half_extent : real(1);
+    auto offset = box.centroid();
+    for (auto& p : mesh.positions)
+        p = center + scale * (p - offset);
+}
+
+class triangle_mesh : public hittable {
+    // A triangle mesh with its own BVH. Vertices live in shared arrays and each triangle is
+    // just three indices, so a triangle costs its index triple plus its share of BVH nodes and
+    // vertices rather than a separate heap object.
+public:
+    triangle_mesh(mesh_data data, uint32_t m) : mat(m) {
+        auto start = std::chrono::steady_clock::now();
+
+        positions = std::move(data.positions);
+        normals = std::move(data.normals);
+        positions.shrink_to_fit();
+        normals.shrink_to_fit();
+
+        size_t triangles = data.triangle_count();
+        std::vector<aabb> boxes(triangles);
+        for (size_t k = 0; k < triangles; ++k) {
+            const point3& a = positions[data.position_indices[3 * k + 0]];
+            const point3& b = positions[data.position_indices[3 * k + 1]];
+            const point3& c = positions[data.position_indices[3 * k + 2]];
+            boxes[k] = aabb(aabb(a, b), aabb(c, c));
+        }
+
+        tree.build(boxes);
+
+        // Store the index triples in leaf order.
+        position_indices.resize(3 * triangles);
+        if (!normals.empty())
+            normal_indices.resize(3 * triangles);
+        for (size_t slot = 0; slot < triangles; ++slot) {
+            auto src = tree.prim_indices[slot];
+            for (int c = 0; c < 3; ++c) {
+                position_indices[3 * slot + c] = data.position_indices[3 * src + c];
+                if (!normals.empty())
+                    normal_indices[3 * slot + c] = data.normal_indices[3 * src + c];
+            }
+        }
+        tree.prim_indices.clear();
+        tree.prim_indices.shrink_to_fit();
+
+        build_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void write_cache(cache_writer& out) const {
+        // The leaf-ordered arrays and the tree over them, everything the constructor builds.
+        out.put_array(positions);
+        out.put_array(normals);
+        out.put_array(position_indices);
+        out.put_array(normal_indices);
+        out.put_array(tree.nodes);
+    }
+
+    static shared_ptr<triangle_mesh> read_cache(cache_reader& in, uint32_t m) {
+        // Returns the mesh written by write_cache, or null if the data is truncated or any
+        // index is out of range.
+        shared_ptr<triangle_mesh> mesh(new triangle_mesh(m));
+        if (!in.get_array(mesh->positions) || !in.get_array(mesh->normals) || !in.get_array(mesh->position_indices)
+            || !in.get_array(mesh->normal_indices) || !in.get_array(mesh->tree.nodes))
+            return nullptr;
+
+        if (mesh->position_indices.size() % 3 != 0 || !mesh->tree.valid(mesh->triangle_count()))
+            return nullptr;
+        if (!mesh->normal_indices.empty() && mesh->normal_indices.size() != mesh->position_indices.size())
+            return nullptr;
+        for (auto index : mesh->position_indices)
+            if (index >= mesh->positions.size())
+                return nullptr;
+        for (auto index : mesh->normal_indices)
+            if (index >= mesh->normals.size())
+                return nullptr;
+        return mesh;
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        // Watertight ray/triangle test (Woop, Benthin and Wald 2013). The ray is sheared so it
+        // points down +z, which makes the edge tests exact on shared edges: a ray through an
+        // edge or vertex hits exactly one of the adjacent triangles, never neither.
+        auto dir = r.direction();
+        auto orig = r.origin();
+
+        int kz = 0;
+        for (int a = 1; a < 3; ++a)
+            if (std::fabs(dir[a]) > std::fabs(dir[kz]))
+                kz = a;
+        int kx = (kz + 1) % 3;
+        int ky = (kx + 1) % 3;
+        if (dir[kz] < 0)
+            std::swap(kx, ky);
+
+        auto sx = dir[kx] / dir[kz];
+        auto sy = dir[ky] / dir[kz];
+        auto sz = 1 / dir[kz];
+
+        uint32_t best = 0;
+        real best_u = 0, best_v = 0;
+        uint64_t visited = 0;
+
+        bool hit_anything = tree.traverse(r, ray_t, [&](uint32_t slot, interval& t_range) {
+            auto a = positions[position_indices[3 * slot + 0]] - orig;
+            auto b = positions[position_indices[3 * slot + 1]] - orig;
+            auto c = positions[position_indices[3 * slot + 2]] - orig;
+
+            auto ax = a[kx] - sx * a[kz];
+            auto ay = a[ky] - sy * a[kz];
+            auto bx = b[kx] - sx * b[kz];
+            auto by = b[ky] - sy * b[kz];
+            auto cx = c[kx] - sx * c[kz];
+            auto cy = c[ky] - sy * c[kz];
+
+            auto u = cx * by - cy * bx;
+            auto v = ax * cy - ay * cx;
+            auto w = bx * ay - by * ax;
+
+#if defined(RT_USE_FLOAT)
+            // Edge functions that round to exactly zero are redone in double precision.
+            if (u == 0 || v == 0 || w == 0) {
+                u = static_cast<real>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+                v = static_cast<real>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+                w = static_cast<real>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+            }
+#endif
+
+            if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+                return false;
+
+            auto det = u + v + w;
+            if (det == 0)
+                return false;
+
+            auto t = (u * sz * a[kz] + v * sz * b[kz] + w * sz * c[kz]) / det;
+            if (!t_range.surrounds(t))
+                return false;
+
+            t_range.max = t;
+            best = slot;
+            best_u = u / det;
+            best_v = v / det;
+            return true;
+        }, visited);
+
+        thread_nodes_visited() += visited;
+
+        if (!hit_anything)
+            return false;
+
+        // u, v and w weight the vertices a, b and c respectively.
+        const point3& a = positions[position_indices[3 * best + 0]];
+        const point3& b = positions[position_indices[3 * best + 1]];
+        const point3& c = positions[position_indices[3 * best + 2]];
+        auto best_w = 1 - best_u - best_v;
+
+        rec.t = ray_t.max;
+        rec.p = r.at(rec.t);
+        vec3 geometric = unit_vector(cross(b - a, c - a));
+        rec.set_face_normal(r, geometric);
+
+        if (!normals.empty()) {
+            vec3 shading = unit_vector(best_u * normals[normal_indices[3 * best + 0]]
+                                     + best_v * normals[normal_indices[3 * best + 1]]
+                                     + best_w * normals[normal_indices[3 * best + 2]]);
+            // Keep the interpolated normal on the same side as the geometric one.
+            rec.normal = dot(shading, rec.normal) < 0 ? -shading : shading;
+        }
+
+        rec.mat = mat;
+        return true;
+    }
+
+    aabb bounding_box() const override { return tree.bounds(); }
+
+    size_t triangle_count() const { return position_indices.size() / 3; }
+    size_t node_count() const { return tree.nodes.size(); }
+    double build_seconds() const { return build_time; }
+
+    size_t memory_bytes() const {
+        return positions.capacity() * sizeof(point3)
+             + normals.capacity() * sizeof(vec3)
+             + position_indices.capacity() * sizeof(uint32_t)
+             + normal_indices.capacity() * sizeof(uint32_t)
+             + tree.nodes.capacity() * sizeof(bvh_flat_node);
+    }
+
+    double bytes_per_triangle() const {
+        return triangle_count() ? static_cast<double>(memory_bytes()) / triangle_count() : 0.0;
+    }
+
+private:
+    explicit triangle_mesh(uint32_t m) : mat(m) {}
+
+    std::vector<point3>   positions;
+    std::vector<vec3>     normals;
+    std::vector<uint32_t> position_indices;
+    std::vector<uint32_t> normal_indices;
+    uint32_t              mat;
+    bvh_tree tree;
+    double build_time = 0;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#pragma once
+
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Building blocks for tracing many paths breadth first: a structure-of-arrays ray queue and
+// the sort keys that group its rays before each stage. The camera's wavefront mode drives them.
+
+class ray_stream {
+    // Origins and directions stored component by component, so the extend stage streams
+    // through six flat arrays instead of strided ray objects.
+public:
+    std::vector<real> ox, oy, oz;
+    std::vector<real> dx, dy, dz;
+
+    size_t size() const { return ox.size(); }
+
+    void clear() {
+        for (auto* v : { &ox, &oy, &oz, &dx, &dy, &dz })
+            v->clear();
+    }
+
+    void push_back(const ray& r) {
+        auto o = r.origin();
+        auto d = r.direction();
+        ox.push_back(o.x()); oy.push_back(o.y()); oz.push_back(o.z());
+        dx.push_back(d.x()); dy.push_back(d.y()); dz.push_back(d.z());
+    }
+
+    ray get(size_t k) const {
+        return ray(point3(ox[k], oy[k], oz[k]), vec3(dx[k], dy[k], dz[k]));
+    }
+
+    void set(size_t k, const ray& r) {
+        auto o = r.origin();
+        auto d = r.direction();
+        ox[k] = o.x(); oy[k] = o.y(); oz[k] = o.z();
+        dx[k] = d.x(); dy[k] = d.y(); dz[k] = d.z();
+    }
+};
+
+inline uint32_t spread_bits_by_3(uint32_t x) {
+    // Moves the low 10 bits of x to every third bit, for interleaving into a Morton code.
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+inline uint64_t ray_sort_key(const ray& r, const aabb& origins) {
+    // Direction octant in the top bits, then a 30-bit Morton code of the origin inside the
+    // box around all origins in the stream. Rays with equal keys start close together and
+    // head the same way, so they tend to visit the same BVH nodes one after another.
+    auto d = r.direction();
+    uint64_t octant = (d.x() < 0 ? 1u : 0u) | (d.y() < 0 ? 2u : 0u) | (d.z() < 0 ? 4u : 0u);
+
+    auto o = r.origin();
+    uint32_t cell[3];
+    for (int a = 0; a < 3; ++a) {
+        const interval& extent = origins.axis(a);
+        auto size = extent.size();
+        auto f = size > 0 ? (o[a] - extent.min) / size : real(0);
+        f = std::fmin(std::fmax(f, real(0)), real(1));
+        cell[a] = static_cast<uint32_t>(f * 1023);
+    }
+
+    uint64_t morton = spread_bits_by_3(cell[0]) | (spread_bits_by_3(cell[1]) << 1) | (spread_bits_by_3(cell[2]) << 2);
+    return (octant << 30) | morton;
+}
+
+struct keyed_slot {
+    uint64_t key;
+    uint32_t slot;
+};
+
+inline void sort_by_key(std::vector<uint32_t>& order, std::vector<keyed_slot>& keys, std::vector<keyed_slot>& scratch,
+                        int key_bits) {
+    // Writes the slots of keys to order, sorted by their low key_bits key bits. An LSD radix
+    // sort on 11-bit digits: stable, and three linear passes for the 33-bit ray keys, which is
+    // several times cheaper than a comparison sort at stream sizes.
+    const int digit_bits = 11;
+    const size_t buckets = size_t(1) << digit_bits;
+    scratch.resize(keys.size());
+    std::vector<uint32_t> counts(buckets);
+
+    for (int shift = 0; shift < key_bits; shift += digit_bits) {
+        std::fill(counts.begin(), counts.end(), 0);
+        for (const auto& entry : keys)
+            ++counts[(entry.key >> shift) & (buckets - 1)];
+
+        uint32_t offset = 0;
+        for (auto& c : counts) {
+            auto n = c;
+            c = offset;
+            offset += n;
+        }
+
+        for (const auto& entry : keys)
+            scratch[counts[(entry.key >> shift) & (buckets - 1)]++] = entry;
+        keys.swap(scratch);
+    }
+
+    for (size_t k = 0; k < keys.size(); ++k)
+        order[k] = keys[k].slot;
+}
+
+#endif
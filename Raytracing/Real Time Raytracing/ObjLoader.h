@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Streaming .OBJ loading, independent of Direct3D
+//
+// - The file is memory-mapped and parsed in place with
+//   std::from_chars: no line buffer, no sscanf
+// - Face corners that share the same position, uv and normal
+//   indices share one vertex, so the index buffer actually
+//   reuses vertices instead of counting 0..N-1
+// - Output is already converted to DirectX conventions:
+//   left-handed (Z flipped, winding flipped) with V flipped
+// --------------------------------------------------------
+
+// A single unique vertex from the file
+struct ObjVertex
+{
+	float Position[3];
+	float UV[2];
+	float Normal[3];
+};
+
+struct ObjMeshData
+{
+	std::vector<ObjVertex> vertices;
+	std::vector<unsigned int> indices;
+
+	// what the file held
+	size_t fileBytes = 0;
+	size_t positionCount = 0;
+	size_t uvCount = 0;
+	size_t normalCount = 0;
+	size_t faceCount = 0;
+
+	// set when loading fails, with the offending line
+	std::string error;
+
+	// indices per unique vertex: 1.0 means nothing was shared,
+	// a closed smooth mesh is usually close to 6
+	double GetReuseRatio() const;
+};
+
+// maps and parses a file; returns false (with mesh.error set) on failure
+bool LoadObj(const std::string& fileName, ObjMeshData& mesh);
+
+// parses .OBJ text already in memory
+bool ParseObj(const char* text, size_t length, ObjMeshData& mesh);